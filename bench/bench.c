@@ -0,0 +1,201 @@
+/**
+ * \file bench.c
+ *
+ * \brief Throughput and latency of the public API over a simulated bus, at each I2C speed mode and
+ * 1–64 devices
+ *
+ * The boards are emulated (emu/pca9685_emu.h). Prints one JSON object per line. Each result carries the simulated wire time (\c bus_ns, what the
+ * operation would cost on a real bus), the host time spent in the driver (\c host_ns) and the
+ * transactions and bytes it put on the wire, all per iteration. The conversion bench times
+ * pca9685_convert_frames alone, with each available kernel; it never touches the bus.
+ *
+ * Usage: bench [iterations]
+ */
+
+#include "pca9685.h"
+#include "pca9685_bus.h"
+#include "pca9685_convert.h"
+#include "sim_bus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 200
+#define CHANNELS 16
+#define ALL_CHANNELS -1
+#define NS_PER_S 1e9
+#define CONVERT_REPEAT 1000
+
+static const uint32_t speeds[] = { SIM_BUS_STANDARD, SIM_BUS_FAST, SIM_BUS_FAST_PLUS };
+static const int device_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static sim_bus_s sim;
+static pca9685_bus_s bus;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// A fresh bus of \c devices boards from 0x40 up, with the setup traffic left out of the counters
+static void set_up_bus(uint32_t hz, int devices) {
+    memset(&bus, 0, sizeof(bus));
+    sim_bus_attach(&sim, &bus, hz, devices);
+
+    for(int i = 0; i < devices; i++) {
+        pca9685_s *h = pca9685_bus_add(&bus, (u8)(0x40 + i));
+        h->nonblocking = 1;
+    }
+
+    sim_bus_reset_counters(&sim);
+}
+
+// A level that differs from the last iteration's on every channel, so nothing is elided
+static uint32_t level(int iteration, int device, int channel) {
+    return (uint32_t)((iteration * 7919 + device * 131 + channel * 4099) % 0x10000) | 1u;
+}
+
+typedef struct measure {
+    uint64_t host_ns;
+    uint64_t started;
+} measure_s;
+
+static void start(measure_s *m) {
+    sim_bus_reset_counters(&sim);
+    m->started = now_ns();
+}
+
+static void stop(measure_s *m) {
+    m->host_ns = now_ns() - m->started;
+}
+
+static void report(const char *bench, uint32_t hz, int devices, int iterations, const measure_s *m,
+        int channel_updates) {
+    double const bus_ns = (double)sim.ns / iterations;
+    double const host_ns = (double)m->host_ns / iterations;
+    double const per_s = NS_PER_S / (bus_ns + host_ns);
+
+    printf("{\"bench\":\"%s\",\"bus_hz\":%u,\"devices\":%d,\"iterations\":%d,"
+        "\"transactions\":%.2f,\"bytes\":%.2f,\"bus_ns\":%.0f,\"host_ns\":%.0f,"
+        "\"ops_per_s\":%.1f,\"channel_updates_per_s\":%.1f}\n",
+        bench, hz, devices, iterations,
+        (double)sim.transactions / iterations, (double)sim.bytes / iterations, bus_ns, host_ns,
+        per_s, per_s * channel_updates);
+}
+
+/** Benches */
+
+// Every channel of every device changes, and all of them go out in one combined transfer
+static void bench_frames(uint32_t hz, int devices, int iterations) {
+    measure_s m;
+    uint32_t levels[CHANNELS];
+
+    set_up_bus(hz, devices);
+    start(&m);
+
+    for(int i = 0; i < iterations; i++) {
+        pca9685_bus_begin_all(&bus);
+        for(int d = 0; d < devices; d++) {
+            for(int c = 0; c < CHANNELS; c++) levels[c] = level(i, d, c);
+            bus.devices[d].ops->set_brightness_all(&bus.devices[d], levels);
+        }
+        pca9685_bus_commit_all(&bus);
+    }
+
+    stop(&m);
+    report("frame", hz, devices, iterations, &m, devices * CHANNELS);
+}
+
+// One channel per device, each update sent as it's made
+static void bench_channels(uint32_t hz, int devices, int iterations) {
+    measure_s m;
+
+    set_up_bus(hz, devices);
+    start(&m);
+
+    for(int i = 0; i < iterations; i++) {
+        for(int d = 0; d < devices; d++) bus.devices[d].ops->set_brightness(&bus.devices[d], i % CHANNELS, level(i, d, 0));
+    }
+
+    stop(&m);
+    report("channel", hz, devices, iterations, &m, devices);
+}
+
+// The slower public operations on a single device; resets include their real oscillator waits
+static void bench_operation(const char *name, uint32_t hz, int iterations) {
+    measure_s m;
+
+    set_up_bus(hz, 1);
+    pca9685_s *h = &bus.devices[0];
+    start(&m);
+
+    for(int i = 0; i < iterations; i++) {
+        if(strcmp(name, "set_frequency") == 0) h->ops->set_frequency(h, (i & 1) ? 500 : 200);
+        else if(strcmp(name, "set_duty_cycle") == 0) h->ops->set_duty_cycle(h, ALL_CHANNELS, 0, i % 100);
+        else if(strcmp(name, "soft_reset") == 0) h->ops->soft_reset(h);
+        else h->ops->hard_reset(h);
+    }
+
+    h->ops->wait_ready(h);
+    stop(&m);
+    report(name, hz, 1, iterations, &m, 0);
+}
+
+// Brightness levels to register images for every device, repeated so the timing isn't all clock reads
+static void bench_convert(pca9685_simd simd, pca9685_curve curve, int devices, int iterations) {
+    static uint16_t levels[64 * CHANNELS];
+    static pca9685_frame_s images[64];
+    static const char *curves[] = { "linear", "gamma", "cie" };
+
+    if(pca9685_convert_select(simd) != 0) return;
+
+    for(int d = 0; d < devices; d++) {
+        for(int c = 0; c < CHANNELS; c++) levels[d * CHANNELS + c] = (uint16_t)level(0, d, c);
+    }
+
+    int const conversions = iterations * CONVERT_REPEAT;
+    uint64_t const started = now_ns();
+    for(int i = 0; i < conversions; i++) pca9685_convert_frames(images, levels, devices, curve, NULL);
+    double const host_ns = (double)(now_ns() - started) / conversions;
+
+    printf("{\"bench\":\"convert\",\"kernel\":\"%s\",\"curve\":\"%s\",\"devices\":%d,\"iterations\":%d,"
+        "\"host_ns\":%.1f,\"frames_per_s\":%.1f,\"channels_per_s\":%.1f}\n",
+        pca9685_simd_name(simd), curves[curve], devices, conversions,
+        host_ns, NS_PER_S / host_ns, NS_PER_S / host_ns * devices * CHANNELS);
+}
+
+int main(int argc, char **argv) {
+    static const char *operations[] = { "set_frequency", "set_duty_cycle", "soft_reset", "hard_reset" };
+    int const iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+
+    if(iterations < 1) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    for(size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+        for(size_t d = 0; d < sizeof(device_counts) / sizeof(device_counts[0]); d++) {
+            bench_frames(speeds[s], device_counts[d], iterations);
+            bench_channels(speeds[s], device_counts[d], iterations);
+        }
+
+        for(size_t o = 0; o < sizeof(operations) / sizeof(operations[0]); o++) {
+            bench_operation(operations[o], speeds[s], iterations);
+        }
+    }
+
+    static const pca9685_simd kernels[] = { PCA9685_SIMD_SCALAR, PCA9685_SIMD_SSE2, PCA9685_SIMD_AVX2, PCA9685_SIMD_NEON };
+
+    for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        for(size_t d = 0; d < sizeof(device_counts) / sizeof(device_counts[0]); d++) {
+            bench_convert(kernels[k], PCA9685_CURVE_LINEAR, device_counts[d], iterations);
+            bench_convert(kernels[k], PCA9685_CURVE_CIE, device_counts[d], iterations);
+        }
+    }
+
+    return 0;
+}
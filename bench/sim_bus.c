@@ -0,0 +1,80 @@
+#include "sim_bus.h"
+
+#define NS_PER_S 1000000000u
+
+// Clocks per byte: 8 data bits and the ACK
+#define BYTE_CLOCKS 9
+
+// Bus free time between a STOP and the next START, per speed mode (UM10204, table 10)
+static uint32_t bus_free_ns(uint32_t hz) {
+    return hz > SIM_BUS_FAST ? 500 : hz > SIM_BUS_STANDARD ? 1300 : 4700;
+}
+
+static sim_bus_s *sim_of(const pca9685_bus_s *bus) {
+    return (sim_bus_s *)bus->context;
+}
+
+// Charges one transaction of \c clocks SCL periods, \c bytes of them bytes
+static void charge(sim_bus_s *sim, uint64_t clocks, uint64_t bytes) {
+    sim->transactions++;
+    sim->bytes += bytes;
+    sim->ns += bus_free_ns(sim->hz) + clocks * NS_PER_S / sim->hz;
+}
+
+// START, slave address (write), register, repeated START, slave address (read), data, STOP
+static void charge_read(sim_bus_s *sim, u8 length) {
+    uint64_t const bytes = 3u + length;
+
+    charge(sim, 3 + bytes * BYTE_CLOCKS, bytes);
+}
+
+static u8 sim_read(pca9685_bus_s *bus, u8 slave, u8 address) {
+    sim_bus_s *sim = sim_of(bus);
+    u8 value = 0;
+
+    charge_read(sim, 1);
+    pca9685_emu_bus_read(&sim->emu, slave, address, 1, &value);
+
+    return value;
+}
+
+static u8 sim_block_read(pca9685_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values) {
+    sim_bus_s *sim = sim_of(bus);
+
+    charge_read(sim, length);
+
+    return pca9685_emu_bus_read(&sim->emu, slave, address, length, values);
+}
+
+// Each write is a (repeated) START, slave address, register and data; one STOP ends them all
+static u8 sim_transfer(pca9685_bus_s *bus, const pca9685_bus_write_s *writes, int count) {
+    sim_bus_s *sim = sim_of(bus);
+    uint64_t clocks = 1, bytes = 0;
+
+    for(int i = 0; i < count; i++) {
+        clocks += 1 + (2u + writes[i].write.length) * BYTE_CLOCKS;
+        bytes += 2u + writes[i].write.length;
+    }
+
+    charge(sim, clocks, bytes);
+
+    return pca9685_emu_bus_transfer(&sim->emu, writes, count);
+}
+
+void sim_bus_attach(sim_bus_s *sim, pca9685_bus_s *bus, uint32_t hz, int devices) {
+    sim->hz = hz;
+    sim->emu = (pca9685_emu_bus_s){ .devices = sim->devices, .count = devices };
+    for(int i = 0; i < devices; i++) pca9685_emu_power_on(&sim->devices[i], (u8)(0x40 + i));
+    sim_bus_reset_counters(sim);
+
+    bus->reader = sim_read;
+    bus->block_reader = sim_block_read;
+    bus->transfer = sim_transfer;
+    bus->context = sim;
+}
+
+void sim_bus_reset_counters(sim_bus_s *sim) {
+    sim->transactions = 0;
+    sim->bytes = 0;
+    sim->ns = 0;
+}
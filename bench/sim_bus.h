@@ -0,0 +1,40 @@
+/**
+ * \file sim_bus.h
+ *
+ * \brief A simulated I2C bus for benchmarks: emulated devices, and every transaction charged what it
+ * would take on the wire
+ *
+ * The cost model follows the I2C-bus specification (UM10204): each byte is 9 clocks (8 data bits and
+ * the ACK), START, repeated START and STOP take about a clock each, and consecutive transactions are
+ * separated by the bus free time tBUF of the speed mode. The devices are pca9685_emu_s emulators.
+ */
+
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include "pca9685_bus.h"
+#include "pca9685_emu.h"
+
+#include <stdint.h>
+
+/** Standard-mode, Fast-mode and Fast-mode Plus clock rates */
+#define SIM_BUS_STANDARD   100000u
+#define SIM_BUS_FAST       400000u
+#define SIM_BUS_FAST_PLUS 1000000u
+
+typedef struct sim_bus {
+    uint32_t hz;                    // SCL clock rate
+    uint64_t transactions;          // STOP-terminated transactions
+    uint64_t bytes;                 // Bytes on the wire, slave and register addresses included
+    uint64_t ns;                    // Simulated wire time
+    pca9685_emu_s devices[PCA9685_BUS_MAX_DEVICES];
+    pca9685_emu_bus_s emu;
+} sim_bus_s;
+
+/** Powers up \c devices emulated boards from 0x40 on, and binds them to \c bus as its callbacks, at \c hz */
+void sim_bus_attach(sim_bus_s *sim, pca9685_bus_s *bus, uint32_t hz, int devices);
+
+/** Zeroes the counters, leaving the devices alone */
+void sim_bus_reset_counters(sim_bus_s *sim);
+
+#endif
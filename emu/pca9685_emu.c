@@ -0,0 +1,380 @@
+#include "pca9685_emu.h"
+
+#include <string.h>
+#include <time.h>
+
+/** The chip as the datasheet describes it; kept apart from the driver's own definitions on purpose,
+ * so the two can disagree */
+
+#define REG_MODE1         0x00
+#define REG_MODE2         0x01
+#define REG_SUBADR1       0x02
+#define REG_SUBADR2       0x03
+#define REG_SUBADR3       0x04
+#define REG_ALLCALLADR    0x05
+#define REG_LED0          0x06
+#define REG_LED_LAST      0x45
+#define REG_ALL_LED       0xFA
+#define REG_ALL_LED_LAST  0xFD
+#define REG_PRE_SCALE     0xFE
+
+#define MODE1_ALLCALL (1<<0)
+#define MODE1_SUB3    (1<<1)
+#define MODE1_SUB2    (1<<2)
+#define MODE1_SUB1    (1<<3)
+#define MODE1_SLEEP   (1<<4)
+#define MODE1_AI      (1<<5)
+#define MODE1_EXTCLK  (1<<6)
+#define MODE1_RESTART (1<<7)
+
+#define MODE2_OUTDRV  (1<<2)
+#define MODE2_OCH     (1<<3)
+#define MODE2_INVRT   (1<<4)
+
+#define FULL_BIT      (1<<4)
+#define FULL_STEPS    (FULL_BIT << 8)
+#define STEPS         4096u
+#define CHANNELS      16
+#define OSCILLATOR    25000000u
+#define SETTLE_NS     500000u
+
+#define GENERAL_CALL  0x00
+#define SWRST         0x06
+
+#define ALL_REGISTERS 0x0F
+
+/** Power-on state (p. 10, 13, 16, 25) */
+
+void pca9685_emu_power_on(pca9685_emu_s *emu, u8 address) {
+    pca9685_emu_clock_cb const clock = emu->clock;
+    void *const context = emu->context;
+    uint32_t const external_hz = emu->external_hz;
+
+    memset(emu, 0, sizeof(*emu));
+    emu->address = address;
+    emu->clock = clock;
+    emu->context = context;
+    emu->external_hz = external_hz;
+
+    emu->registers[REG_MODE1] = MODE1_SLEEP | MODE1_ALLCALL;
+    emu->registers[REG_MODE2] = MODE2_OUTDRV;
+    emu->registers[REG_SUBADR1] = 0xE2;
+    emu->registers[REG_SUBADR2] = 0xE4;
+    emu->registers[REG_SUBADR3] = 0xE8;
+    emu->registers[REG_ALLCALLADR] = 0xE0;
+    emu->registers[REG_PRE_SCALE] = 0x1E;
+
+    for(int c = 0; c < CHANNELS; c++) {
+        emu->registers[REG_LED0 + c * 4 + 3] = FULL_BIT;
+        emu->off[c] = FULL_STEPS;
+    }
+}
+
+static uint64_t now(const pca9685_emu_s *emu) {
+    if(emu->clock) return emu->clock(emu);
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+int pca9685_emu_addressed(const pca9685_emu_s *emu, u8 slave) {
+    static const u8 bits[] = { MODE1_ALLCALL, MODE1_SUB1, MODE1_SUB2, MODE1_SUB3 };
+    static const u8 registers[] = { REG_ALLCALLADR, REG_SUBADR1, REG_SUBADR2, REG_SUBADR3 };
+    u8 const mode1 = emu->registers[REG_MODE1];
+
+    if(slave == emu->address) return 1;
+
+    // Group address registers hold the 8-bit write address; bit 0 is ignored
+    for(int g = 0; g < 4; g++) {
+        if((mode1 & bits[g]) && slave == (emu->registers[registers[g]] >> 1)) return 1;
+    }
+
+    return 0;
+}
+
+/** Outputs */
+
+static uint16_t led_value(const u8 *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] & (FULL_BIT | 0x0F)) << 8);
+}
+
+static void latch(pca9685_emu_s *emu, int c) {
+    const u8 *led = &emu->registers[REG_LED0 + c * 4];
+
+    emu->on[c] = led_value(led);
+    emu->off[c] = led_value(led + 2);
+    emu->written[c] = 0;
+    emu->pending &= (uint16_t)~(1u << c);
+
+    // A PWM register update also clears RESTART, as writing RESTART would (p. 14)
+    emu->registers[REG_MODE1] &= (u8)~MODE1_RESTART;
+}
+
+int pca9685_emu_running(const pca9685_emu_s *emu) {
+    return !(emu->registers[REG_MODE1] & (MODE1_SLEEP | MODE1_RESTART));
+}
+
+static uint32_t oscillator_hz(const pca9685_emu_s *emu) {
+    return (emu->registers[REG_MODE1] & MODE1_EXTCLK) && emu->external_hz ? emu->external_hz : OSCILLATOR;
+}
+
+uint32_t pca9685_emu_frequency(const pca9685_emu_s *emu) {
+    uint32_t const period = STEPS * (emu->registers[REG_PRE_SCALE] + 1u);
+
+    return (oscillator_hz(emu) + period / 2) / period;
+}
+
+void pca9685_emu_waveform(const pca9685_emu_s *emu, int c, pca9685_emu_wave_s *wave) {
+    uint64_t const period = (uint64_t)STEPS * (emu->registers[REG_PRE_SCALE] + 1u) * 1000000000u / oscillator_hz(emu);
+    u8 const invert = (emu->registers[REG_MODE2] & MODE2_INVRT) != 0;
+    uint16_t const on = emu->on[c], off = emu->off[c];
+
+    *wave = (pca9685_emu_wave_s){ .period_ns = (uint32_t)period, .constant = 1, .level = invert };
+
+    // Stopped PWM, full off (which wins over full on), full on, and an edge on both at once
+    if(!pca9685_emu_running(emu) || (off & FULL_STEPS)) return;
+
+    if(on & FULL_STEPS) {
+        wave->level = !invert;
+        return;
+    }
+
+    if(on == off) return;
+
+    wave->constant = 0;
+    wave->rise_ns = (uint32_t)(period * on / STEPS);
+    wave->fall_ns = (uint32_t)(period * off / STEPS);
+
+    // Inverted outputs swap the edges
+    if(invert) {
+        uint32_t const rise = wave->rise_ns;
+        wave->rise_ns = wave->fall_ns;
+        wave->fall_ns = rise;
+    }
+}
+
+/** Registers */
+
+static void write_mode1(pca9685_emu_s *emu, u8 value) {
+    u8 const old = emu->registers[REG_MODE1];
+    u8 next = (u8)(value & ~MODE1_RESTART);
+
+    // EXTCLK only sets while asleep, and only a reset clears it (p. 14)
+    if((value & MODE1_EXTCLK) && !(old & MODE1_SLEEP) && !(old & MODE1_EXTCLK)) {
+        emu->violations |= PCA9685_EMU_EXTCLK_AWAKE;
+        next &= (u8)~MODE1_EXTCLK;
+    }
+    next |= (u8)(old & MODE1_EXTCLK);
+
+    // RESTART only clears by writing it with a 1, which restarts PWM once the oscillator has settled
+    if(old & MODE1_RESTART) {
+        if(!(value & MODE1_RESTART)) next |= MODE1_RESTART;
+        else if(!(next & MODE1_SLEEP) && now(emu) - emu->woke_at < SETTLE_NS) emu->violations |= PCA9685_EMU_EARLY_RESTART;
+    }
+
+    // Going to sleep with PWM running sets it (p. 14)
+    if(!(old & MODE1_SLEEP) && (value & MODE1_SLEEP) && pca9685_emu_running(emu)) {
+        for(int c = 0; c < CHANNELS; c++) {
+            if(!(emu->off[c] & FULL_STEPS)) next |= MODE1_RESTART;
+        }
+    }
+
+    if((old & MODE1_SLEEP) && !(value & MODE1_SLEEP)) emu->woke_at = now(emu);
+
+    emu->registers[REG_MODE1] = next;
+}
+
+static void write_led(pca9685_emu_s *emu, int c, int byte, u8 value) {
+    emu->registers[REG_LED0 + c * 4 + byte] = value;
+    emu->written[c] |= (u8)(1 << byte);
+
+    // OCH=1: the outputs change on the ACK of the last of all four registers (p. 16)
+    if(emu->registers[REG_MODE2] & MODE2_OCH) {
+        if(emu->written[c] == ALL_REGISTERS) latch(emu, c);
+    } else {
+        emu->pending |= (uint16_t)(1u << c);
+    }
+}
+
+static void write_register(pca9685_emu_s *emu, u8 r, u8 value) {
+    if(r == REG_MODE1) {
+        write_mode1(emu, value);
+    } else if(r >= REG_LED0 && r <= REG_LED_LAST) {
+        write_led(emu, (r - REG_LED0) / 4, (r - REG_LED0) % 4, value);
+    } else if(r >= REG_ALL_LED && r <= REG_ALL_LED_LAST) {
+        for(int c = 0; c < CHANNELS; c++) write_led(emu, c, r - REG_ALL_LED, value);
+    } else if(r == REG_PRE_SCALE) {
+        // Only takes while the oscillator is off (p. 25); values under 3 read back as 3
+        if(emu->registers[REG_MODE1] & MODE1_SLEEP) emu->registers[r] = value < 3 ? 3 : value;
+        else emu->violations |= PCA9685_EMU_PRESCALE_AWAKE;
+    } else if(r <= REG_ALLCALLADR) {
+        emu->registers[r] = value;
+    } else {
+        emu->violations |= PCA9685_EMU_RESERVED_WRITE;
+    }
+}
+
+static u8 read_register(const pca9685_emu_s *emu, u8 r) {
+    return (r <= REG_LED_LAST || r == REG_PRE_SCALE) ? emu->registers[r] : 0;
+}
+
+// With AI set the pointer moves on after each byte, wrapping from the last LED register to MODE1
+static void advance(pca9685_emu_s *emu) {
+    if(!(emu->registers[REG_MODE1] & MODE1_AI)) return;
+
+    emu->pointer = (emu->pointer == REG_LED_LAST) ? REG_MODE1 : (u8)(emu->pointer + 1);
+}
+
+void pca9685_emu_write(pca9685_emu_s *emu, const u8 *bytes, int length) {
+    if(length < 1) return;
+
+    emu->pointer = bytes[0];
+
+    for(int i = 1; i < length; i++) {
+        write_register(emu, emu->pointer, bytes[i]);
+        advance(emu);
+    }
+}
+
+void pca9685_emu_read(pca9685_emu_s *emu, u8 *values, int length) {
+    for(int i = 0; i < length; i++) {
+        values[i] = read_register(emu, emu->pointer);
+        advance(emu);
+    }
+}
+
+// OCH=0: every channel written in the transaction changes on the STOP
+void pca9685_emu_stop(pca9685_emu_s *emu) {
+    for(int c = 0; c < CHANNELS; c++) {
+        if(emu->pending & (1u << c)) latch(emu, c);
+    }
+}
+
+/** Bus */
+
+// One write message of a transaction; 0 if any device acknowledged it
+static u8 message(pca9685_emu_bus_s *bus, u8 slave, const u8 *bytes, int length) {
+    int acked = 0;
+
+    bus->bytes += 1u + (uint64_t)length;
+
+    if(slave == GENERAL_CALL) {
+        if(length == 1 && bytes[0] == SWRST) {
+            for(int i = 0; i < bus->count; i++) pca9685_emu_power_on(&bus->devices[i], bus->devices[i].address);
+        }
+        return 0;
+    }
+
+    for(int i = 0; i < bus->count; i++) {
+        if(!pca9685_emu_addressed(&bus->devices[i], slave)) continue;
+
+        pca9685_emu_write(&bus->devices[i], bytes, length);
+        acked = 1;
+    }
+
+    return acked ? 0 : 1;
+}
+
+static void stop_all(pca9685_emu_bus_s *bus) {
+    bus->transactions++;
+    for(int i = 0; i < bus->count; i++) pca9685_emu_stop(&bus->devices[i]);
+}
+
+u8 pca9685_emu_bus_write(pca9685_emu_bus_s *bus, u8 slave, const u8 *bytes, int length) {
+    u8 const result = message(bus, slave, bytes, length);
+
+    stop_all(bus);
+
+    return result;
+}
+
+u8 pca9685_emu_bus_read(pca9685_emu_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values) {
+    bus->transactions++;
+    bus->bytes += 3u + length;
+
+    // Reads only answer on the device's own address
+    for(int i = 0; i < bus->count; i++) {
+        pca9685_emu_s *emu = &bus->devices[i];
+        if(emu->address != slave) continue;
+
+        pca9685_emu_write(emu, &address, 1);
+        pca9685_emu_read(emu, values, length);
+        pca9685_emu_stop(emu);
+        return 0;
+    }
+
+    return 1;
+}
+
+u8 pca9685_emu_bus_transfer(pca9685_emu_bus_s *bus, const pca9685_bus_write_s *writes, int count) {
+    u8 result = 0;
+
+    for(int i = 0; i < count; i++) {
+        const pca9685_i2c_write_s *w = &writes[i].write;
+        u8 bytes[1 + 256];
+
+        bytes[0] = w->address;
+        memcpy(&bytes[1], w->data, w->length);
+        result |= message(bus, writes[i].slave, bytes, 1 + w->length);
+    }
+
+    stop_all(bus);
+
+    return result;
+}
+
+/** Driver handle callbacks */
+
+static pca9685_emu_bus_s *bus_of(const pca9685_s *h) {
+    return (pca9685_emu_bus_s *)h->bus_context;
+}
+
+u8 pca9685_emu_reader(pca9685_s *h, u8 address) {
+    u8 value = 0;
+
+    pca9685_emu_bus_read(bus_of(h), h->slave_address, address, 1, &value);
+
+    return value;
+}
+
+u8 pca9685_emu_writer(pca9685_s *h, u8 address, u8 data) {
+    return pca9685_emu_block_writer(h, address, 1, &data);
+}
+
+u8 pca9685_emu_block_writer(pca9685_s *h, u8 address, u8 length, const u8 *values) {
+    const pca9685_i2c_write_s write = { .address = address, .length = length, .data = values };
+
+    return pca9685_emu_transfer(h, &write, 1);
+}
+
+u8 pca9685_emu_block_reader(pca9685_s *h, u8 address, u8 length, u8 *values) {
+    return pca9685_emu_bus_read(bus_of(h), h->slave_address, address, length, values);
+}
+
+u8 pca9685_emu_transfer(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count) {
+    pca9685_bus_write_s addressed[PCA9685_BUS_MAX_WRITES];
+
+    for(u8 i = 0; i < count; i++) addressed[i] = (pca9685_bus_write_s){ .slave = h->slave_address, .write = writes[i] };
+
+    return pca9685_emu_bus_transfer(bus_of(h), addressed, count);
+}
+
+/** pca9685_bus_s callbacks */
+
+u8 pca9685_emu_bus_reader(pca9685_bus_s *bus, u8 slave, u8 address) {
+    u8 value = 0;
+
+    pca9685_emu_bus_read((pca9685_emu_bus_s *)bus->context, slave, address, 1, &value);
+
+    return value;
+}
+
+u8 pca9685_emu_bus_block_reader(pca9685_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values) {
+    return pca9685_emu_bus_read((pca9685_emu_bus_s *)bus->context, slave, address, length, values);
+}
+
+u8 pca9685_emu_bus_transferer(pca9685_bus_s *bus, const pca9685_bus_write_s *writes, int count) {
+    return pca9685_emu_bus_transfer((pca9685_emu_bus_s *)bus->context, writes, count);
+}
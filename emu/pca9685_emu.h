@@ -0,0 +1,141 @@
+/**
+ * \file pca9685_emu.h
+ *
+ * \brief A behavioral model of the PCA9685 register file and outputs, for tests and benchmarks
+ *
+ * Models what a driver can observe over the bus: auto-increment, SLEEP and RESTART, PRE_SCALE only
+ * taking writes while asleep, the sticky EXTCLK bit, full-on and full-off, the ALL_LED registers,
+ * the LED All Call and subaddress decoding, the software reset general call, and the MODE2 OCH
+ * choice of latching outputs on STOP or on ACK. Each channel's output renders as a waveform with its
+ * edge times within the PWM period.
+ *
+ * Not modeled: the OE pin, so OUTNE never applies; open-drain outputs, which render as totem-pole;
+ * and the chip deferring output changes to the end of the current PWM cycle.
+ *
+ * Usage:
+ *
+ * \code
+ * // Devices on an emulated bus; the emulator powers them up
+ * static pca9685_emu_s boards[2];
+ * static pca9685_emu_bus_s my_bus = { .devices=boards, .count=2 };
+ * pca9685_emu_power_on(&boards[0], 0x40);
+ * pca9685_emu_power_on(&boards[1], 0x41);
+ *
+ * // Point a driver handle at one of them, with block writes, block reads and combined transfers
+ * pca9685_s my_driver = pca9685(PCA9685_EMU(&my_bus, 0x40));
+ *
+ * // Or hand a pca9685_bus_s the emulated bus
+ * static pca9685_bus_s my_driver_bus = { PCA9685_EMU_BUS(&my_bus) };
+ *
+ * // Then look at the outputs
+ * pca9685_emu_wave_s wave;
+ * pca9685_emu_waveform(&boards[0], 3, &wave);
+ * assert(wave.fall_ns - wave.rise_ns == wave.period_ns / 2);
+ * \endcode
+ */
+
+#ifndef PCA9685_EMU_H
+#define PCA9685_EMU_H
+
+#include "pca9685.h"
+#include "pca9685_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Conditions a real chip would silently mishandle; recorded in \c violations */
+#define PCA9685_EMU_PRESCALE_AWAKE 0x01   // PRE_SCALE written with the oscillator running; ignored
+#define PCA9685_EMU_EARLY_RESTART  0x02   // RESTART written within 500μs of waking
+#define PCA9685_EMU_EXTCLK_AWAKE   0x04   // EXTCLK set with the oscillator running; ignored
+#define PCA9685_EMU_RESERVED_WRITE 0x08   // Write to a reserved register (0x46–0xF9 or 0xFF)
+
+struct pca9685_emu;
+
+/** Emulated time in ns; CLOCK_MONOTONIC when the device has no clock callback */
+typedef uint64_t (*pca9685_emu_clock_cb)(const struct pca9685_emu *emu);
+
+/** One emulated device */
+typedef struct pca9685_emu {
+    u8 address;                 // 7-bit slave address set by the A0–A5 pins
+    u8 registers[256];          // Register file as written; ALL_LED and reserved registers read 0
+    u8 pointer;                 // Register pointer (the control register)
+    uint16_t on[16];            // Latched on step of each output, bit 12 the full-on bit
+    uint16_t off[16];           // Latched off step of each output, bit 12 the full-off bit
+    u8 written[16];             // LED registers of each channel written since it last latched, by bit
+    uint16_t pending;           // Channels with writes waiting for a STOP to latch (OCH=0)
+    uint32_t external_hz;       // EXTCLK input frequency, used once MODE1 EXTCLK is set
+    uint64_t woke_at;           // Emulated time the oscillator last started
+    u8 violations;              // PCA9685_EMU_* conditions seen since power-on
+    pca9685_emu_clock_cb clock; // Optional clock, for tests that step time themselves
+    void *context;              // Caller's data for the clock
+} pca9685_emu_s;
+
+/** Devices sharing one emulated bus */
+typedef struct pca9685_emu_bus {
+    pca9685_emu_s *devices;
+    int count;
+    uint64_t transactions;      // STOP-terminated transactions seen
+    uint64_t bytes;             // Bytes on the wire, slave and register addresses included
+} pca9685_emu_bus_s;
+
+/** An output over one PWM period: high from \c rise_ns to \c fall_ns, wrapping if rise comes later */
+typedef struct pca9685_emu_wave {
+    uint32_t period_ns;         // PWM period, from the oscillator and PRE_SCALE
+    uint32_t rise_ns;           // Time of the rising edge into the period
+    uint32_t fall_ns;           // Time of the falling edge into the period
+    u8 constant;                // Non-zero if the output doesn't toggle; \c level holds it
+    u8 level;                   // Output level when constant (after INVRT)
+} pca9685_emu_wave_s;
+
+/** Power-on reset, answering at \c address */
+void pca9685_emu_power_on(pca9685_emu_s *emu, u8 address);
+
+/** Whether a transaction to 7-bit \c slave reaches \c emu: its own address, or a group it answers */
+int pca9685_emu_addressed(const pca9685_emu_s *emu, u8 slave);
+
+/** Wire-level access: a write message (register address, then data), a read from the pointer on,
+ * and the STOP that ends a transaction */
+void pca9685_emu_write(pca9685_emu_s *emu, const u8 *bytes, int length);
+void pca9685_emu_read(pca9685_emu_s *emu, u8 *values, int length);
+void pca9685_emu_stop(pca9685_emu_s *emu);
+
+/** Whether PWM is running: awake, settled or not, and not waiting for a RESTART */
+int pca9685_emu_running(const pca9685_emu_s *emu);
+
+/** PWM frequency in Hz, and channel \c channel's output over one period */
+uint32_t pca9685_emu_frequency(const pca9685_emu_s *emu);
+void pca9685_emu_waveform(const pca9685_emu_s *emu, int channel, pca9685_emu_wave_s *wave);
+
+/** Bus-level transactions: every addressed device takes part; general call 0x00 with 0x06 resets all */
+u8 pca9685_emu_bus_write(pca9685_emu_bus_s *bus, u8 slave, const u8 *bytes, int length);
+u8 pca9685_emu_bus_read(pca9685_emu_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values);
+u8 pca9685_emu_bus_transfer(pca9685_emu_bus_s *bus, const pca9685_bus_write_s *writes, int count);
+
+/** Driver handle callbacks; \c bus_context is the pca9685_emu_bus_s, \c slave_address the device */
+u8 pca9685_emu_reader(pca9685_s *h, u8 address);
+u8 pca9685_emu_writer(pca9685_s *h, u8 address, u8 data);
+u8 pca9685_emu_block_writer(pca9685_s *h, u8 address, u8 length, const u8 *values);
+u8 pca9685_emu_block_reader(pca9685_s *h, u8 address, u8 length, u8 *values);
+u8 pca9685_emu_transfer(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count);
+
+#define PCA9685_EMU(emu_bus, slave) \
+    .bus_context=(emu_bus), .slave_address=(slave), \
+    .bus_reader=pca9685_emu_reader, .bus_writer=pca9685_emu_writer, \
+    .bus_block_writer=pca9685_emu_block_writer, .bus_block_reader=pca9685_emu_block_reader, \
+    .bus_transfer=pca9685_emu_transfer
+
+/** pca9685_bus_s callbacks; \c context is the pca9685_emu_bus_s */
+u8 pca9685_emu_bus_reader(pca9685_bus_s *bus, u8 slave, u8 address);
+u8 pca9685_emu_bus_block_reader(pca9685_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values);
+u8 pca9685_emu_bus_transferer(pca9685_bus_s *bus, const pca9685_bus_write_s *writes, int count);
+
+#define PCA9685_EMU_BUS(emu_bus) \
+    .reader=pca9685_emu_bus_reader, .block_reader=pca9685_emu_bus_block_reader, \
+    .transfer=pca9685_emu_bus_transferer, .context=(emu_bus)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
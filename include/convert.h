@@ -0,0 +1,42 @@
+#ifndef PCA9685_CONVERT_KERNELS_H
+#define PCA9685_CONVERT_KERNELS_H
+
+#include "pca9685_convert.h"
+
+/** Compile-time switches: 0 builds the scalar kernel only; the NEON kernel, still unverified on
+ * hardware, also needs PCA9685_NEON */
+#ifndef PCA9685_SIMD
+#define PCA9685_SIMD 1
+#endif
+
+#ifndef PCA9685_NEON
+#define PCA9685_NEON 0
+#endif
+
+#if PCA9685_SIMD && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CONVERT_X86 1
+#endif
+
+#if PCA9685_SIMD && PCA9685_NEON && defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CONVERT_NEON 1
+#endif
+
+/**
+ * Conversion kernels: \c count devices' 16 levels each into 64 register bytes each at \c out.
+ * \c table is the curve's lookup table, or NULL for linear; \c phase always holds 16 steps.
+ */
+typedef void (*convert_kernel_fn)(uint8_t *out, const uint16_t *levels, int count,
+    const uint16_t *table, const uint16_t *phase);
+
+void convert_scalar(uint8_t *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase);
+
+#ifdef CONVERT_X86
+void convert_sse2(uint8_t *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase);
+void convert_avx2(uint8_t *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase);
+#endif
+
+#ifdef CONVERT_NEON
+void convert_neon(uint8_t *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase);
+#endif
+
+#endif
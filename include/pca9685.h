@@ -12,9 +12,15 @@
  * // Set up your driver, passing your I2C read and write callbacks
  * my_driver = pca9685(.bus_reader=my_bus_reader, .bus_writer=my_bus_writer);
  *
+ * // Optionally pass a block write callback; channel updates then go out as one auto-increment transaction
+ * my_driver = pca9685(.bus_reader=my_bus_reader, .bus_writer=my_bus_writer, .bus_block_writer=my_bus_block_writer);
+ *
  * // Set frequency to 250Hz
  * my_driver.set_frequency(&my_driver, 250);
  *
+ * // The same through the shared operations table, the only way with PCA9685_HANDLE_OPS=0
+ * my_driver.ops->set_frequency(&my_driver, 250);
+ *
  * // Set PWM duty cycle on LED channel 5 to 25%
  * my_driver.set_duty_cycle(&my_driver, 5, 1, 25);
  *
@@ -33,6 +39,76 @@
  * // Set PWM duty cycle on all LED channels to 50%
  * my_driver.set_duty_cycle(&my_driver, -1, 1, 50);
  *
+ * // Set channel 5 on from step 410 to step 2047, of 4096
+ * my_driver.set_steps(&my_driver, 5, 410, 2047);
+ *
+ * // Set channel 5 to 25% brightness in Q16 fixed point, at full 12-bit resolution
+ * my_driver.set_brightness(&my_driver, 5, 0x4000);
+ *
+ * // Set all 16 channels at once from an array of Q16 values
+ * uint32_t levels[16] = { 0x10000, 0x8000, 0x4000 };
+ * my_driver.set_brightness_all(&my_driver, levels);
+ *
+ * // Correct brightness and duty cycle for the eye: gamma (PCA9685_GAMMA at build time) or CIE lightness,
+ * // from lookup tables generated at build time; per channel, or ALL (-1)
+ * my_driver.set_curve(&my_driver, -1, PCA9685_CURVE_CIE);
+ * my_driver.set_curve(&my_driver, 0, PCA9685_CURVE_LINEAR);
+ *
+ * // Stage several updates and send them together; the last update to a channel wins
+ * my_driver.begin_frame(&my_driver);
+ * my_driver.set_duty_cycle(&my_driver, 2, 0, 25);
+ * my_driver.set_duty_cycle(&my_driver, 3, 0, 75);
+ * my_driver.channel_off(&my_driver, 2);
+ * my_driver.commit_frame(&my_driver);
+ *
+ * // Latched frames: every channel in a frame changes at the same instant, at the STOP of a single
+ * // transaction (MODE2 OCH is cleared for it); needs a block write or combined transfer callback
+ * my_driver = pca9685(.bus_reader=my_bus_reader, .bus_writer=my_bus_writer, .bus_block_writer=my_bus_block_writer, .latched=1);
+ *
+ * // Or render straight into a register image; it goes out as it is, trimmed to the bytes that changed
+ * pca9685_frame_s image = { 0 };
+ * pca9685_frame_set_steps(&image, 4, 0, 1024);
+ * pca9685_frame_set_full_on(&image, 5);
+ * my_driver.write_frame(&my_driver, &image);
+ *
+ * // Unchanged register bytes are not re-sent; if something else may have written to the chip,
+ * // drop the driver's copy of its registers, or re-read them all
+ * my_driver.invalidate(&my_driver);
+ * my_driver.resync(&my_driver);
+ *
+ * // Don't block for the oscillator to settle after a frequency change or reset; only a later write
+ * // that needs the oscillator (a PWM restart) waits out what remains of the 500μs
+ * my_driver = pca9685(.bus_reader=my_bus_reader, .bus_writer=my_bus_writer, .nonblocking=1);
+ * my_driver.set_frequency(&my_driver, 1000);
+ * if(!my_driver.is_ready(&my_driver)) do_other_work();
+ * my_driver.wait_ready(&my_driver);
+ *
+ * // Sleep the device once every channel has been off for 5s, checked whenever you call check_idle; the next
+ * // update that lights a channel wakes it, sent while the oscillator settles, without rewriting the others
+ * my_driver = pca9685(.bus_reader=my_bus_reader, .bus_writer=my_bus_writer, .idle_sleep_ms=5000);
+ * my_driver.channel_off(&my_driver, -1);
+ * if(my_driver.check_idle(&my_driver)) puts("asleep");
+ * my_driver.set_brightness(&my_driver, 3, 0x8000);
+ *
+ * // Read the chip's registers back and decode them; with a block read callback it's two or three
+ * // transactions, and one more to set auto-increment if a brownout cleared it
+ * pca9685_snapshot_s state;
+ * my_driver.snapshot(&my_driver, &state);
+ * if(state.sleeping) puts("brownout?");
+ *
+ * // Rewrite only the registers that differ from what the driver last wrote; returns how many
+ * int rewritten = my_driver.reconcile(&my_driver, &state);
+ *
+ * // Count bus traffic and time bus callbacks and operations into storage you provide (PCA9685_STATS=0 compiles it out)
+ * static pca9685_stats_s my_stats;
+ * my_driver.stats = &my_stats;
+ * pca9685_stats_s now;
+ * my_driver.read_stats(&my_driver, &now);
+ * my_driver.reset_stats(&my_driver);
+ *
+ * // Receive structured events for each bus transaction (and register operation, with PCA9685_TRACE_LEVEL=2)
+ * my_driver.trace = my_trace_callback;
+ *
  * // Contains the data last read or written
  * uint8_t my_data = my_driver.data(&my_driver);
  *
@@ -50,8 +126,19 @@
 #ifndef PCA9685_LIBRARY_H
 #define PCA9685_LIBRARY_H
 
+#include <assert.h>
 #include <inttypes.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Non-zero to copy the operations into each handle as well, for handle.set_steps(&handle, ...) style
+ * calls; 0 leaves only the shared \c ops pointer, 176 bytes smaller per handle on 64-bit targets */
+#ifndef PCA9685_HANDLE_OPS
+#define PCA9685_HANDLE_OPS 1
+#endif
+
 /** Initializes a driver_handle struct with values provided by the user. */
 #define pca9685(...) (pca9685_configure_handle((pca9685_s){__VA_ARGS__}))
 
@@ -71,10 +158,201 @@ struct pca9685_driver;
 typedef u8 (*pca9685_i2c_bus_read_cb)(struct pca9685_driver *driver, u8 address);
 typedef u8 (*pca9685_i2c_bus_write_cb)(struct pca9685_driver *driver, u8 address, u8 data);
 
+/**
+ * Type for the optional I2C bus block write callback.
+ * Modeled on \c i2c_smbus_write_i2c_block_data: writes \c length bytes starting at register \c address
+ * in a single transaction. The driver sets the MODE1 AI (auto-increment) bit before the first block write.
+ * Note that SMBus adapters limit blocks to 32 bytes; callbacks backed by SMBus should split longer blocks.
+ */
+typedef u8 (*pca9685_i2c_bus_block_write_cb)(struct pca9685_driver *driver, u8 address, u8 length, const u8 *values);
+
+/**
+ * Type for the optional I2C bus block read callback.
+ * Modeled on \c i2c_smbus_read_i2c_block_data: reads \c length bytes starting at register \c address
+ * in a single transaction. Only used while the MODE1 AI (auto-increment) bit is set.
+ */
+typedef u8 (*pca9685_i2c_bus_block_read_cb)(struct pca9685_driver *driver, u8 address, u8 length, u8 *values);
+
+/** One register write of a multi-write transfer: \c length bytes from register \c address on */
+typedef struct pca9685_i2c_write {
+    u8 address;
+    u8 length;
+    const u8 *data;
+} pca9685_i2c_write_s;
+
+/**
+ * Type for the optional I2C bus transfer callback.
+ * Sends \c count register writes back to back as one combined transfer (repeated starts, one stop),
+ * as with Linux's \c I2C_RDWR ioctl. Used to commit frames with several changed runs in one go.
+ */
+typedef u8 (*pca9685_i2c_bus_transfer_cb)(struct pca9685_driver *driver, const pca9685_i2c_write_s *writes, u8 count);
+
+/** Operations reported to the optional trace callback */
+typedef enum pca9685_trace_op {
+    PCA9685_TRACE_READ,         // Register read over the bus; value is the byte read
+    PCA9685_TRACE_SHADOW_READ,  // Register read answered from the shadow registers
+    PCA9685_TRACE_WRITE,        // Register write; value is the byte written
+    PCA9685_TRACE_ELIDED_WRITE, // Register write skipped, the device already holds the value
+    PCA9685_TRACE_BLOCK_WRITE,  // Block write of length bytes; value is the first byte
+    PCA9685_TRACE_BLOCK_READ,   // Block read of length bytes; value is the first byte
+    PCA9685_TRACE_LED,          // LED registers set; address is the first register, value/extra on/off steps
+    PCA9685_TRACE_DUTY_CYCLE    // Duty cycle set; address is the channel (0xFF for all), value/extra on/delay %
+} pca9685_trace_op;
+
+/** A structured trace event; timestamps are CLOCK_MONOTONIC nanoseconds */
+typedef struct pca9685_trace_event {
+    uint64_t timestamp;
+    pca9685_trace_op op;
+    u8 address;
+    u8 length;
+    u8 result;
+    uint16_t value;
+    uint16_t extra;
+} pca9685_trace_event_s;
+
+typedef void (*pca9685_trace_cb)(struct pca9685_driver *driver, const pca9685_trace_event_s *event);
+
+/**
+ * Latency histogram. Bucket \c i counts latencies under 2^(i + 10) ns, roughly 1μs, 2μs, 4μs and so on;
+ * the last bucket takes everything from 16ms up.
+ */
+#define PCA9685_STATS_BUCKETS 16
+
+typedef struct pca9685_histogram {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint32_t buckets[PCA9685_STATS_BUCKETS];
+} pca9685_histogram_s;
+
+/** Bus callbacks timed by the stats */
+typedef enum pca9685_stats_bus {
+    PCA9685_STATS_READ,
+    PCA9685_STATS_WRITE,
+    PCA9685_STATS_BLOCK_READ,
+    PCA9685_STATS_BLOCK_WRITE,
+    PCA9685_STATS_TRANSFER,
+    PCA9685_STATS_BUS_CALLBACKS
+} pca9685_stats_bus;
+
+/** Public operations timed by the stats */
+typedef enum pca9685_stats_op {
+    PCA9685_STATS_SET_FREQUENCY,
+    PCA9685_STATS_SET_DUTY_CYCLE,
+    PCA9685_STATS_SOFT_RESET,
+    PCA9685_STATS_HARD_RESET,
+    PCA9685_STATS_OPS
+} pca9685_stats_op;
+
+/** Counters and latency histograms kept while the handle's \c stats points here; see PCA9685_STATS */
+typedef struct pca9685_stats {
+    uint64_t reads;             // Register reads, a block read counting once
+    uint64_t writes;            // Register writes, a block write counting once
+    uint64_t bytes;             // Register bytes read and written
+    uint64_t transactions;      // Bus callback calls; a combined transfer of several writes is one
+    uint64_t elided;            // Register bytes not sent because the device already held them
+    uint64_t errors;            // Reads and writes the bus callbacks failed
+    uint64_t sleeps;            // Waits for the oscillator to settle
+    uint64_t sleep_ns;          // Time spent in them
+    pca9685_histogram_s bus[PCA9685_STATS_BUS_CALLBACKS];
+    pca9685_histogram_s ops[PCA9685_STATS_OPS];
+} pca9685_stats_s;
+
+/** Device state as read back from the chip, see snapshot */
+typedef struct pca9685_snapshot {
+    u8 registers[70];           // MODE1 through LED15_OFF_H, as read
+    u8 prescale;                // PRE_SCALE, as read
+    int frequency;              // Effective PWM output frequency in Hz, from the prescale
+    uint16_t on[16];            // Per-channel on step; bit 12 is the full-on bit
+    uint16_t off[16];           // Per-channel off step; bit 12 is the full-off bit
+    u8 sleeping;                // MODE1 SLEEP: oscillator off, as after power-up or a brownout
+    u8 restart;                 // MODE1 RESTART: PWM was running when the chip was put to sleep
+    u8 auto_increment;          // MODE1 AI, as found; a block-read snapshot sets it on the device to read the rest
+    u8 inverted;                // MODE2 INVRT
+    u8 totem_pole;              // MODE2 OUTDRV
+} pca9685_snapshot_s;
+
+/** Brightness correction curves, selected per channel */
+typedef enum pca9685_curve {
+    PCA9685_CURVE_LINEAR,       // Steps proportional to the input
+    PCA9685_CURVE_GAMMA,        // Steps proportional to the input to the power PCA9685_GAMMA (default 2.2)
+    PCA9685_CURVE_CIE           // CIE 1931 lightness: the input is perceived brightness
+} pca9685_curve;
+
+/**
+ * LED register image: 16 channels of { ON_L, ON_H, OFF_L, OFF_H }, exactly as laid out from LEDn_ON_L
+ * (0x06) on. write_frame sends it to the chip as it is, with no repacking or copy, so a renderer can
+ * write into it directly.
+ */
+typedef struct pca9685_frame {
+    u8 led[64];
+} pca9685_frame_s;
+
+static_assert(sizeof(pca9685_frame_s) == 64, "pca9685_frame_s is the 64-byte LED register image");
+
+/** Bit 4 of ON_H and OFF_H: the channel's full-on and full-off bits; full off wins */
+#define PCA9685_FRAME_FULL 0x10
+
+/** Sets a channel's on and off steps (0–4095), clearing its full bits */
+static inline void pca9685_frame_set_steps(pca9685_frame_s *frame, int channel, uint16_t on, uint16_t off) {
+    u8 *led = &frame->led[channel * 4];
+
+    led[0] = (u8)on;
+    led[1] = (u8)((on >> 8) & 0x0F);
+    led[2] = (u8)off;
+    led[3] = (u8)((off >> 8) & 0x0F);
+}
+
+/** Holds a channel fully on, or fully off, keeping its step counts */
+static inline void pca9685_frame_set_full_on(pca9685_frame_s *frame, int channel) {
+    frame->led[channel * 4 + 1] |= PCA9685_FRAME_FULL;
+    frame->led[channel * 4 + 3] &= (u8)~PCA9685_FRAME_FULL;
+}
+
+static inline void pca9685_frame_set_full_off(pca9685_frame_s *frame, int channel) {
+    frame->led[channel * 4 + 3] |= PCA9685_FRAME_FULL;
+}
+
 /** Public API function signatures */
 typedef void (*pca9685_fn)(struct pca9685_driver *driver);
 typedef void (*pca9685_chan_freq_fn)(struct pca9685_driver *driver, int chan_or_freq);
 typedef void (*pca9685_duty_cycle_fn)(struct pca9685_driver *, int led_channel, int delay_percent, int percent_on);
+typedef void (*pca9685_steps_fn)(struct pca9685_driver *, int led_channel, int on_step, int off_step);
+typedef void (*pca9685_brightness_fn)(struct pca9685_driver *, int led_channel, uint32_t q16);
+typedef void (*pca9685_brightness_frame_fn)(struct pca9685_driver *, const uint32_t *q16);
+typedef int (*pca9685_query_fn)(struct pca9685_driver *driver);
+typedef void (*pca9685_frame_fn)(struct pca9685_driver *driver, const pca9685_frame_s *frame);
+typedef void (*pca9685_snapshot_fn)(struct pca9685_driver *driver, pca9685_snapshot_s *snapshot);
+typedef int (*pca9685_reconcile_fn)(struct pca9685_driver *driver, const pca9685_snapshot_s *snapshot);
+typedef void (*pca9685_curve_fn)(struct pca9685_driver *driver, int led_channel, pca9685_curve curve);
+typedef void (*pca9685_stats_fn)(struct pca9685_driver *driver, pca9685_stats_s *stats);
+
+/** The operations of a handle, in one table shared by all of them; pca9685_configure_handle points the
+ * handle's \c ops at it, and with PCA9685_HANDLE_OPS also copies it into the handle's own members. */
+typedef struct pca9685_ops {
+    pca9685_fn soft_reset;
+    pca9685_fn hard_reset;
+    pca9685_chan_freq_fn set_frequency;
+    pca9685_chan_freq_fn channel_on;
+    pca9685_chan_freq_fn channel_off;
+    pca9685_duty_cycle_fn set_duty_cycle;
+    pca9685_steps_fn set_steps;
+    pca9685_brightness_fn set_brightness;
+    pca9685_brightness_frame_fn set_brightness_all;
+    pca9685_curve_fn set_curve;
+    pca9685_fn invalidate;
+    pca9685_fn resync;
+    pca9685_snapshot_fn snapshot;
+    pca9685_reconcile_fn reconcile;
+    pca9685_fn begin_frame;
+    pca9685_fn commit_frame;
+    pca9685_frame_fn write_frame;
+    pca9685_query_fn is_ready;
+    pca9685_fn wait_ready;
+    pca9685_query_fn check_idle;
+    pca9685_stats_fn read_stats;
+    pca9685_fn reset_stats;
+} pca9685_ops_s;
 
 /** Type definition for the driver handle */
 typedef struct pca9685_driver {
@@ -82,17 +360,63 @@ typedef struct pca9685_driver {
     u8 address;                            // Last register read to/written from
     string command;                        // Last command attempted
     string status;                         // Status (ok) or error message
+    u8 shadow[256];                        // Shadow copy of the device register map
+    u8 shadow_known[32];                   // Bitmap of shadow registers known to match the device
+    u8 frame[64];                          // LED registers staged by the open frame
+    uint16_t frame_staged;                 // Bitmap of channels staged by the open frame
+    u8 frame_open;                         // Non-zero between begin_frame and commit_frame
     pca9685_i2c_bus_read_cb bus_reader;    // I2C Bus reader callback
     pca9685_i2c_bus_write_cb bus_writer;   // I2C Bus writer callback
+    pca9685_i2c_bus_block_write_cb bus_block_writer; // Optional I2C Bus block writer callback
+    pca9685_i2c_bus_block_read_cb bus_block_reader; // Optional I2C Bus block reader callback
+    pca9685_i2c_bus_transfer_cb bus_transfer; // Optional I2C Bus combined transfer callback
+    void *bus_context;                     // Caller's data for the bus callbacks, e.g. a file descriptor
+    u8 slave_address;                      // 7-bit I2C address, for callbacks serving several devices
+    u8 mode1_flags;                        // MODE1 ALLCALL/SUBn bits kept set by every MODE1 write
+    u8 curves[16];                         // pca9685_curve of each channel; zero is linear
+    u8 nonblocking;                        // Non-zero to return before the oscillator settles, see is_ready
+    u8 latched;                            // Non-zero for frames whose channels all change at one STOP; needs bus_block_writer or bus_transfer
+    uint64_t settle_deadline;              // CLOCK_MONOTONIC ns at which the oscillator is stable; 0 if it is
+    uint32_t idle_sleep_ms;                // Non-zero to sleep the device once all channels have been off this long; see check_idle
+    uint64_t idle_since;                   // CLOCK_MONOTONIC ns since which every channel has been off; 0 while any may be on
+    u8 waking;                             // Non-zero between a lazy wake and the PWM restart that completes it
+    pca9685_trace_cb trace;                // Optional trace callback; see PCA9685_TRACE_LEVEL
+    pca9685_stats_s *stats;                // Optional storage for counters and latency histograms; see PCA9685_STATS
+    struct pca9685_recorder *recorder;     // Optional binary bus recorder; see pca9685_record.h and PCA9685_RECORDER
+    const pca9685_ops_s *ops;              // Operations, shared by every handle: h->ops->set_steps(h, ...)
+#if PCA9685_HANDLE_OPS
     pca9685_fn soft_reset;                 // Attempts an orderly shutdown, saving register values
     pca9685_fn hard_reset;                 // Resets to manufacturer defaults
     pca9685_chan_freq_fn set_frequency;    // Set output frequency; default is 200Hz
     pca9685_chan_freq_fn channel_on;       // Set LED channel on; ALL (-1) acts on all channels
     pca9685_chan_freq_fn channel_off;      // Set LED channel off; ALL (-1) acts on all channels
     pca9685_duty_cycle_fn set_duty_cycle;  // Set duty cycle % and delay % for more control; ALL (-1) acts on all channels
+    pca9685_steps_fn set_steps;            // Set raw 12-bit on and off steps (0–4095); ALL (-1) acts on all channels
+    pca9685_brightness_fn set_brightness;  // Set Q16 brightness (0x10000 is fully on); ALL (-1) acts on all channels
+    pca9685_brightness_frame_fn set_brightness_all; // Set Q16 brightness on all 16 channels from an array
+    pca9685_curve_fn set_curve;            // Set the brightness curve; ALL (-1) acts on all channels
+    pca9685_fn invalidate;                 // Forget the shadow registers; the next access of each goes to the bus
+    pca9685_fn resync;                     // Re-read the shadow registers from the device
+    pca9685_snapshot_fn snapshot;          // Read back the device's registers, bypassing the shadow
+    pca9685_reconcile_fn reconcile;        // Rewrite registers a snapshot shows diverged from those written
+    pca9685_fn begin_frame;                // Stage LED updates in memory until commit_frame
+    pca9685_fn commit_frame;               // Send the staged LED updates, one transaction per changed run
+    pca9685_frame_fn write_frame;          // Send a pca9685_frame_s as it is: one write of the span that changed
+    pca9685_query_fn is_ready;             // Non-zero once the oscillator has settled after a wake-up
+    pca9685_fn wait_ready;                 // Block until the oscillator has settled
+    pca9685_query_fn check_idle;           // Sleep the device if the idle policy says so; non-zero while it sleeps
+    pca9685_stats_fn read_stats;           // Copy the stats out; zeros if the handle keeps none
+    pca9685_fn reset_stats;                // Zero the stats
+#endif
 } pca9685_s;
 
+extern const pca9685_ops_s pca9685_ops;
+
 /** Private, used by the macro defined above. */
 pca9685_s pca9685_configure_handle(pca9685_s);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
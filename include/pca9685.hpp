@@ -0,0 +1,194 @@
+/**
+ * \file pca9685.hpp
+ *
+ * \brief Header-only C++17 wrapper over the C driver, with compile-time channels and a static bus policy
+ *
+ * The C handle stays underneath, shadow registers and all. The wrapper adds:
+ *  - register addresses, clamping and percent-to-steps calculations as \c constexpr functions, so
+ *    constant arguments fold away;
+ *  - a bus policy class in place of the read/write callbacks, called directly by the channel setters
+ *    that take the channel as a template argument, so they can inline down to the bus write through
+ *    the driver's own minimal-write helpers in pca9685_led.h;
+ *  - frame scopes that commit when they go out of scope.
+ *
+ * Usage:
+ *
+ * \code
+ * // A bus policy: three member functions taking the 7-bit slave address, returning 0 on success
+ * struct my_bus {
+ *     u8 read(u8 slave, u8 reg);
+ *     u8 write(u8 slave, u8 reg, u8 value);
+ *     u8 write_block(u8 slave, u8 reg, const u8 *values, u8 length);
+ * };
+ *
+ * my_bus bus;
+ * pca9685::device<my_bus> board(bus, 0x40);
+ *
+ * // Channel and values known at compile time: the register bytes are constants
+ * board.set_steps<5>(0, 2048);
+ * board.set_duty_cycle<6, 0, 25>();
+ * board.channel_off<7>();
+ *
+ * // Several updates sent together when the scope ends
+ * {
+ *     auto frame = board.frame();
+ *     board.set_brightness(3, 0x8000);
+ *     board.channel_on<4>();
+ * }
+ *
+ * // Everything else goes through the C handle
+ * board.handle().ops->set_frequency(&board.handle(), 500);
+ * \endcode
+ */
+
+#ifndef PCA9685_HPP
+#define PCA9685_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "pca9685_led.h"
+
+namespace pca9685 {
+
+using led_bytes = std::array<u8, PCA9685_LED_BYTES>;
+
+/** Channel to first LED register; out-of-range channels fail to compile */
+template <int Channel>
+constexpr u8 register_base() {
+    static_assert(Channel >= 0 && Channel < PCA9685_CHANNELS, "PCA9685 channels are 0-15");
+
+    return static_cast<u8>(PCA9685_LED_BASE(Channel));
+}
+
+constexpr int clamp_steps(int steps) {
+    return steps < 0 ? 0 : steps > PCA9685_LED_STEPS_MAX ? PCA9685_LED_STEPS_MAX : steps;
+}
+
+/** round(4096 * p / 100), p clamped to 0–100 */
+constexpr int percent_steps(int percent) {
+    int const p = percent < 0 ? 0 : percent > 100 ? 100 : percent;
+
+    return ((PCA9685_LED_STEPS_MAX + 1) * p + 50) / 100;
+}
+
+/** Bytes for a duty cycle of \c percent after a delay of \c delay percent, as set_duty_cycle computes them */
+constexpr led_bytes duty_cycle(int delay, int percent) {
+    int const delay_steps = percent_steps(delay);
+    int const on = delay_steps <= 0 ? 0 : delay_steps - 1;
+    int off = delay_steps + percent_steps(percent) - 1;
+
+    off = off <= 0 ? PCA9685_LED_STEPS_MAX : off > PCA9685_LED_STEPS_MAX + 1 ? off - (PCA9685_LED_STEPS_MAX + 1) : off;
+
+    return { static_cast<u8>(on & 0xFF), static_cast<u8>(on >> 8), static_cast<u8>(off & 0xFF), static_cast<u8>(off >> 8) };
+}
+
+/**
+ * A PCA9685 behind the bus policy \c Bus. Holds the C handle, whose callbacks forward to the policy;
+ * it points back at the device, so devices can't be copied or moved.
+ */
+template <class Bus>
+class device {
+public:
+    /** \c options can carry any handle settings, e.g. nonblocking or latched; the callbacks are filled in */
+    device(Bus &bus, u8 slave, pca9685_s options = {}) : bus_(bus) {
+        options.bus_reader = read;
+        options.bus_writer = write;
+        options.bus_block_writer = write_block;
+        options.bus_context = this;
+        options.slave_address = slave;
+        handle_ = pca9685_configure_handle(options);
+    }
+
+    device(const device &) = delete;
+    device &operator=(const device &) = delete;
+
+    pca9685_s &handle() { return handle_; }
+    const pca9685_s &handle() const { return handle_; }
+
+    /** Compile-time channel: straight to the bus policy when the handle allows, the C driver otherwise */
+    template <int Channel>
+    void set_steps(int on, int off) {
+        if(!write_led(register_base<Channel>(), clamp_steps(on), clamp_steps(off))) handle_.ops->set_steps(&handle_, Channel, on, off);
+    }
+
+    template <int Channel, int Delay, int Percent>
+    void set_duty_cycle() {
+        constexpr led_bytes led = duty_cycle(Delay, Percent);
+
+        // Curves other than linear reshape the duty cycle; the C driver applies them
+        if(handle_.curves[Channel] != PCA9685_CURVE_LINEAR || !write_led(register_base<Channel>(), led.data())) {
+            handle_.ops->set_duty_cycle(&handle_, Channel, Delay, Percent);
+        }
+    }
+
+    template <int Channel>
+    void channel_on() {
+        if(!write_led(register_base<Channel>(), PCA9685_LED_FULL_STEPS, 0)) handle_.ops->channel_on(&handle_, Channel);
+    }
+
+    template <int Channel>
+    void channel_off() {
+        if(!write_led(register_base<Channel>(), 0, PCA9685_LED_FULL_STEPS)) handle_.ops->channel_off(&handle_, Channel);
+    }
+
+    /** Run-time channels, or ALL (-1), through the C driver */
+    void set_steps(int channel, int on, int off) { handle_.ops->set_steps(&handle_, channel, on, off); }
+    void set_brightness(int channel, uint32_t q16) { handle_.ops->set_brightness(&handle_, channel, q16); }
+    void set_duty_cycle(int channel, int delay, int percent) { handle_.ops->set_duty_cycle(&handle_, channel, delay, percent); }
+    void channel_on(int channel) { handle_.ops->channel_on(&handle_, channel); }
+    void channel_off(int channel) { handle_.ops->channel_off(&handle_, channel); }
+    void set_frequency(int frequency) { handle_.ops->set_frequency(&handle_, frequency); }
+
+    /** Stages LED updates from construction and commits them on destruction */
+    class frame_scope {
+    public:
+        explicit frame_scope(device &d) : device_(d) { device_.handle_.ops->begin_frame(&device_.handle_); }
+        ~frame_scope() { device_.handle_.ops->commit_frame(&device_.handle_); }
+
+        frame_scope(const frame_scope &) = delete;
+        frame_scope &operator=(const frame_scope &) = delete;
+
+    private:
+        device &device_;
+    };
+
+    [[nodiscard]] frame_scope frame() { return frame_scope(*this); }
+
+private:
+    Bus &bus_;
+    pca9685_s handle_;
+
+    static device &self(pca9685_s *h) { return *static_cast<device *>(h->bus_context); }
+
+    static u8 read(pca9685_s *h, u8 reg) { return self(h).bus_.read(h->slave_address, reg); }
+    static u8 write(pca9685_s *h, u8 reg, u8 value) { return self(h).bus_.write(h->slave_address, reg, value); }
+    static u8 write_block(pca9685_s *h, u8 reg, u8 length, const u8 *values) {
+        return self(h).bus_.write_block(h->slave_address, reg, values, length);
+    }
+
+    static u8 write_led_bytes(void *context, u8 reg, u8 length, const u8 *values) {
+        device &d = *static_cast<device *>(context);
+
+        return length == 1 ? d.bus_.write(d.handle_.slave_address, reg, values[0])
+                           : d.bus_.write_block(d.handle_.slave_address, reg, values, length);
+    }
+
+    /** The C driver's minimal LED write (pca9685_led_write_direct), sent straight to the bus policy */
+    bool write_led(u8 base, const u8 *bytes) {
+        led_bytes led = { bytes[0], bytes[1], bytes[2], bytes[3] };
+
+        return pca9685_led_write_direct(&handle_, base, led.data(), write_led_bytes, this);
+    }
+
+    bool write_led(u8 base, int on, int off) {
+        led_bytes led;
+        pca9685_encode_led(led.data(), on, off);
+
+        return pca9685_led_write_direct(&handle_, base, led.data(), write_led_bytes, this);
+    }
+};
+
+}
+
+#endif
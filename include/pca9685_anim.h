@@ -0,0 +1,106 @@
+/**
+ * \file pca9685_anim.h
+ *
+ * \brief Keyframed fades, evaluated in fixed point at a tick rate the bus can keep up with
+ *
+ * Usage:
+ *
+ * \code
+ * // Tracks live in storage you provide; nothing is allocated per fade or per tick
+ * static pca9685_track_s my_tracks[256];
+ * static pca9685_anim_s my_anim = { .tracks=my_tracks, .capacity=256, .tick_hz=100, .bus_hz=400000 };
+ *
+ * // Fade channel 3 from off to full over 2s (times are CLOCK_MONOTONIC nanoseconds)
+ * pca9685_anim_fade(&my_anim, &my_driver, 3, 0, 0x10000, 2000, PCA9685_EASE_IN_OUT, now);
+ *
+ * // Or play keyframes: the easing of each keyframe shapes the segment leading to it
+ * static const pca9685_keyframe_s pulse[] = {
+ *     { 0, 0, PCA9685_EASE_LINEAR }, { 300, 0x10000, PCA9685_EASE_OUT }, { 1000, 0, PCA9685_EASE_EXPONENTIAL }
+ * };
+ * pca9685_track_s *track = pca9685_anim_play(&my_anim, &my_driver, 4, pulse, 3, now);
+ * track->loop = 1;
+ *
+ * // Call from your loop; each tick sends one frame per device with only the channels that changed
+ * while(pca9685_anim_tick(&my_anim, now) > 0) sleep_until(pca9685_anim_next_tick(&my_anim));
+ *
+ * // Devices on a pca9685_bus_s can share one combined transfer per tick instead
+ * my_anim.bus = &my_bus;
+ * \endcode
+ */
+
+#ifndef PCA9685_ANIM_H
+#define PCA9685_ANIM_H
+
+#include "pca9685.h"
+#include "pca9685_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Easing curves; progress and output are Q16 fixed point */
+typedef enum pca9685_easing {
+    PCA9685_EASE_LINEAR,
+    PCA9685_EASE_IN,          // Quadratic, slow start
+    PCA9685_EASE_OUT,         // Quadratic, slow finish
+    PCA9685_EASE_IN_OUT,      // Quadratic, slow start and finish
+    PCA9685_EASE_EXPONENTIAL  // 2^(10(t-1)), for fades that look even to the eye
+} pca9685_easing;
+
+/** A level to reach \c at_ms after the track starts, shaped by \c easing on the way there; the track
+ * holds the first keyframe's level until its \c at_ms */
+typedef struct pca9685_keyframe {
+    uint32_t at_ms;
+    uint32_t level;           // Q16 brightness, 0x10000 is fully on
+    pca9685_easing easing;
+} pca9685_keyframe_s;
+
+/** One channel's animation */
+typedef struct pca9685_track {
+    pca9685_s *device;
+    int channel;
+    const pca9685_keyframe_s *keyframes;
+    int count;
+    int segment;              // Keyframe the track is heading for
+    uint64_t start;           // CLOCK_MONOTONIC ns
+    u8 active;
+    u8 loop;                  // Non-zero to start over after the last keyframe
+    pca9685_keyframe_s fade[2]; // Keyframes of tracks started by pca9685_anim_fade
+} pca9685_track_s;
+
+typedef struct pca9685_anim {
+    pca9685_track_s *tracks;  // Caller's storage for \c capacity tracks
+    int capacity;
+    uint32_t tick_hz;         // Requested tick rate; 0 ticks whenever called
+    uint32_t bus_hz;          // I2C clock, used to cap the tick rate; 0 for no cap
+    pca9685_bus_s *bus;       // Optional: commit every device on this bus in one transfer per tick
+    uint64_t next_tick;       // Earliest time the next tick does any work
+    uint64_t tick_cost;       // Smoothed measured duration of a tick's bus traffic, in ns
+} pca9685_anim_s;
+
+/** Starts a track on a device channel, replacing any running there; returns NULL if there's no room or
+ * the keyframes' \c at_ms aren't in ascending order */
+pca9685_track_s *pca9685_anim_play(pca9685_anim_s *anim, pca9685_s *device, int channel,
+    const pca9685_keyframe_s *keyframes, int count, uint64_t now);
+
+/** Starts a two-keyframe track from \c from to \c to over \c duration_ms */
+pca9685_track_s *pca9685_anim_fade(pca9685_anim_s *anim, pca9685_s *device, int channel,
+    uint32_t from, uint32_t to, uint32_t duration_ms, pca9685_easing easing, uint64_t now);
+
+/** Stops the track on a device channel, leaving the channel where it is */
+void pca9685_anim_stop(pca9685_anim_s *anim, pca9685_s *device, int channel);
+
+/** Evaluates and sends every track if a tick is due; returns the number of tracks still running */
+int pca9685_anim_tick(pca9685_anim_s *anim, uint64_t now);
+
+/** When the next tick is due */
+uint64_t pca9685_anim_next_tick(const pca9685_anim_s *anim);
+
+/** Q16 easing curve value at Q16 progress \c t */
+uint32_t pca9685_ease(pca9685_easing easing, uint32_t t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * \file pca9685_bus.h
+ *
+ * \brief Many PCA9685s on one I2C bus, sharing one set of bus callbacks
+ *
+ * Usage:
+ *
+ * \code
+ * // Bus callbacks take the 7-bit slave address; writes go out as combined transfers
+ * static pca9685_bus_s my_bus = { .reader=my_bus_reader, .transfer=my_bus_transfer };
+ *
+ * // Add each board by address; the returned handle works like any other driver handle
+ * pca9685_s *left = pca9685_bus_add(&my_bus, 0x40);
+ * pca9685_s *right = pca9685_bus_add(&my_bus, 0x41);
+ *
+ * // Stage updates on any number of boards, then send every board's changes in one transfer
+ * pca9685_bus_begin_all(&my_bus);
+ * left->set_brightness(left, 3, 0x8000);
+ * right->channel_off(right, -1);
+ * pca9685_bus_commit_all(&my_bus);
+ *
+ * // Put boards in groups; a group handle sends each write once, to the group's address
+ * pca9685_bus_join(&my_bus, left, PCA9685_SUBADR1);
+ * pca9685_bus_join(&my_bus, right, PCA9685_SUBADR1);
+ *
+ * pca9685_s *group = pca9685_bus_group(&my_bus, PCA9685_SUBADR1);
+ * group->set_frequency(group, 500);
+ *
+ * // Every board that joined PCA9685_ALLCALL goes dark with one write
+ * pca9685_bus_blackout(&my_bus);
+ * \endcode
+ */
+
+#ifndef PCA9685_BUS_H
+#define PCA9685_BUS_H
+
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Seven address pins' worth of boards (A0–A5 give 0x40–0x7F) */
+#define PCA9685_BUS_MAX_DEVICES 64
+
+/** Writes queued per combined transfer; larger commits are sent in several */
+#define PCA9685_BUS_MAX_WRITES 256
+
+/** Broadcast groups: the LED All Call address and the three subaddresses */
+typedef enum pca9685_group {
+    PCA9685_ALLCALL,
+    PCA9685_SUBADR1,
+    PCA9685_SUBADR2,
+    PCA9685_SUBADR3,
+    PCA9685_GROUPS
+} pca9685_group;
+
+struct pca9685_bus;
+
+/** A register write addressed to one device on the bus */
+typedef struct pca9685_bus_write {
+    u8 slave;
+    pca9685_i2c_write_s write;
+} pca9685_bus_write_s;
+
+/**
+ * Bus-level callbacks. The reader reads one register of the device at \c slave; the optional block
+ * reader reads \c length registers from \c address on in one transaction; the transfer sends \c count
+ * writes, possibly to different devices, as one combined transfer (repeated starts, one stop).
+ * Block reader and transfer return 0 on success.
+ */
+typedef u8 (*pca9685_bus_read_cb)(struct pca9685_bus *bus, u8 slave, u8 address);
+typedef u8 (*pca9685_bus_block_read_cb)(struct pca9685_bus *bus, u8 slave, u8 address, u8 length, u8 *values);
+typedef u8 (*pca9685_bus_transfer_cb)(struct pca9685_bus *bus, const pca9685_bus_write_s *writes, int count);
+
+/** Type definition for the bus */
+typedef struct pca9685_bus {
+    pca9685_bus_read_cb reader;                         // Bus reader callback
+    pca9685_bus_block_read_cb block_reader;             // Optional bus block reader callback
+    pca9685_bus_transfer_cb transfer;                   // Bus combined transfer callback
+    void *context;                                      // Caller's data for the callbacks
+    int count;                                          // Devices added so far
+    pca9685_s devices[PCA9685_BUS_MAX_DEVICES];         // Device handles, in the order added
+    pca9685_bus_write_s writes[PCA9685_BUS_MAX_WRITES]; // Scratch space for commit_all
+    u8 group_address[PCA9685_GROUPS];                   // 7-bit group addresses; 0 for the chip default
+    uint64_t members[PCA9685_GROUPS];                   // Bitmap of devices in each group, by index
+    pca9685_s groups[PCA9685_GROUPS];                   // Broadcast handles, see pca9685_bus_group
+} pca9685_bus_s;
+
+/** Adds the device at \c slave and returns its handle, or NULL if the bus is full */
+pca9685_s *pca9685_bus_add(pca9685_bus_s *bus, u8 slave);
+
+/** Returns the handle for the device at \c slave, or NULL */
+pca9685_s *pca9685_bus_device(pca9685_bus_s *bus, u8 slave);
+
+/** Opens a frame on every device */
+void pca9685_bus_begin_all(pca9685_bus_s *bus);
+
+/** Commits every device's open frame; all devices' changes go out back to back in one transfer */
+void pca9685_bus_commit_all(pca9685_bus_s *bus);
+
+/** Sets a group's 7-bit address, rewriting it on current members; 0 restores the chip default */
+void pca9685_bus_set_group_address(pca9685_bus_s *bus, pca9685_group group, u8 address);
+
+/** Adds a device to a group, or takes it out: writes the group's address register and MODE1 bit */
+void pca9685_bus_join(pca9685_bus_s *bus, pca9685_s *device, pca9685_group group);
+void pca9685_bus_leave(pca9685_bus_s *bus, pca9685_s *device, pca9685_group group);
+
+/**
+ * Returns the group's broadcast handle. Its writes go out once, to the group address, and land in
+ * every member's shadow registers; a write is only elided if every member already holds the value.
+ * Reads are answered by the first member. Fetching it sets auto-increment on each member that lacks
+ * it, by unicast from the member's own MODE1; if the members' MODE1 still differ, say one is asleep,
+ * the group's multi-byte writes go out a byte at a time. Fetch the handle again after unicast writes
+ * to members, so it sees them.
+ */
+pca9685_s *pca9685_bus_group(pca9685_bus_s *bus, pca9685_group group);
+
+/** Turns every channel of every PCA9685_ALLCALL member off with one broadcast */
+void pca9685_bus_blackout(pca9685_bus_s *bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
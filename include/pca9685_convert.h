@@ -0,0 +1,73 @@
+/**
+ * \file pca9685_convert.h
+ *
+ * \brief Bulk conversion of brightness levels for many devices into LED register images
+ *
+ * Converts 16 levels per device through a brightness curve into on/off steps, with an optional
+ * phase offset per channel, and packs them straight into pca9685_frame_s images ready for
+ * write_frame. The work is done 4 or 8 channels at a time with SSE2, AVX2 or NEON, picked for the
+ * CPU at run time; the scalar kernel produces byte-identical images. NEON is only built with the
+ * CMake option PCA9685_NEON until it has been verified on an AArch64 target.
+ *
+ * Usage:
+ *
+ * \code
+ * // 40 devices' worth of levels, 0xFFFF fully on; channel c of device d is levels[d * 16 + c]
+ * static uint16_t levels[40 * 16];
+ * static pca9685_frame_s images[40];
+ *
+ * // Stagger each channel's pulse by 256 steps, so the outputs don't all switch on at once
+ * static const uint16_t phase[16] = { 0, 256, 512, 768, 1024, 1280, 1536, 1792,
+ *                                     2048, 2304, 2560, 2816, 3072, 3328, 3584, 3840 };
+ *
+ * pca9685_convert_frames(images, levels, 40, PCA9685_CURVE_CIE, phase);
+ * for(int d = 0; d < 40; d++) drivers[d].write_frame(&drivers[d], &images[d]);
+ *
+ * // Pin a kernel, e.g. to compare them; returns -1 if the CPU or build lacks it
+ * pca9685_convert_select(PCA9685_SIMD_SCALAR);
+ * \endcode
+ */
+
+#ifndef PCA9685_CONVERT_H
+#define PCA9685_CONVERT_H
+
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Conversion kernels */
+typedef enum pca9685_simd {
+    PCA9685_SIMD_AUTO,          // The fastest the CPU supports
+    PCA9685_SIMD_SCALAR,
+    PCA9685_SIMD_SSE2,          // x86-64
+    PCA9685_SIMD_AVX2,          // x86-64, with a gather for the curve tables
+    PCA9685_SIMD_NEON           // AArch64
+} pca9685_simd;
+
+/**
+ * Converts \c count devices' levels (16 each) through \c curve into register images. A level L is Q16
+ * brightness L + L / 0x8000, so 0xFFFF is fully on; with no phase, each channel gets the same steps
+ * set_brightness gives that Q16 level. Levels that come to 0 or 4096 steps use the full-off and
+ * full-on bits; anything between turns on at its channel's \c phase step (0–4095; NULL for 0 on
+ * every channel) and stays on for as many steps as the level asks for, wrapping at the end of the period.
+ */
+void pca9685_convert_frames(pca9685_frame_s *frames, const uint16_t *levels, int count,
+    pca9685_curve curve, const uint16_t *phase);
+
+/** Pins the kernel pca9685_convert_frames uses; returns -1, leaving it as it was, if it's unavailable.
+ * Safe to call while other threads convert: each conversion runs wholly on one kernel */
+int pca9685_convert_select(pca9685_simd simd);
+
+/** The kernel pca9685_convert_frames is using */
+pca9685_simd pca9685_convert_kernel(void);
+
+/** Name of a kernel, for reports */
+const char *pca9685_simd_name(pca9685_simd simd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * \file pca9685_fleet.h
+ *
+ * \brief Compact state for hundreds of PCA9685s: one cache-aligned arena, laid out array by array
+ *
+ * A fleet keeps only what LED updates need per device: its slave address, a shadow of its 64 LED
+ * registers (one cache line), the LED bytes staged since the last commit (another), and bitmaps of
+ * known and staged channels. Devices with staged changes are marked in a fleet-wide bitmap, so a
+ * commit only visits those. Everything lives in caller-provided storage.
+ *
+ * Usage:
+ *
+ * \code
+ * // Storage for 200 devices; the arena is aligned to a cache line inside whatever you pass
+ * static u8 my_arena[PCA9685_FLEET_ARENA_SIZE(200)];
+ * static pca9685_fleet_s my_fleet = { .transfer=my_fleet_transfer, .context=my_buses };
+ *
+ * // Slave addresses by device index; the transfer callback routes each write by its device index
+ * pca9685_fleet_init(&my_fleet, my_arena, sizeof(my_arena), my_slaves, 200);
+ *
+ * // Turn on auto-increment everywhere, and set the PWM frequency of every device
+ * pca9685_fleet_start(&my_fleet);
+ * pca9685_fleet_set_frequency(&my_fleet, 1000);
+ *
+ * // Stage channel updates on any devices, then send only the changed bytes, in as few transfers as fit
+ * pca9685_fleet_set_brightness(&my_fleet, 17, 3, 0x8000);
+ * pca9685_fleet_set_steps(&my_fleet, 150, -1, 0, 2048);
+ * pca9685_fleet_commit(&my_fleet);
+ * \endcode
+ */
+
+#ifndef PCA9685_FLEET_H
+#define PCA9685_FLEET_H
+
+#include <stddef.h>
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Cache line size the arena's arrays are aligned to */
+#define PCA9685_FLEET_LINE 64
+
+/** LED register bytes per device, from LED0_ON_L */
+#define PCA9685_FLEET_LED_BYTES 64
+
+/** Writes queued per transfer; larger commits are sent in several */
+#define PCA9685_FLEET_MAX_WRITES 256
+
+#define PCA9685_FLEET_LINES(bytes) (((bytes) + PCA9685_FLEET_LINE - 1) / PCA9685_FLEET_LINE * PCA9685_FLEET_LINE)
+
+/** Bytes of storage for \c n devices, including the slack to align it */
+#define PCA9685_FLEET_ARENA_SIZE(n) ((size_t)(PCA9685_FLEET_LINE - 1 \
+    + 2 * (n) * PCA9685_FLEET_LED_BYTES \
+    + 2 * PCA9685_FLEET_LINES(2 * (n)) \
+    + PCA9685_FLEET_LINES(n) \
+    + PCA9685_FLEET_LINES(8 * (((n) + 63) / 64))))
+
+struct pca9685_fleet;
+
+/** A register write to the fleet's device \c device, at \c slave */
+typedef struct pca9685_fleet_write {
+    uint16_t device;
+    u8 slave;
+    pca9685_i2c_write_s write;
+} pca9685_fleet_write_s;
+
+/**
+ * Sends \c count writes, in order; they may go to different devices, and to different buses if the
+ * fleet spans several. Returns 0 on success. The shadow of every LED write in a failed call is
+ * forgotten, so the next commit resends those channels in full.
+ */
+typedef u8 (*pca9685_fleet_transfer_cb)(struct pca9685_fleet *fleet, const pca9685_fleet_write_s *writes, int count);
+
+/** Type definition for the fleet; the arrays point into the arena, each starting on a cache line */
+typedef struct pca9685_fleet {
+    pca9685_fleet_transfer_cb transfer;                   // Transfer callback
+    void *context;                                        // Caller's data for the callback
+    pca9685_curve curve;                                  // Brightness curve of every channel
+    int count;                                            // Devices in the fleet
+    u8 (*shadow)[PCA9685_FLEET_LED_BYTES];                // LED registers as last written, per device
+    u8 (*staged)[PCA9685_FLEET_LED_BYTES];                // LED registers staged for the next commit
+    uint16_t *known;                                      // Channels whose shadow matches the device
+    uint16_t *pending;                                    // Channels staged since the last commit
+    u8 *slave;                                            // 7-bit slave address of each device
+    uint64_t *dirty;                                      // Devices with staged channels, one bit each
+    u8 prescale;                                          // PRE_SCALE last set, for set_frequency's writes
+    int nonblocking;                                      // set_frequency leaves the PWM restart to the next commit
+    uint64_t settle_deadline;                             // When the oscillator settles after set_frequency; 0 if not waiting
+    int queued;                                           // Writes waiting in \c writes
+    u8 result;                                            // OR of the results since the last commit began
+    pca9685_fleet_write_s writes[PCA9685_FLEET_MAX_WRITES]; // Scratch space for commit
+} pca9685_fleet_s;
+
+/** Bytes of storage for \c count devices; same as PCA9685_FLEET_ARENA_SIZE */
+size_t pca9685_fleet_arena_size(int count);
+
+/** Lays the fleet out in \c arena and zeroes it; returns -1 if \c size is too small, 0 otherwise */
+int pca9685_fleet_init(pca9685_fleet_s *fleet, void *arena, size_t size, const u8 *slaves, int count);
+
+/** Sets MODE1 auto-increment (and All Call) on every device; LED writes of more than a byte need it */
+u8 pca9685_fleet_start(pca9685_fleet_s *fleet);
+
+/**
+ * Sets every device's PWM frequency: sleep and prescale, wake, then restart PWM after 500μs, one wait
+ * for the whole fleet. A nonblocking fleet returns after the wake; the next commit sends the restart,
+ * waiting out what is left of the 500μs first.
+ */
+u8 pca9685_fleet_set_frequency(pca9685_fleet_s *fleet, int frequency);
+
+/** Whether the oscillator has settled since set_frequency, so a commit won't wait for it */
+int pca9685_fleet_is_ready(const pca9685_fleet_s *fleet);
+
+/** Stage raw 12-bit steps or Q16 brightness on a device's channel; ALL (-1) stages all 16 */
+void pca9685_fleet_set_steps(pca9685_fleet_s *fleet, int device, int channel, int on, int off);
+void pca9685_fleet_set_brightness(pca9685_fleet_s *fleet, int device, int channel, uint32_t q16);
+
+/** Sends every staged change, each device's changed runs back to back; returns 0 on success */
+u8 pca9685_fleet_commit(pca9685_fleet_s *fleet);
+
+/** Forgets every device's shadow; the next commit sends staged channels in full */
+void pca9685_fleet_invalidate(pca9685_fleet_s *fleet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
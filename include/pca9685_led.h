@@ -0,0 +1,136 @@
+/**
+ * \file pca9685_led.h
+ *
+ * \brief LED register encoding and the driver's minimal write, for code that writes LED registers
+ * without going through the bus wrappers
+ *
+ * The C driver builds its own LED writes from these, and the C++ wrapper (pca9685.hpp) inlines them
+ * down to its bus policy. Everything is prefixed, so including this header brings no short names in.
+ */
+
+#ifndef PCA9685_LED_H
+#define PCA9685_LED_H
+
+#include <string.h>
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Register map and step limits (pp. 10, 21) */
+#define PCA9685_CHANNELS        16
+#define PCA9685_MODE1           0x00
+#define PCA9685_MODE1_AI        (1<<5)     // Register auto-increment
+#define PCA9685_LED0_ON_L       0x06
+#define PCA9685_LED_BYTES       4          // ON_L, ON_H, OFF_L, OFF_H of one channel
+#define PCA9685_LED_STEPS_MAX   4095
+#define PCA9685_LED_FULL_BIT    (1<<4)     // Full on/off bit of ON_H and OFF_H
+#define PCA9685_LED_FULL_STEPS  (PCA9685_LED_FULL_BIT << 8)
+
+/** First register of a zero-based channel */
+#define PCA9685_LED_BASE(channel) (PCA9685_LED0_ON_L + PCA9685_LED_BYTES * (channel))
+
+/** Shadow register file: whether a register's value is known, and setting a known value */
+static inline int pca9685_shadow_known(const pca9685_s *h, uint8_t r) {
+    return (h->shadow_known[r >> 3] >> (r & 7)) & 1;
+}
+
+static inline void pca9685_shadow_set(pca9685_s *h, uint8_t r, uint8_t d) {
+    h->shadow[r] = d;
+    h->shadow_known[r >> 3] |= (uint8_t)(1 << (r & 7));
+}
+
+/** ON and OFF values as one channel's four register bytes */
+static inline void pca9685_encode_led(uint8_t *led, int on, int off) {
+    led[0] = (uint8_t)(on & 0xFF);
+    led[1] = (uint8_t)(on >> 8);
+    led[2] = (uint8_t)(off & 0xFF);
+    led[3] = (uint8_t)(off >> 8);
+}
+
+/* Minimal-write encoding
+ *
+ * Full OFF (OFF_H bit 4) overrides everything else, and full ON (ON_H bit 4) overrides the step
+ * counts (p. 21). So a full-off channel only depends on one bit of OFF_H, and a full-on one on the
+ * full bits of ON_H and OFF_H. The bytes and bits the output doesn't depend on keep what the device
+ * holds, so they match the shadow and drop out of the write: switching a channel off is one byte,
+ * and switching it on is one or two. */
+static inline void pca9685_led_care_mask(const uint8_t *led, uint8_t *care) {
+    static const uint8_t full_off[PCA9685_LED_BYTES] = { 0, 0, 0, PCA9685_LED_FULL_BIT };
+    static const uint8_t full_on[PCA9685_LED_BYTES] = { 0, PCA9685_LED_FULL_BIT, 0, PCA9685_LED_FULL_BIT };
+
+    if(led[3] & PCA9685_LED_FULL_BIT) memcpy(care, full_off, PCA9685_LED_BYTES);
+    else if(led[1] & PCA9685_LED_FULL_BIT) memcpy(care, full_on, PCA9685_LED_BYTES);
+    else memset(care, 0xFF, PCA9685_LED_BYTES);
+}
+
+/** Applies the minimal-write encoding to one channel's bytes \c led, at \c base, against the shadow */
+static inline void pca9685_led_minimize(const pca9685_s *h, uint8_t base, uint8_t *led) {
+    uint8_t care[PCA9685_LED_BYTES];
+    pca9685_led_care_mask(led, care);
+
+    for(int i = 0; i < PCA9685_LED_BYTES; i++) {
+        uint8_t const r = (uint8_t)(base + i);
+        if(pca9685_shadow_known(h, r)) led[i] = (uint8_t)((h->shadow[r] & ~care[i]) | (led[i] & care[i]));
+    }
+}
+
+/** Records a bus call's outcome on the handle, as every bus wrapper does */
+static inline void pca9685_bus_status(pca9685_s *h, const char *command, uint8_t r, uint8_t d, uint8_t result) {
+    h->command = (string)command;
+    h->status = (string)(result == 0 ? "ok" : "error");
+    h->address = r;
+    h->data = d;
+}
+
+/** A write of \c length bytes from register \c reg in one transaction; 0 on success */
+typedef uint8_t (*pca9685_led_write_fn)(void *context, uint8_t reg, uint8_t length, const uint8_t *values);
+
+/**
+ * The driver's minimal write of one channel's bytes \c led at \c base, sent through \c write rather
+ * than the bus wrappers, for callers such as the C++ wrapper that inline it: the bytes are minimized
+ * against the shadow, only the span between the first and last changed byte goes out, and the shadow
+ * and status are updated as the wrappers would. Returns 0, having sent nothing, where the wrappers are
+ * needed: a frame is open, the handle traces, counts, records or has an idle power policy, or a
+ * multi-byte write would need auto-increment the shadow doesn't show set. Returns 1 otherwise.
+ */
+static inline int pca9685_led_write_direct(pca9685_s *h, uint8_t base, uint8_t *led, pca9685_led_write_fn write, void *context) {
+    if(h->frame_open || h->trace || h->stats || h->recorder || h->idle_sleep_ms) return 0;
+
+    pca9685_led_minimize(h, base, led);
+
+    int first = PCA9685_LED_BYTES, last = -1;
+    for(int i = 0; i < PCA9685_LED_BYTES; i++) {
+        uint8_t const r = (uint8_t)(base + i);
+        if(pca9685_shadow_known(h, r) && h->shadow[r] == led[i]) continue;
+
+        if(first == PCA9685_LED_BYTES) first = i;
+        last = i;
+    }
+
+    if(last < 0) return 1;
+
+    uint8_t const reg = (uint8_t)(base + first);
+    uint8_t const length = (uint8_t)(last - first + 1);
+
+    if(length > 1 && !(pca9685_shadow_known(h, PCA9685_MODE1) && (h->shadow[PCA9685_MODE1] & PCA9685_MODE1_AI))) return 0;
+
+    uint8_t const result = write(context, reg, length, &led[first]);
+
+    for(int i = first; i <= last; i++) {
+        uint8_t const r = (uint8_t)(base + i);
+        if(result == 0) pca9685_shadow_set(h, r, led[i]);
+        else h->shadow_known[r >> 3] &= (uint8_t)~(1 << (r & 7));
+    }
+
+    pca9685_bus_status(h, length == 1 ? "i2c_write" : "i2c_block_write", reg, led[last], result);
+
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
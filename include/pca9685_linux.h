@@ -0,0 +1,99 @@
+/**
+ * \file pca9685_linux.h
+ *
+ * \brief Linux i2c-dev backend: bus callbacks for a PCA9685 on /dev/i2c-N
+ *
+ * \see https://www.kernel.org/doc/html/latest/i2c/dev-interface.html
+ *
+ * Usage:
+ *
+ * \code
+ * // Open /dev/i2c-1 and bind the chip at 0x40; NULL uses the real system calls
+ * pca9685_linux_i2c_s my_bus;
+ * if(pca9685_linux_i2c_open(&my_bus, 1, 0x40, NULL) != 0) perror("pca9685");
+ *
+ * // Plug the backend's callbacks into a driver
+ * my_driver = pca9685(PCA9685_LINUX_I2C(&my_bus));
+ *
+ * // Frames with several changed runs now go out as one I2C_RDWR ioctl
+ * my_driver.commit_frame(&my_driver);
+ *
+ * // Or drive every board on the adapter through one bus; the slave passed to open is only the default
+ * static pca9685_bus_s boards = { PCA9685_LINUX_I2C_BUS(&my_bus) };
+ * pca9685_bus_add(&boards, 0x40);
+ * pca9685_bus_add(&boards, 0x41);
+ *
+ * pca9685_linux_i2c_close(&my_bus);
+ * \endcode
+ */
+
+#ifndef PCA9685_LINUX_H
+#define PCA9685_LINUX_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "pca9685.h"
+#include "pca9685_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Designated initializers binding an open backend, and the slave it was opened with, to a driver handle */
+#define PCA9685_LINUX_I2C(dev) \
+    .slave_address=(dev)->slave, \
+    .bus_reader=pca9685_linux_i2c_read, \
+    .bus_block_reader=pca9685_linux_i2c_block_read, \
+    .bus_writer=pca9685_linux_i2c_write, \
+    .bus_block_writer=pca9685_linux_i2c_block_write, \
+    .bus_transfer=pca9685_linux_i2c_transfer, \
+    .bus_context=(dev)
+
+/** Designated initializers binding an open backend to a pca9685_bus_s */
+#define PCA9685_LINUX_I2C_BUS(dev) \
+    .reader=pca9685_linux_i2c_bus_read, \
+    .block_reader=pca9685_linux_i2c_bus_block_read, \
+    .transfer=pca9685_linux_i2c_bus_transfer, \
+    .context=(dev)
+
+/** The system calls the backend makes; swap them out to run without hardware */
+typedef struct pca9685_linux_io {
+    int (*open)(const char *path, int flags);
+    int (*close)(int fd);
+    int (*ioctl)(int fd, unsigned long request, void *arg);
+    ssize_t (*write)(int fd, const void *buf, size_t count);
+} pca9685_linux_io_s;
+
+/** An open adapter with a bound slave address */
+typedef struct pca9685_linux_i2c {
+    int fd;                         // Adapter file descriptor
+    u8 slave;                       // 7-bit slave address
+    int error;                      // errno of the last failed call, or 0
+    const pca9685_linux_io_s *io;   // System calls in use
+} pca9685_linux_i2c_s;
+
+/** The real system calls */
+extern const pca9685_linux_io_s pca9685_linux_io;
+
+/** Opens /dev/i2c-<adapter> and binds \c slave; \c io may be NULL. Returns 0, or -1 with \c dev->error set. */
+int pca9685_linux_i2c_open(pca9685_linux_i2c_s *dev, int adapter, u8 slave, const pca9685_linux_io_s *io);
+void pca9685_linux_i2c_close(pca9685_linux_i2c_s *dev);
+
+/** Bus callbacks; the handle's bus_context must point to an open pca9685_linux_i2c_s */
+u8 pca9685_linux_i2c_read(pca9685_s *driver, u8 address);
+u8 pca9685_linux_i2c_block_read(pca9685_s *driver, u8 address, u8 length, u8 *values);
+u8 pca9685_linux_i2c_write(pca9685_s *driver, u8 address, u8 data);
+u8 pca9685_linux_i2c_block_write(pca9685_s *driver, u8 address, u8 length, const u8 *values);
+u8 pca9685_linux_i2c_transfer(pca9685_s *driver, const pca9685_i2c_write_s *writes, u8 count);
+
+/** Bus-level callbacks; the bus's context must point to an open pca9685_linux_i2c_s */
+u8 pca9685_linux_i2c_bus_read(pca9685_bus_s *bus, u8 slave, u8 address);
+u8 pca9685_linux_i2c_bus_block_read(pca9685_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values);
+u8 pca9685_linux_i2c_bus_transfer(pca9685_bus_s *bus, const pca9685_bus_write_s *writes, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
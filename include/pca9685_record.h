@@ -0,0 +1,141 @@
+/**
+ * \file pca9685_record.h
+ *
+ * \brief Binary bus recorder: every transaction the driver puts on the bus, in a ring, flushed to a file
+ *
+ * A handle whose \c recorder is set appends one 16-byte record per register byte it reads or writes
+ * over the bus (shadow reads and elided writes don't reach the bus, so they aren't recorded) into a
+ * ring you preallocate. Nothing blocks or allocates while recording; a full ring drops whole
+ * transactions, combined transfers included, and counts their records. Flush the ring to a file from
+ * your loop: the file is a header and the records as they are in memory, so it can be mapped and
+ * indexed directly. Replay feeds a trace back through any handles' bus callbacks, at the original
+ * pace or as fast as they go, and times it.
+ *
+ * Usage:
+ *
+ * \code
+ * // Storage for 64k records, shared by every handle recording into it
+ * static pca9685_record_s my_ring[1 << 16];
+ * static pca9685_recorder_s my_recorder;
+ * pca9685_recorder_init(&my_recorder, my_ring, 1 << 16);
+ * if(pca9685_recorder_open(&my_recorder, "bus.trace") != 0) perror("pca9685");
+ * my_driver.recorder = &my_recorder;
+ *
+ * // Now and then, e.g. once per frame; returns the records written
+ * pca9685_recorder_flush(&my_recorder);
+ * pca9685_recorder_close(&my_recorder);
+ *
+ * // Later, in the lab: map the trace and send it to handles with the same slave addresses
+ * size_t count;
+ * const pca9685_record_s *trace = pca9685_trace_map("bus.trace", &count);
+ * pca9685_replay_stats_s timing;
+ * pca9685_replay(trace, count, my_drivers, 4, PCA9685_REPLAY_ORIGINAL, &timing);
+ * pca9685_trace_unmap(trace, count);
+ * \endcode
+ */
+
+#ifndef PCA9685_RECORD_H
+#define PCA9685_RECORD_H
+
+#include <stddef.h>
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bus transactions in a trace */
+typedef enum pca9685_record_op {
+    PCA9685_RECORD_READ,        // Register read
+    PCA9685_RECORD_WRITE,       // Register write
+    PCA9685_RECORD_BLOCK_READ,  // Auto-increment read, one record per byte
+    PCA9685_RECORD_BLOCK_WRITE, // Auto-increment write, one record per byte
+    PCA9685_RECORD_TRANSFER     // Combined transfer, one record per byte of each of its writes
+} pca9685_record_op;
+
+/** One register byte of a bus transaction. A transaction starts at the record with \c part and \c index 0. */
+typedef struct pca9685_record {
+    uint64_t timestamp;         // CLOCK_MONOTONIC ns at which the transaction completed
+    u8 slave;                   // 7-bit slave address of the device
+    u8 address;                 // Register
+    u8 value;                   // Byte written or read
+    u8 op;                      // pca9685_record_op
+    u8 result;                  // Bus callback's result, 0 for success
+    u8 index;                   // Byte's position within its write or read
+    u8 length;                  // Bytes in that write or read
+    u8 part;                    // Write's position within a combined transfer; 0 otherwise
+} pca9685_record_s;
+
+static_assert(sizeof(pca9685_record_s) == 16, "pca9685_record_s is 16 bytes, as stored in trace files");
+
+/** Trace file header; the records follow it, up to the end of the file */
+#define PCA9685_TRACE_MAGIC "PCA9685T"
+#define PCA9685_TRACE_VERSION 1
+
+typedef struct pca9685_trace_header {
+    char magic[8];              // PCA9685_TRACE_MAGIC, without a terminator
+    uint32_t version;           // PCA9685_TRACE_VERSION
+    uint32_t record_size;       // sizeof(pca9685_record_s)
+} pca9685_trace_header_s;
+
+/** Type definition for the recorder; the ring is caller-provided */
+typedef struct pca9685_recorder {
+    pca9685_record_s *ring;     // Storage for \c capacity records
+    uint32_t capacity;          // A power of two
+    uint64_t head;              // Records appended since init
+    uint64_t tail;              // Records flushed since init
+    uint64_t dropped;           // Records lost to a full ring
+    u8 dropping;                // Dropping the rest of a combined transfer that didn't fit
+    int fd;                     // Trace file; -1 when none is open
+} pca9685_recorder_s;
+
+/** Lays the recorder over \c ring; returns -1 unless \c capacity is a power of two, 0 otherwise */
+int pca9685_recorder_init(pca9685_recorder_s *recorder, pca9685_record_s *ring, uint32_t capacity);
+
+/** Creates or truncates the trace file at \c path and writes its header; returns 0 on success */
+int pca9685_recorder_open(pca9685_recorder_s *recorder, const char *path);
+
+/** Appends the records in the ring to the trace file; returns how many, or -1 on a write error */
+int pca9685_recorder_flush(pca9685_recorder_s *recorder);
+
+/** Flushes and closes the trace file */
+void pca9685_recorder_close(pca9685_recorder_s *recorder);
+
+/** Maps a trace file read-only; returns its records, or NULL if it isn't a trace. \c count receives how many. */
+const pca9685_record_s *pca9685_trace_map(const char *path, size_t *count);
+void pca9685_trace_unmap(const pca9685_record_s *records, size_t count);
+
+/** Replay pacing */
+typedef enum pca9685_replay_speed {
+    PCA9685_REPLAY_ORIGINAL,    // Each transaction at its recorded offset from the first
+    PCA9685_REPLAY_MAX          // Back to back
+} pca9685_replay_speed;
+
+/** Timing of a replay */
+typedef struct pca9685_replay_stats {
+    uint64_t transactions;      // Bus callback calls made
+    uint64_t bytes;             // Register bytes read and written
+    uint64_t errors;            // Calls that failed
+    uint64_t mismatched;        // Bytes read back other than as recorded
+    uint64_t skipped;           // Records for slave addresses no handle was given for, or for 0x00
+    uint64_t recorded_ns;       // Span of the trace, first record to last
+    uint64_t replayed_ns;       // Time the replay took
+    pca9685_histogram_s latency; // Per call
+    pca9685_histogram_s lag;    // How late each call was made against the recorded pace; ORIGINAL only
+} pca9685_replay_stats_s;
+
+/**
+ * Sends each recorded transaction through the bus callbacks of the handle in \c devices with the
+ * record's slave address, bypassing the driver, so the bus sees what it saw when recording. A block
+ * write goes out as single writes on a handle without a block writer, a combined transfer as block
+ * writes on one without a transfer callback, and likewise for block reads. Records for slave 0x00,
+ * the general call address, are skipped. Returns the transactions replayed.
+ */
+uint64_t pca9685_replay(const pca9685_record_s *records, size_t count, pca9685_s *devices, int device_count,
+    pca9685_replay_speed speed, pca9685_replay_stats_s *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * \file pca9685_worker.h
+ *
+ * \brief Threaded mode: a worker thread owns the handle and the bus, other threads submit channel updates
+ *
+ * Usage:
+ *
+ * \code
+ * // Hand the driver to a worker; from here on only the worker thread touches it
+ * static pca9685_worker_s my_worker;
+ * if(pca9685_worker_start(&my_worker, &my_driver) != 0) perror("pca9685");
+ *
+ * // From any thread: queue an update; the worker sends everything queued so far as one frame, and
+ * // only the latest update to each channel
+ * pca9685_request_s request = PCA9685_REQUEST_INIT;
+ * if(pca9685_worker_submit_brightness(&my_worker, 5, 0x8000, &request) != 0) handle_full_queue();
+ *
+ * // Each request reports its own outcome; NULL if you don't need it
+ * pca9685_worker_submit_steps(&my_worker, -1, 0, 0, NULL);
+ * while(pca9685_request_poll(&request) == PCA9685_REQUEST_PENDING) do_other_work();
+ *
+ * // Sends what's still queued, then joins the worker; the handle is the caller's again
+ * pca9685_worker_stop(&my_worker);
+ * \endcode
+ */
+
+#ifndef PCA9685_WORKER_H
+#define PCA9685_WORKER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "pca9685.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Queued updates; submissions fail while the queue is full. A power of two. */
+#define PCA9685_WORKER_RING 256
+
+/** Initializer for a request that hasn't been submitted */
+#define PCA9685_REQUEST_INIT { PCA9685_REQUEST_IDLE }
+
+typedef enum pca9685_request_state {
+    PCA9685_REQUEST_IDLE,       // Not submitted
+    PCA9685_REQUEST_PENDING,    // Queued, not yet sent
+    PCA9685_REQUEST_DONE,       // Sent, or already held by the device
+    PCA9685_REQUEST_FAILED,     // The bus reported an error sending it
+    PCA9685_REQUEST_SUPERSEDED  // Replaced by a later update to the same channel before it was sent
+} pca9685_request_state;
+
+/** Per-request completion, written by the worker; the caller owns it until it leaves PENDING */
+typedef struct pca9685_request {
+    atomic_int state;
+} pca9685_request_s;
+
+typedef enum pca9685_worker_op {
+    PCA9685_WORKER_STEPS,
+    PCA9685_WORKER_BRIGHTNESS
+} pca9685_worker_op;
+
+/** A queued channel update */
+typedef struct pca9685_worker_entry {
+    pca9685_worker_op op;
+    int channel;                // 0–15, or ALL (-1)
+    int on;                     // On step, for PCA9685_WORKER_STEPS
+    int off;                    // Off step, for PCA9685_WORKER_STEPS
+    uint32_t q16;               // Brightness, for PCA9685_WORKER_BRIGHTNESS
+    pca9685_request_s *request; // May be NULL
+} pca9685_worker_entry_s;
+
+/** A ring slot; its sequence number says whose turn it is (bounded MPMC queue, D. Vyukov) */
+typedef struct pca9685_worker_slot {
+    atomic_size_t sequence;
+    pca9685_worker_entry_s entry;
+} pca9685_worker_slot_s;
+
+typedef struct pca9685_worker {
+    pca9685_s *driver;                                  // Owned by the worker thread while it runs
+    pca9685_worker_slot_s ring[PCA9685_WORKER_RING];
+    atomic_size_t tail;                                 // Next slot producers claim
+    size_t head;                                        // Next slot the worker reads; worker only
+    atomic_int running;
+    atomic_int idle;                                    // Set while the worker waits for submissions
+    pthread_mutex_t lock;                               // Only for sleeping and waking the worker
+    pthread_cond_t wake;
+    pthread_t thread;
+} pca9685_worker_s;
+
+/** Starts a worker thread for \c driver; returns 0, or an errno value if the thread can't be created */
+int pca9685_worker_start(pca9685_worker_s *worker, pca9685_s *driver);
+
+/** Sends whatever is still queued and joins the worker thread */
+void pca9685_worker_stop(pca9685_worker_s *worker);
+
+/** Queue an update from any thread; returns 0, or -1 if the queue is full (\c request is then left IDLE) */
+int pca9685_worker_submit_steps(pca9685_worker_s *worker, int channel, int on, int off, pca9685_request_s *request);
+int pca9685_worker_submit_brightness(pca9685_worker_s *worker, int channel, uint32_t q16, pca9685_request_s *request);
+
+/** A request's current state; safe from any thread */
+pca9685_request_state pca9685_request_poll(pca9685_request_s *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PCA9685_RECORDER_H
+#define PCA9685_RECORDER_H
+
+#include "pca9685.h"
+#include "pca9685_record.h"
+
+/** Compile-time switch: 0 compiles the recorder out entirely. With it on, nothing is recorded unless
+ * the handle's recorder pointer is set. */
+#ifndef PCA9685_RECORDER
+#define PCA9685_RECORDER 1
+#endif
+
+/** Appends a record for each of the \c length bytes at \c data, read or written at \c address as the
+ * \c part'th write of a transaction */
+void pca9685_record_bus(pca9685_s *h, pca9685_record_op op, uint8_t part, uint8_t address, uint8_t length,
+    const uint8_t *data, uint8_t result);
+
+#if PCA9685_RECORDER
+#define RECORD_BUS(h, ...) do { if((h)->recorder) pca9685_record_bus((h), __VA_ARGS__); } while(0)
+#else
+#define RECORD_BUS(h, ...) ((void)0)
+#endif
+
+#endif
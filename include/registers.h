@@ -3,6 +3,11 @@
 
 #include <inttypes.h>
 #include "pca9685.h"
+#include "pca9685_led.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /** Conveniences */
 #define ZERO 0x00
@@ -25,11 +30,20 @@
 #define LED_ON  HIGH
 
 /** The PCA9685 has 12-bit resolution, or 4096 (0–4095) steps from full off to full on */
-#define LED_MAX_BITS  4095
+#define LED_MAX_BITS  PCA9685_LED_STEPS_MAX
 #define LED_MAX_STEPS (LED_MAX_BITS + 1)
 
+/** Bit 4 of LEDn_ON_H holds the channel fully on, bit 4 of LEDn_OFF_H fully off (p. 16) */
+#define LED_FULL_BIT PCA9685_LED_FULL_BIT
+
+/** LED_FULL_BIT as a step count: set in an ON or OFF value, it lands in bit 4 of the high byte */
+#define LED_FULL_STEPS (LED_FULL_BIT << 8)
+
+/** Q16 fixed-point brightness: 0x10000 is fully on */
+#define BRIGHTNESS_MAX 0x10000u
+
 /** Oscillator clock frequency is 25MHz */
-#define OSCILLATOR 25000000.0
+#define OSCILLATOR 25000000
 
 /** Osclillator takes 500μs (500000ns) to switch states */
 #define BEAT 500000
@@ -41,7 +55,9 @@
 #define LED_OFFSET         6
 #define MAX_CHANNEL       15
 #define MIN_CHANNEL        0
-#define MULTIPLIER         4
+#define MULTIPLIER         PCA9685_LED_BYTES
+#define CHANNELS          PCA9685_CHANNELS
+#define LED_REGISTERS     (CHANNELS * MULTIPLIER)
 #define PRESCALE_MIN       3
 #define PRESCALE_MAX     255
 #define FREQ_MIN          24
@@ -70,7 +86,7 @@
 #define ALLCALLADR_DEFAULTS 0xe0
 
 /* LED 0 output and brightness control registers */
-#define LED0_ON_L 0x06
+#define LED0_ON_L PCA9685_LED0_ON_L
 
 /** Registers for loading all LED registers by byte */
 #define ALL_LED_ON_L  0xFA
@@ -79,25 +95,25 @@
 #define PRE_SCALE 0xFE
 
 /** Bits for Mode register 1: 8 bits total */
-#define ALLCALL 1<<0
-#define SUB3    1<<1
-#define SUB2    1<<2
-#define SUB1    1<<3
-#define SLEEP   1<<4
-#define AI      1<<5
-#define EXTCLK  1<<6
-#define RESTART 1<<7
+#define ALLCALL (1<<0)
+#define SUB3    (1<<1)
+#define SUB2    (1<<2)
+#define SUB1    (1<<3)
+#define SLEEP   (1<<4)
+#define AI      PCA9685_MODE1_AI
+#define EXTCLK  (1<<6)
+#define RESTART (1<<7)
 
 /** Mode 1 register default and sleep disabled settings */
 #define MODE1_DEFAULTS 0x88
 #define MODE1_NO_SLEEP 0x01
 
 /** Bits for mode register 2: 8 bits total (bits 5–7 are unused) */
-#define OUTNE0 1<<0
-#define OUTNE1 1<<1
-#define OUTDRV 1<<2
-#define OCH    1<<3
-#define INVRT  1<<4
+#define OUTNE0 (1<<0)
+#define OUTNE1 (1<<1)
+#define OUTDRV (1<<2)
+#define OCH    (1<<3)
+#define INVRT  (1<<4)
 
 /** Mode 2 register defaults */
 #define MODE2_DEFAULTS 0x40
@@ -111,14 +127,109 @@ int calculate_prescale_from_frequency(int frequency);
 int calculate_delay_time_from_percentage(int delay);
 int calculate_on_time_from_percentage(int percent);
 int calculate_off_time_from_delay_and_on_time(int delay, int on_time);
+int calculate_steps_from_brightness(uint32_t q16);
+int calculate_steps_from_curve(uint32_t q16, pca9685_curve curve);
+
+/** A curve's lookup table: CURVE_POINTS steps, one every 1 << CURVE_SHIFT of Q16; NULL for linear.
+ * The generated curves.h defines the same two; the compiler rejects any mismatch. */
+#define CURVE_POINTS 1025
+#define CURVE_SHIFT 6
+const uint16_t *curve_table(pca9685_curve curve);
 
-/** Low-level access to user callback wrappers for initialization */
+/** Low-level access to user callback wrappers for initialization. The writers here and below return OK,
+ * or the results of the bus calls they made OR'd together if any failed; status only tells of the last. */
 void pca9685_i2c_bus_read(pca9685_s *, uint8_t r);
-void pca9685_i2c_bus_write(pca9685_s *, uint8_t r, uint8_t d);
+uint8_t pca9685_i2c_bus_write(pca9685_s *, uint8_t r, uint8_t d);
+
+/** Writes \c n bytes from register \c r on; one transaction with a block writer, byte by byte otherwise */
+uint8_t pca9685_i2c_bus_write_block(pca9685_s *, uint8_t r, uint8_t n, const uint8_t *d);
+
+/** Sends several block writes as one combined transfer when a transfer callback is given */
+uint8_t pca9685_i2c_bus_write_multi(pca9685_s *, const pca9685_i2c_write_s *writes, uint8_t count);
+
+/** Records the outcome of writes sent on the handle's behalf: shadow registers, trace and status */
+void pca9685_i2c_bus_writes_done(pca9685_s *, const pca9685_i2c_write_s *writes, uint8_t count, uint8_t result);
+
+/** Sets the MODE1 ALLCALL/SUBn bits kept by every MODE1 write on this handle, and writes them */
+void set_mode1_flags(pca9685_s *h, uint8_t flags);
+
+/** Sets MODE1 AI unless the shadow shows it set already; required before any multi-byte write */
+uint8_t ensure_auto_increment(pca9685_s *h);
+
+/** Clears MODE2 OCH unless the shadow shows it clear already; latched frames need outputs to change on STOP */
+uint8_t ensure_latch_on_stop(pca9685_s *h);
+
+/** Oscillator settling: CLOCK_MONOTONIC time in ns, a plain sleep, whether a pending settle has ended,
+ * and a wait for it */
+uint64_t monotonic_ns(void);
+void sleep_ns(uint64_t ns);
+int oscillator_ready(pca9685_s *h);
+void await_oscillator(pca9685_s *h);
+
+/** Idle power policy: after LED writes, completes a lazy wake and tracks how long every channel has
+ * been off; check_idle sleeps the device once that reaches idle_sleep_ms, and returns whether it sleeps */
+uint8_t power_leds_written(pca9685_s *h);
+int power_check_idle(pca9685_s *h);
+
+/** Shadow register file: explicit invalidate/resync; pca9685_led.h has the known-value helpers */
+void shadow_invalidate(pca9685_s *h);
+void shadow_resync(pca9685_s *h);
+
+/** Reads the device's registers back, bypassing the shadow, and decodes them */
+void snapshot_device(pca9685_s *h, pca9685_snapshot_s *snapshot);
+
+/** Rewrites the registers where \c snapshot differs from the shadow; returns how many were written */
+int reconcile_device(pca9685_s *h, const pca9685_snapshot_s *snapshot);
+
+/** LED encoding, shared with the fleet: steps clamped to 0–4095, and steps to on/off values using the
+ * full bits; pca9685_led.h turns those into register bytes */
+int clamp_steps(int steps);
+void steps_to_led(int steps, int *on, int *off);
 
 /** Low-level access to register writes for testing */
 void set_led_bytes(pca9685_s *, int c, int on, int off);
 
+/** Writes on/off steps for all 16 channels, all 64 LED bytes from LED0_ON_L at once */
+void set_led_frame(pca9685_s *, const int *on, const int *off);
+
+/** Writes a 64-byte LED register image as it is, trimmed to the changed span; staged if a frame is open */
+void set_led_image(pca9685_s *, const uint8_t *led);
+
+/** Frames: while a frame is open, LED writes are staged on the handle; commit flushes each contiguous
+ * run of changed registers as one transaction, and returns the OR of every bus call it made. Clean runs
+ * of up to FRAME_GAP_MERGE bytes are resent rather than split into separate transactions. On a latched handle the runs go out together, ending
+ * in one STOP: as a combined transfer, or joined into a single write without one. */
+#define FRAME_GAP_MERGE  2
+#define FRAME_MAX_RANGES (LED_REGISTERS / 2)
+
+typedef struct frame_range {
+    uint8_t address;
+    uint8_t length;
+} frame_range_s;
+
+/** Index of the lowest set bit of \c bits, which mustn't be 0 */
+static inline int lowest_set_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int i = 0;
+    for(; !(bits & 1); bits >>= 1) i++;
+    return i;
+#endif
+}
+
+/** The runs of LED registers to write for the changed bytes in \c dirty (bit i for LED0_ON_L + i),
+ * clean runs of up to FRAME_GAP_MERGE bytes merged in; shared by frames and fleets */
+int led_dirty_runs(uint64_t dirty, frame_range_s *ranges);
+
+void begin_led_frame(pca9685_s *h);
+uint8_t commit_led_frame(pca9685_s *h);
+int frame_dirty_ranges(const pca9685_s *h, frame_range_s *ranges);
+
+/** Closes the open frame and fills \c writes (FRAME_MAX_RANGES long) with what commit would send; a latched
+ * frame needs ensure_latch_on_stop first */
+uint8_t frame_collect_writes(pca9685_s *h, pca9685_i2c_write_s *writes);
+
 /** Reset driver state */
 void reset_driver_soft(pca9685_s *h);
 void reset_driver_hard(pca9685_s *h);
@@ -129,5 +240,19 @@ void set_pwm_frequency(pca9685_s *h, int frequency);
 /** Sets the PWM duty cycle with a % delay at a provided % on time */
 void set_pwm_duty_cycle(pca9685_s *h, int channel, int delay, int percent);
 
+/** Sets raw 12-bit on and off steps (0–4095) */
+void set_pwm_steps(pca9685_s *h, int channel, int on, int off);
+
+/** Sets Q16 brightness on one channel, or on all 16 from an array in one write */
+void set_pwm_brightness(pca9685_s *h, int channel, uint32_t q16);
+
+/** Sets the brightness curve of one channel, or of all of them for ALL; no bus traffic */
+void set_channel_curve(pca9685_s *h, int channel, pca9685_curve curve);
+void set_pwm_brightness_frame(pca9685_s *h, const uint32_t *q16);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
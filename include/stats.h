@@ -0,0 +1,45 @@
+#ifndef PCA9685_STATS_H
+#define PCA9685_STATS_H
+
+#include "pca9685.h"
+
+/** Compile-time switch: 0 compiles the counters and timers out entirely. With it on, nothing is
+ * counted or timed unless the handle's stats pointer is set. */
+#ifndef PCA9685_STATS
+#define PCA9685_STATS 1
+#endif
+
+/** Adds a latency of \c ns to \c histogram */
+void pca9685_histogram_add(pca9685_histogram_s *histogram, uint64_t ns);
+
+/** Records one call of a bus callback that started at \c start (CLOCK_MONOTONIC ns) and moved \c bytes */
+void pca9685_stats_record_bus_call(pca9685_s *h, pca9685_stats_bus call, uint64_t start, uint32_t bytes, uint8_t result);
+
+/** Records register writes sent on the handle's behalf in a combined transfer */
+void pca9685_stats_record_writes(pca9685_s *h, const pca9685_i2c_write_s *writes, uint8_t count, uint8_t result);
+
+/** Records a public operation that started at \c start */
+void pca9685_stats_record_op(pca9685_s *h, pca9685_stats_op op, uint64_t start);
+
+/** Records an oscillator wait of \c ns */
+void pca9685_stats_record_sleep(pca9685_s *h, uint64_t ns);
+
+#if PCA9685_STATS
+#define STATS_CLOCK() monotonic_ns()
+#define STATS_START(h) ((h)->stats ? monotonic_ns() : 0)
+#define STATS_BUS_CALL(h, ...) do { if((h)->stats) pca9685_stats_record_bus_call((h), __VA_ARGS__); } while(0)
+#define STATS_TRANSFER_WRITES(h, ...) do { if((h)->stats) pca9685_stats_record_writes((h), __VA_ARGS__); } while(0)
+#define STATS_OP(h, ...) do { if((h)->stats) pca9685_stats_record_op((h), __VA_ARGS__); } while(0)
+#define STATS_SLEEP(h, ns) do { if((h)->stats) pca9685_stats_record_sleep((h), (ns)); } while(0)
+#define STATS_ELIDED(h, n) do { if((h)->stats) (h)->stats->elided += (n); } while(0)
+#else
+#define STATS_CLOCK() ((uint64_t)0)
+#define STATS_START(h) ((void)(h), (uint64_t)0)
+#define STATS_BUS_CALL(h, call, start, ...) ((void)(start))
+#define STATS_TRANSFER_WRITES(h, ...) ((void)0)
+#define STATS_OP(h, op, start) ((void)(start))
+#define STATS_SLEEP(h, ns) ((void)0)
+#define STATS_ELIDED(h, n) ((void)0)
+#endif
+
+#endif
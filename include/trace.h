@@ -0,0 +1,32 @@
+#ifndef PCA9685_TRACE_H
+#define PCA9685_TRACE_H
+
+#include "pca9685.h"
+
+/** Compile-time trace level: 0 compiles tracing out entirely, 1 traces bus transactions, and 2 adds
+ * register operations. Events are only built when a trace callback is set on the handle. */
+#define TRACE_OFF 0
+#define TRACE_BUS 1
+#define TRACE_OPS 2
+
+#ifndef PCA9685_TRACE_LEVEL
+#define PCA9685_TRACE_LEVEL TRACE_BUS
+#endif
+
+/** Builds an event, stamps it and hands it to the handle's trace callback */
+void pca9685_trace_emit(pca9685_s *h, pca9685_trace_op op, uint8_t address, uint8_t length,
+    uint16_t value, uint16_t extra, uint8_t result);
+
+#if PCA9685_TRACE_LEVEL >= TRACE_BUS
+#define TRACE_BUS_EVENT(h, ...) do { if((h)->trace) pca9685_trace_emit((h), __VA_ARGS__); } while(0)
+#else
+#define TRACE_BUS_EVENT(h, ...) ((void)0)
+#endif
+
+#if PCA9685_TRACE_LEVEL >= TRACE_OPS
+#define TRACE_OP_EVENT(h, ...) do { if((h)->trace) pca9685_trace_emit((h), __VA_ARGS__); } while(0)
+#else
+#define TRACE_OP_EVENT(h, ...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+#include "pca9685_anim.h"
+#include "registers.h"
+
+#include <stddef.h>
+
+#define Q16_ONE 0x10000u
+#define NS_PER_MS 1000000u
+#define NS_PER_S 1000000000u
+
+// Worst case I2C bits per animated channel: 4 data bytes plus a share of start, slave and register
+// address, at 9 clocks per byte with the ACK
+#define BITS_PER_CHANNEL (6 * 9)
+
+/** Easing, in Q16 fixed point */
+
+static uint32_t square(uint32_t t) {
+    return (uint32_t)(((uint64_t)t * t) >> 16);
+}
+
+// 2^x for Q16 x in [0, 1): 1 + x(0.6565 + 0.3435x), within 0.3%
+static uint32_t exp2_fraction(uint32_t x) {
+    uint64_t const inner = 43024u + ((22512u * (uint64_t)x) >> 16);
+
+    return (uint32_t)(Q16_ONE + ((inner * x) >> 16));
+}
+
+// 2^(10(t-1)), shifted and scaled to run from exactly 0 to exactly 1
+static uint32_t ease_exponential(uint32_t t) {
+    uint32_t const e = 10 * t;
+    uint64_t const value = ((uint64_t)exp2_fraction(e & 0xFFFF) << (e >> 16)) >> 10;
+    uint64_t const floor = Q16_ONE >> 10;
+
+    return (uint32_t)(((value - floor) * Q16_ONE) / (Q16_ONE - floor));
+}
+
+uint32_t pca9685_ease(pca9685_easing easing, uint32_t t) {
+    if(t >= Q16_ONE) return Q16_ONE;
+
+    switch(easing) {
+        case PCA9685_EASE_IN:
+            return square(t);
+        case PCA9685_EASE_OUT:
+            return Q16_ONE - square(Q16_ONE - t);
+        case PCA9685_EASE_IN_OUT:
+            return (t < Q16_ONE / 2) ? 2 * square(t) : Q16_ONE - 2 * square(Q16_ONE - t);
+        case PCA9685_EASE_EXPONENTIAL:
+            return ease_exponential(t);
+        case PCA9685_EASE_LINEAR:
+        default:
+            return t;
+    }
+}
+
+/** Tracks */
+
+// \c part / \c whole in Q16, for part < whole; a segment of up to 2^32 ms is about 2^52 ns, so both are
+// shifted down until part << 16 fits in 64 bits
+static uint32_t q16_fraction(uint64_t part, uint64_t whole) {
+    while(whole >> 48) {
+        part >>= 1;
+        whole >>= 1;
+    }
+
+    return (uint32_t)((part << 16) / whole);
+}
+
+static pca9685_track_s *find_track(pca9685_anim_s *anim, const pca9685_s *device, int channel) {
+    for(int i = 0; i < anim->capacity; i++) {
+        pca9685_track_s *t = &anim->tracks[i];
+        if(t->active && t->device == device && t->channel == channel) return t;
+    }
+
+    return NULL;
+}
+
+static pca9685_track_s *free_track(pca9685_anim_s *anim) {
+    for(int i = 0; i < anim->capacity; i++) {
+        if(!anim->tracks[i].active) return &anim->tracks[i];
+    }
+
+    return NULL;
+}
+
+// The track's level at \c now; clears active after the last keyframe unless the track loops
+static uint32_t track_level(pca9685_track_s *t, uint64_t now) {
+    const pca9685_keyframe_s *k = t->keyframes;
+    uint64_t const length = (uint64_t)k[t->count - 1].at_ms * NS_PER_MS;
+    uint64_t elapsed = now > t->start ? now - t->start : 0;
+
+    if(elapsed >= length) {
+        if(!t->loop || length == 0) {
+            t->active = 0;
+            return k[t->count - 1].level;
+        }
+
+        t->start += (elapsed / length) * length;
+        elapsed %= length;
+        t->segment = 1;
+    }
+
+    while(t->segment < t->count - 1 && elapsed >= (uint64_t)k[t->segment].at_ms * NS_PER_MS) t->segment++;
+
+    const pca9685_keyframe_s *from = &k[t->segment - 1], *to = &k[t->segment];
+    uint64_t const begin = (uint64_t)from->at_ms * NS_PER_MS;
+    uint64_t const span = (uint64_t)(to->at_ms - from->at_ms) * NS_PER_MS;
+
+    // Until the first keyframe, the track holds its level
+    if(elapsed < begin) return from->level;
+
+    uint32_t const progress = span ? q16_fraction(elapsed - begin, span) : Q16_ONE;
+    int64_t const delta = (int64_t)to->level - (int64_t)from->level;
+
+    return (uint32_t)((int64_t)from->level + ((delta * pca9685_ease(to->easing, progress)) >> 16));
+}
+
+// Takes the device channel's running track, or a free one
+static pca9685_track_s *claim_track(pca9685_anim_s *anim, pca9685_s *device, int channel, uint64_t now) {
+    if(channel < MIN_CHANNEL || channel > MAX_CHANNEL) return NULL;
+
+    pca9685_track_s *t = find_track(anim, device, channel);
+    if(!t) t = free_track(anim);
+    if(!t) return NULL;
+
+    *t = (pca9685_track_s){ .device = device, .channel = channel, .segment = 1, .start = now, .active = 1 };
+
+    return t;
+}
+
+pca9685_track_s *pca9685_anim_play(pca9685_anim_s *anim, pca9685_s *device, int channel,
+        const pca9685_keyframe_s *keyframes, int count, uint64_t now) {
+    if(count < 1) return NULL;
+
+    // Segments run from one keyframe to the next, so the times must not go backwards
+    for(int i = 1; i < count; i++) {
+        if(keyframes[i].at_ms < keyframes[i - 1].at_ms) return NULL;
+    }
+
+    pca9685_track_s *t = claim_track(anim, device, channel, now);
+    if(!t) return NULL;
+
+    t->keyframes = keyframes;
+    t->count = count;
+
+    // A lone keyframe is a jump to its level
+    if(count == 1) {
+        t->fade[0] = t->fade[1] = (pca9685_keyframe_s){ .at_ms = 0, .level = keyframes[0].level };
+        t->keyframes = t->fade;
+        t->count = 2;
+    }
+
+    return t;
+}
+
+pca9685_track_s *pca9685_anim_fade(pca9685_anim_s *anim, pca9685_s *device, int channel,
+        uint32_t from, uint32_t to, uint32_t duration_ms, pca9685_easing easing, uint64_t now) {
+    pca9685_track_s *t = claim_track(anim, device, channel, now);
+    if(!t) return NULL;
+
+    t->fade[0] = (pca9685_keyframe_s){ .at_ms = 0, .level = from, .easing = PCA9685_EASE_LINEAR };
+    t->fade[1] = (pca9685_keyframe_s){ .at_ms = duration_ms, .level = to, .easing = easing };
+    t->keyframes = t->fade;
+    t->count = 2;
+
+    return t;
+}
+
+void pca9685_anim_stop(pca9685_anim_s *anim, pca9685_s *device, int channel) {
+    pca9685_track_s *t = find_track(anim, device, channel);
+
+    if(t) t->active = 0;
+}
+
+/** Ticks */
+
+// The longer of the requested tick period, the wire time of a worst-case frame and the measured cost
+static uint64_t tick_interval(const pca9685_anim_s *anim, int channels) {
+    uint64_t interval = anim->tick_hz ? NS_PER_S / anim->tick_hz : 0;
+
+    if(anim->bus_hz) {
+        uint64_t const wire = (uint64_t)channels * BITS_PER_CHANNEL * NS_PER_S / anim->bus_hz;
+        if(wire > interval) interval = wire;
+    }
+
+    return anim->tick_cost > interval ? anim->tick_cost : interval;
+}
+
+static int running_tracks(const pca9685_anim_s *anim) {
+    int running = 0;
+
+    for(int i = 0; i < anim->capacity; i++) running += anim->tracks[i].active;
+
+    return running;
+}
+
+int pca9685_anim_tick(pca9685_anim_s *anim, uint64_t now) {
+    if(now < anim->next_tick) return running_tracks(anim);
+
+    // Stage every track into its device's frame; the frame drops channels whose bytes didn't change
+    int channels = 0;
+
+    for(int i = 0; i < anim->capacity; i++) {
+        pca9685_track_s *t = &anim->tracks[i];
+        if(!t->active) continue;
+
+        if(!t->device->frame_open) begin_led_frame(t->device);
+        set_pwm_brightness(t->device, t->channel, track_level(t, now));
+        channels++;
+    }
+
+    uint64_t const sent = monotonic_ns();
+
+    if(anim->bus) pca9685_bus_commit_all(anim->bus);
+
+    // Devices off the bus, or all of them without one; frames left open on animated devices go too
+    for(int i = 0; i < anim->capacity; i++) {
+        pca9685_s *h = anim->tracks[i].device;
+        if(h && h->frame_open) commit_led_frame(h);
+    }
+
+    // Smooth the measured cost over eight ticks
+    uint64_t const cost = monotonic_ns() - sent;
+    anim->tick_cost = anim->tick_cost ? anim->tick_cost - (anim->tick_cost >> 3) + (cost >> 3) : cost;
+    anim->next_tick = now + tick_interval(anim, channels);
+
+    return running_tracks(anim);
+}
+
+uint64_t pca9685_anim_next_tick(const pca9685_anim_s *anim) {
+    return anim->next_tick;
+}
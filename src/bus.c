@@ -0,0 +1,315 @@
+#include "pca9685_bus.h"
+#include "registers.h"
+#include "stats.h"
+#include "record.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/** Per-group registers, MODE1 bits and power-on addresses (p. 13) */
+static const u8 group_register[PCA9685_GROUPS] = { ALLCALLADR, SUBADR1, SUBADR2, SUBADR3 };
+static const u8 group_mode1_bit[PCA9685_GROUPS] = { ALLCALL, SUB1, SUB2, SUB3 };
+static const u8 group_default_register[PCA9685_GROUPS] = {
+    ALLCALLADR_DEFAULTS, SUBADR1_DEFAULTS, SUBADR2_DEFAULTS, SUBADR3_DEFAULTS
+};
+
+/** Per-device callbacks: route the handle's bus traffic through the bus with its slave address */
+
+static pca9685_bus_s *bus_of(pca9685_s *h) {
+    return (pca9685_bus_s *)h->bus_context;
+}
+
+static u8 device_read(pca9685_s *h, u8 address) {
+    pca9685_bus_s *bus = bus_of(h);
+
+    return bus->reader(bus, h->slave_address, address);
+}
+
+static u8 device_block_read(pca9685_s *h, u8 address, u8 length, u8 *values) {
+    pca9685_bus_s *bus = bus_of(h);
+
+    return bus->block_reader(bus, h->slave_address, address, length, values);
+}
+
+static u8 device_block_write(pca9685_s *h, u8 address, u8 length, const u8 *values) {
+    pca9685_bus_s *bus = bus_of(h);
+    const pca9685_bus_write_s write = {
+        .slave = h->slave_address,
+        .write = { .address = address, .length = length, .data = values }
+    };
+
+    return bus->transfer(bus, &write, 1);
+}
+
+static u8 device_write(pca9685_s *h, u8 address, u8 data) {
+    return device_block_write(h, address, 1, &data);
+}
+
+static u8 device_transfer(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count) {
+    pca9685_bus_s *bus = bus_of(h);
+    pca9685_bus_write_s addressed[FRAME_MAX_RANGES];
+    u8 result = OK;
+
+    for(int first = 0; first < count; first += FRAME_MAX_RANGES) {
+        int n = 0;
+        for(int i = first; i < count && n < FRAME_MAX_RANGES; i++) {
+            addressed[n++] = (pca9685_bus_write_s){ .slave = h->slave_address, .write = writes[i] };
+        }
+
+        result |= bus->transfer(bus, addressed, n);
+    }
+
+    return result;
+}
+
+/** Group callbacks: writes go to the group address, then into every member's shadow */
+
+static int device_index(const pca9685_bus_s *bus, const pca9685_s *h) {
+    return (int)(h - bus->devices);
+}
+
+static int is_member(const pca9685_bus_s *bus, pca9685_group group, int index) {
+    return (int)((bus->members[group] >> index) & 1u);
+}
+
+static pca9685_group group_of(pca9685_s *h) {
+    return (pca9685_group)(h - bus_of(h)->groups);
+}
+
+static u8 group_read(pca9685_s *h, u8 address) {
+    pca9685_bus_s *bus = bus_of(h);
+    pca9685_group const group = group_of(h);
+
+    // A group address can't be read; ask the first member
+    for(int i = 0; i < bus->count; i++) {
+        if(is_member(bus, group, i)) return bus->reader(bus, bus->devices[i].slave_address, address);
+    }
+
+    return 0;
+}
+
+// A broadcast MODE1 write carries the group's common bits; members in other groups get theirs back
+static void restore_member_flags(pca9685_s *member) {
+    u8 const address_bits = ALLCALL | SUB1 | SUB2 | SUB3;
+
+    if(pca9685_shadow_known(member, MODE1) && (member->shadow[MODE1] & address_bits) == member->mode1_flags) return;
+
+    set_mode1_flags(member, member->mode1_flags);
+}
+
+static u8 group_transfer(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count) {
+    pca9685_bus_s *bus = bus_of(h);
+    pca9685_group const group = group_of(h);
+    pca9685_bus_write_s addressed[FRAME_MAX_RANGES];
+    int touches_mode1 = 0;
+    u8 result = OK;
+
+    for(int first = 0; first < count; first += FRAME_MAX_RANGES) {
+        int n = 0;
+        for(int i = first; i < count && n < FRAME_MAX_RANGES; i++) {
+            addressed[n++] = (pca9685_bus_write_s){ .slave = h->slave_address, .write = writes[i] };
+            touches_mode1 |= writes[i].address == MODE1;
+        }
+
+        result |= bus->transfer(bus, addressed, n);
+    }
+
+    for(int i = 0; i < bus->count; i++) {
+        if(!is_member(bus, group, i)) continue;
+
+        pca9685_i2c_bus_writes_done(&bus->devices[i], writes, count, result);
+        if(touches_mode1 && result == OK) restore_member_flags(&bus->devices[i]);
+    }
+
+    return result;
+}
+
+static u8 group_block_write(pca9685_s *h, u8 address, u8 length, const u8 *values) {
+    const pca9685_i2c_write_s write = { .address = address, .length = length, .data = values };
+
+    return group_transfer(h, &write, 1);
+}
+
+static u8 group_write(pca9685_s *h, u8 address, u8 data) {
+    return group_block_write(h, address, 1, &data);
+}
+
+static u8 group_address(const pca9685_bus_s *bus, pca9685_group group) {
+    return bus->group_address[group] ? bus->group_address[group] : (u8)(group_default_register[group] >> 1);
+}
+
+/** Bus operations */
+
+pca9685_s *pca9685_bus_add(pca9685_bus_s *bus, u8 slave) {
+    if(bus->count >= PCA9685_BUS_MAX_DEVICES || pca9685_bus_device(bus, slave)) return NULL;
+
+    pca9685_s *h = &bus->devices[bus->count++];
+
+    *h = pca9685(
+        .slave_address=slave,
+        .bus_context=bus,
+        .bus_reader=device_read,
+        .bus_writer=device_write,
+        .bus_block_writer=device_block_write,
+        .bus_transfer=device_transfer,
+        .bus_block_reader=bus->block_reader ? device_block_read : NULL
+    );
+
+    return h;
+}
+
+pca9685_s *pca9685_bus_device(pca9685_bus_s *bus, u8 slave) {
+    for(int i = 0; i < bus->count; i++) {
+        if(bus->devices[i].slave_address == slave) return &bus->devices[i];
+    }
+
+    return NULL;
+}
+
+void pca9685_bus_begin_all(pca9685_bus_s *bus) {
+    for(int i = 0; i < bus->count; i++) begin_led_frame(&bus->devices[i]);
+}
+
+// Sends the queued writes and hands each device the outcome of its own
+static void flush(pca9685_bus_s *bus, int queued, int first_device, int last_device) {
+    if(queued == 0) return;
+
+    uint64_t const sent = STATS_CLOCK();
+    u8 const result = bus->transfer(bus, bus->writes, queued);
+
+    int w = 0;
+    for(int i = first_device; i <= last_device; i++) {
+        pca9685_s *h = &bus->devices[i];
+        int const start = w;
+
+        while(w < queued && bus->writes[w].slave == h->slave_address) w++;
+
+        // Each device's share of the transfer counts as one transaction of its own
+        if(w > start) STATS_BUS_CALL(h, PCA9685_STATS_TRANSFER, sent, 0, result);
+
+        for(int j = start; j < w; j++) {
+            const pca9685_i2c_write_s *write = &bus->writes[j].write;
+            RECORD_BUS(h, PCA9685_RECORD_TRANSFER, (u8)(j - start), write->address, write->length, write->data, result);
+            pca9685_i2c_bus_writes_done(h, write, 1, result);
+        }
+    }
+}
+
+void pca9685_bus_commit_all(pca9685_bus_s *bus) {
+    pca9685_i2c_write_s writes[FRAME_MAX_RANGES];
+    int queued = 0;
+    int first_device = 0;
+
+    for(int i = 0; i < bus->count; i++) {
+        pca9685_s *h = &bus->devices[i];
+        if(!h->frame_open) continue;
+
+        // Multi-byte runs need auto-increment, and latched frames a latch on STOP; one-offs per device
+        ensure_auto_increment(h);
+        if(h->latched) ensure_latch_on_stop(h);
+
+        u8 const count = frame_collect_writes(h, writes);
+
+        if(queued + count > PCA9685_BUS_MAX_WRITES) {
+            flush(bus, queued, first_device, i - 1);
+            queued = 0;
+            first_device = i;
+        }
+
+        for(u8 j = 0; j < count; j++) {
+            bus->writes[queued++] = (pca9685_bus_write_s){ .slave = h->slave_address, .write = writes[j] };
+        }
+    }
+
+    flush(bus, queued, first_device, bus->count - 1);
+
+    for(int i = 0; i < bus->count; i++) power_leds_written(&bus->devices[i]);
+}
+
+/** Groups */
+
+void pca9685_bus_set_group_address(pca9685_bus_s *bus, pca9685_group group, u8 address) {
+    bus->group_address[group] = address;
+
+    for(int i = 0; i < bus->count; i++) {
+        if(is_member(bus, group, i)) {
+            pca9685_i2c_bus_write(&bus->devices[i], group_register[group], (u8)(group_address(bus, group) << 1));
+        }
+    }
+}
+
+void pca9685_bus_join(pca9685_bus_s *bus, pca9685_s *device, pca9685_group group) {
+    // The address register holds the 7-bit address in bits 7–1 (p. 13)
+    pca9685_i2c_bus_write(device, group_register[group], (u8)(group_address(bus, group) << 1));
+    set_mode1_flags(device, device->mode1_flags | group_mode1_bit[group]);
+
+    bus->members[group] |= (uint64_t)1 << device_index(bus, device);
+}
+
+void pca9685_bus_leave(pca9685_bus_s *bus, pca9685_s *device, pca9685_group group) {
+    set_mode1_flags(device, (u8)(device->mode1_flags & ~group_mode1_bit[group]));
+
+    bus->members[group] &= ~((uint64_t)1 << device_index(bus, device));
+}
+
+pca9685_s *pca9685_bus_group(pca9685_bus_s *bus, pca9685_group group) {
+    pca9685_s *h = &bus->groups[group];
+
+    if(h->bus_context != bus) {
+        // No read/write check: it would broadcast one member's LED0 register to the whole group
+        *h = pca9685(.bus_context=bus);
+        h->bus_reader = group_read;
+        h->bus_writer = group_write;
+        h->command = "init";
+        h->status = "ok";
+    }
+
+    h->slave_address = group_address(bus, group);
+
+    // Each member sets AI from its own MODE1: the group's, read from the first member, would carry that
+    // member's SLEEP and address bits to all of them
+    for(int i = 0; i < bus->count; i++) {
+        if(is_member(bus, group, i)) ensure_auto_increment(&bus->devices[i]);
+    }
+
+    // The group's shadow is what every member agrees on, so only writes that change nothing are elided
+    u8 flags = group_mode1_bit[group] | ALLCALL | SUB1 | SUB2 | SUB3;
+    int first = 1;
+
+    shadow_invalidate(h);
+
+    for(int i = 0; i < bus->count; i++) {
+        if(!is_member(bus, group, i)) continue;
+
+        const pca9685_s *member = &bus->devices[i];
+        flags &= member->mode1_flags;
+
+        for(int r = 0; r < 256; r++) {
+            int const k = r >> 3;
+            u8 const bit = (u8)(1 << (r & 7));
+            int const agrees = pca9685_shadow_known(member, (u8)r) &&
+                               (first || (pca9685_shadow_known(h, (u8)r) && h->shadow[r] == member->shadow[r]));
+
+            if(first) h->shadow[r] = member->shadow[r];
+            h->shadow_known[k] = agrees ? (u8)(h->shadow_known[k] | bit) : (u8)(h->shadow_known[k] & ~bit);
+        }
+
+        first = 0;
+    }
+
+    h->mode1_flags = flags | group_mode1_bit[group];
+
+    // Members that disagree on MODE1 leave the group's unknown, and ensure_auto_increment would broadcast
+    // it; multi-byte writes go out a byte at a time instead, which needs no AI
+    int const mode1_known = pca9685_shadow_known(h, MODE1);
+    h->bus_block_writer = mode1_known ? group_block_write : NULL;
+    h->bus_transfer = mode1_known ? group_transfer : NULL;
+
+    return h;
+}
+
+void pca9685_bus_blackout(pca9685_bus_s *bus) {
+    pca9685_s *all = pca9685_bus_group(bus, PCA9685_ALLCALL);
+
+    all->ops->channel_off(all, ALL);
+}
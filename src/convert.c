@@ -0,0 +1,123 @@
+#include "convert.h"
+#include "registers.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/** Scalar kernel: the reference every vector kernel has to match byte for byte */
+
+// A 16-bit level through the curve to 0–4096 steps; same arithmetic as calculate_steps_from_curve
+static uint32_t level_steps(uint16_t level, const uint16_t *table) {
+    uint32_t const q16 = level + (level >> 15);
+
+    if(!table) return (q16 * LED_MAX_STEPS + (BRIGHTNESS_MAX >> 1)) >> 16;
+
+    // Full brightness lands on the last point as the end of the last segment, so i + 1 stays in the table
+    uint32_t const i = (q16 >> CURVE_SHIFT) - (q16 >> 16);
+    uint32_t const fraction = q16 - (i << CURVE_SHIFT);
+    uint32_t const rise = (uint32_t)(table[i + 1] - table[i]);
+
+    return table[i] + ((rise * fraction + (1u << (CURVE_SHIFT - 1))) >> CURVE_SHIFT);
+}
+
+void convert_scalar(u8 *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase) {
+    for(int n = 0; n < count * CHANNELS; n++) {
+        uint32_t const steps = level_steps(levels[n], table);
+        uint32_t const start = phase[n % CHANNELS] & LED_MAX_BITS;
+        uint32_t on = start, off = (start + steps) & LED_MAX_BITS;
+
+        if(steps == 0) {
+            on = 0;
+            off = LED_FULL_STEPS;
+        } else if(steps >= LED_MAX_STEPS) {
+            on = LED_FULL_STEPS;
+            off = 0;
+        }
+
+        pca9685_encode_led(&out[n * MULTIPLIER], (int)on, (int)off);
+    }
+}
+
+/** Kernel selection: one atomic pointer to a static entry, so a thread converting while another
+ * selects sees either kernel whole, and first use from several threads is harmless */
+
+static const uint16_t no_phase[CHANNELS];
+
+typedef struct convert_choice {
+    pca9685_simd simd;
+    convert_kernel_fn kernel;
+} convert_choice_s;
+
+static const convert_choice_s choices[] = {
+    [PCA9685_SIMD_SCALAR] = { PCA9685_SIMD_SCALAR, convert_scalar },
+#ifdef CONVERT_X86
+    [PCA9685_SIMD_SSE2] = { PCA9685_SIMD_SSE2, convert_sse2 },
+    [PCA9685_SIMD_AVX2] = { PCA9685_SIMD_AVX2, convert_avx2 },
+#endif
+#ifdef CONVERT_NEON
+    [PCA9685_SIMD_NEON] = { PCA9685_SIMD_NEON, convert_neon },
+#endif
+};
+
+static _Atomic(const convert_choice_s *) choice;
+
+// The entry for \c simd, or NULL if it isn't built or the CPU lacks it
+static const convert_choice_s *choice_for(pca9685_simd simd) {
+    if(simd <= PCA9685_SIMD_AUTO || (size_t)simd >= sizeof(choices) / sizeof(choices[0])) return NULL;
+    if(!choices[simd].kernel) return NULL;
+#ifdef CONVERT_X86
+    if(simd == PCA9685_SIMD_AVX2 && !__builtin_cpu_supports("avx2")) return NULL;
+#endif
+
+    return &choices[simd];
+}
+
+static pca9685_simd fastest(void) {
+    static const pca9685_simd preference[] = { PCA9685_SIMD_AVX2, PCA9685_SIMD_NEON, PCA9685_SIMD_SSE2 };
+
+    for(size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if(choice_for(preference[i])) return preference[i];
+    }
+
+    return PCA9685_SIMD_SCALAR;
+}
+
+int pca9685_convert_select(pca9685_simd simd) {
+    if(simd == PCA9685_SIMD_AUTO) simd = fastest();
+
+    const convert_choice_s *c = choice_for(simd);
+    if(!c) return -1;
+
+    atomic_store_explicit(&choice, c, memory_order_release);
+
+    return 0;
+}
+
+// The selected kernel, picking the fastest on first use unless a select got there first
+static const convert_choice_s *current(void) {
+    const convert_choice_s *c = atomic_load_explicit(&choice, memory_order_acquire);
+    if(c) return c;
+
+    const convert_choice_s *expected = NULL;
+    c = choice_for(fastest());
+
+    return atomic_compare_exchange_strong_explicit(&choice, &expected, c, memory_order_acq_rel, memory_order_acquire)
+        ? c : expected;
+}
+
+pca9685_simd pca9685_convert_kernel(void) {
+    return current()->simd;
+}
+
+const char *pca9685_simd_name(pca9685_simd simd) {
+    static const char *names[] = { "auto", "scalar", "sse2", "avx2", "neon" };
+
+    return (simd >= PCA9685_SIMD_AUTO && simd <= PCA9685_SIMD_NEON) ? names[simd] : "unknown";
+}
+
+void pca9685_convert_frames(pca9685_frame_s *frames, const uint16_t *levels, int count,
+        pca9685_curve curve, const uint16_t *phase) {
+    if(count < 1) return;
+
+    current()->kernel((u8 *)frames, levels, count, curve_table(curve), phase ? phase : no_phase);
+}
@@ -0,0 +1,158 @@
+#include "convert.h"
+#include "registers.h"
+
+#include <string.h>
+
+/* Vector kernels: each lane is one channel, in 32 bits. The curve tables are looked up with one
+ * 32-bit load per lane at table + i, which brings in the point and the next one together; a gather
+ * on AVX2, lane by lane elsewhere. Each lane's result is the channel's four register bytes as one
+ * little-endian word, ON | OFF << 16, so a vector store writes the register image directly. */
+
+#ifdef CONVERT_X86
+
+#include <immintrin.h>
+
+// Both points of curve segment i in one word: table[i] low, table[i + 1] high
+static uint32_t segment(const uint16_t *table, uint32_t i) {
+    uint32_t pair;
+    memcpy(&pair, &table[i], sizeof(pair));
+
+    return pair;
+}
+
+void convert_sse2(u8 *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const low = _mm_set1_epi32(0xFFFF);
+    __m128i const bits = _mm_set1_epi32(LED_MAX_BITS);
+    __m128i const full = _mm_set1_epi32(LED_FULL_STEPS);
+    __m128i const half_step = _mm_set1_epi32(BRIGHTNESS_MAX >> 1);
+    __m128i const half_point = _mm_set1_epi32(1 << (CURVE_SHIFT - 1));
+
+    for(int n = 0; n < count * CHANNELS; n += 4) {
+        __m128i const level = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)&levels[n]), zero);
+        __m128i const q16 = _mm_add_epi32(level, _mm_srli_epi32(level, 15));
+        __m128i steps;
+
+        if(table) {
+            __m128i const i = _mm_sub_epi32(_mm_srli_epi32(q16, CURVE_SHIFT), _mm_srli_epi32(q16, 16));
+            __m128i const fraction = _mm_sub_epi32(q16, _mm_slli_epi32(i, CURVE_SHIFT));
+            uint32_t index[4];
+
+            _mm_storeu_si128((__m128i *)index, i);
+            __m128i const pairs = _mm_setr_epi32((int)segment(table, index[0]), (int)segment(table, index[1]),
+                (int)segment(table, index[2]), (int)segment(table, index[3]));
+            __m128i const base = _mm_and_si128(pairs, low);
+            __m128i const rise = _mm_sub_epi32(_mm_srli_epi32(pairs, 16), base);
+
+            // Rise and fraction fit in 16 bits with the high halves clear, so madd is a 32-bit multiply
+            __m128i const step = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(rise, fraction), half_point), CURVE_SHIFT);
+            steps = _mm_add_epi32(base, step);
+        } else {
+            steps = _mm_srli_epi32(_mm_add_epi32(_mm_slli_epi32(q16, 12), half_step), 16);
+        }
+
+        __m128i const start = _mm_and_si128(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)&phase[n % CHANNELS]), zero), bits);
+        __m128i const full_off = _mm_cmpeq_epi32(steps, zero);
+        __m128i const full_on = _mm_cmpgt_epi32(steps, bits);
+        __m128i const either = _mm_or_si128(full_off, full_on);
+
+        __m128i const on = _mm_or_si128(_mm_and_si128(full_on, full), _mm_andnot_si128(either, start));
+        __m128i const off = _mm_or_si128(_mm_and_si128(full_off, full),
+            _mm_andnot_si128(either, _mm_and_si128(_mm_add_epi32(start, steps), bits)));
+
+        _mm_storeu_si128((__m128i *)&out[n * MULTIPLIER], _mm_or_si128(on, _mm_slli_epi32(off, 16)));
+    }
+}
+
+__attribute__((target("avx2")))
+void convert_avx2(u8 *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase) {
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const low = _mm256_set1_epi32(0xFFFF);
+    __m256i const bits = _mm256_set1_epi32(LED_MAX_BITS);
+    __m256i const full = _mm256_set1_epi32(LED_FULL_STEPS);
+    __m256i const half_step = _mm256_set1_epi32(BRIGHTNESS_MAX >> 1);
+    __m256i const half_point = _mm256_set1_epi32(1 << (CURVE_SHIFT - 1));
+
+    for(int n = 0; n < count * CHANNELS; n += 8) {
+        __m256i const level = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&levels[n]));
+        __m256i const q16 = _mm256_add_epi32(level, _mm256_srli_epi32(level, 15));
+        __m256i steps;
+
+        if(table) {
+            __m256i const i = _mm256_sub_epi32(_mm256_srli_epi32(q16, CURVE_SHIFT), _mm256_srli_epi32(q16, 16));
+            __m256i const fraction = _mm256_sub_epi32(q16, _mm256_slli_epi32(i, CURVE_SHIFT));
+
+            // Scale 2: lane k loads the 32 bits at table + i[k]
+            __m256i const pairs = _mm256_i32gather_epi32((const int *)(const void *)table, i, 2);
+            __m256i const base = _mm256_and_si256(pairs, low);
+            __m256i const rise = _mm256_sub_epi32(_mm256_srli_epi32(pairs, 16), base);
+
+            __m256i const step = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(rise, fraction), half_point), CURVE_SHIFT);
+            steps = _mm256_add_epi32(base, step);
+        } else {
+            steps = _mm256_srli_epi32(_mm256_add_epi32(_mm256_slli_epi32(q16, 12), half_step), 16);
+        }
+
+        __m256i const start = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&phase[n % CHANNELS])), bits);
+        __m256i const full_off = _mm256_cmpeq_epi32(steps, zero);
+        __m256i const full_on = _mm256_cmpgt_epi32(steps, bits);
+        __m256i const either = _mm256_or_si256(full_off, full_on);
+
+        __m256i const on = _mm256_or_si256(_mm256_and_si256(full_on, full), _mm256_andnot_si256(either, start));
+        __m256i const off = _mm256_or_si256(_mm256_and_si256(full_off, full),
+            _mm256_andnot_si256(either, _mm256_and_si256(_mm256_add_epi32(start, steps), bits)));
+
+        _mm256_storeu_si256((__m256i *)&out[n * MULTIPLIER], _mm256_or_si256(on, _mm256_slli_epi32(off, 16)));
+    }
+}
+
+#endif
+
+#ifdef CONVERT_NEON
+
+#include <arm_neon.h>
+
+void convert_neon(u8 *out, const uint16_t *levels, int count, const uint16_t *table, const uint16_t *phase) {
+    uint32x4_t const zero = vdupq_n_u32(0);
+    uint32x4_t const low = vdupq_n_u32(0xFFFF);
+    uint32x4_t const bits = vdupq_n_u32(LED_MAX_BITS);
+    uint32x4_t const full = vdupq_n_u32(LED_FULL_STEPS);
+    uint32x4_t const half_step = vdupq_n_u32(BRIGHTNESS_MAX >> 1);
+    uint32x4_t const half_point = vdupq_n_u32(1 << (CURVE_SHIFT - 1));
+
+    for(int n = 0; n < count * CHANNELS; n += 4) {
+        uint32x4_t const level = vmovl_u16(vld1_u16(&levels[n]));
+        uint32x4_t const q16 = vaddq_u32(level, vshrq_n_u32(level, 15));
+        uint32x4_t steps;
+
+        if(table) {
+            uint32x4_t const i = vsubq_u32(vshrq_n_u32(q16, CURVE_SHIFT), vshrq_n_u32(q16, 16));
+            uint32x4_t const fraction = vsubq_u32(q16, vshlq_n_u32(i, CURVE_SHIFT));
+            uint32_t index[4], pair[4];
+
+            vst1q_u32(index, i);
+            for(int k = 0; k < 4; k++) memcpy(&pair[k], &table[index[k]], sizeof(pair[k]));
+
+            uint32x4_t const pairs = vld1q_u32(pair);
+            uint32x4_t const base = vandq_u32(pairs, low);
+            uint32x4_t const rise = vsubq_u32(vshrq_n_u32(pairs, 16), base);
+
+            steps = vaddq_u32(base, vshrq_n_u32(vmlaq_u32(half_point, rise, fraction), CURVE_SHIFT));
+        } else {
+            steps = vshrq_n_u32(vaddq_u32(vshlq_n_u32(q16, 12), half_step), 16);
+        }
+
+        uint32x4_t const start = vandq_u32(vmovl_u16(vld1_u16(&phase[n % CHANNELS])), bits);
+        uint32x4_t const full_off = vceqq_u32(steps, zero);
+        uint32x4_t const full_on = vcgtq_u32(steps, bits);
+        uint32x4_t const either = vorrq_u32(full_off, full_on);
+
+        uint32x4_t const on = vorrq_u32(vandq_u32(full_on, full), vbicq_u32(start, either));
+        uint32x4_t const off = vorrq_u32(vandq_u32(full_off, full),
+            vbicq_u32(vandq_u32(vaddq_u32(start, steps), bits), either));
+
+        vst1q_u8(&out[n * MULTIPLIER], vreinterpretq_u8_u32(vorrq_u32(on, vshlq_n_u32(off, 16))));
+    }
+}
+
+#endif
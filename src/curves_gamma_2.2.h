@@ -0,0 +1,147 @@
+/* Generated by tools/gen_curves.c, gamma 2.2; do not edit */
+
+#ifndef PCA9685_CURVES_H
+#define PCA9685_CURVES_H
+
+#include <inttypes.h>
+
+#define CURVE_POINTS 1025
+#define CURVE_SHIFT 6
+
+static const uint16_t gamma_curve[CURVE_POINTS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2,
+    2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 5,
+    5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 9, 9,
+    9, 10, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 15,
+    15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 19, 20, 20, 21, 21, 22,
+    22, 23, 23, 24, 25, 25, 26, 26, 27, 27, 28, 28, 29, 30, 30, 31,
+    31, 32, 33, 33, 34, 35, 35, 36, 37, 37, 38, 39, 39, 40, 41, 42,
+    42, 43, 44, 44, 45, 46, 47, 47, 48, 49, 50, 51, 51, 52, 53, 54,
+    55, 56, 56, 57, 58, 59, 60, 61, 62, 63, 63, 64, 65, 66, 67, 68,
+    69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84,
+    85, 86, 87, 88, 89, 90, 92, 93, 94, 95, 96, 97, 98, 100, 101, 102,
+    103, 104, 105, 107, 108, 109, 110, 111, 113, 114, 115, 116, 118, 119, 120, 122,
+    123, 124, 125, 127, 128, 129, 131, 132, 134, 135, 136, 138, 139, 140, 142, 143,
+    145, 146, 147, 149, 150, 152, 153, 155, 156, 158, 159, 161, 162, 164, 165, 167,
+    168, 170, 171, 173, 175, 176, 178, 179, 181, 183, 184, 186, 187, 189, 191, 192,
+    194, 196, 197, 199, 201, 202, 204, 206, 208, 209, 211, 213, 215, 216, 218, 220,
+    222, 223, 225, 227, 229, 231, 233, 234, 236, 238, 240, 242, 244, 246, 248, 249,
+    251, 253, 255, 257, 259, 261, 263, 265, 267, 269, 271, 273, 275, 277, 279, 281,
+    283, 285, 287, 289, 291, 294, 296, 298, 300, 302, 304, 306, 308, 310, 313, 315,
+    317, 319, 321, 324, 326, 328, 330, 332, 335, 337, 339, 341, 344, 346, 348, 351,
+    353, 355, 358, 360, 362, 365, 367, 369, 372, 374, 376, 379, 381, 384, 386, 388,
+    391, 393, 396, 398, 401, 403, 406, 408, 411, 413, 416, 418, 421, 423, 426, 429,
+    431, 434, 436, 439, 441, 444, 447, 449, 452, 455, 457, 460, 463, 465, 468, 471,
+    473, 476, 479, 482, 484, 487, 490, 493, 495, 498, 501, 504, 507, 509, 512, 515,
+    518, 521, 524, 526, 529, 532, 535, 538, 541, 544, 547, 550, 553, 556, 559, 562,
+    565, 568, 571, 574, 577, 580, 583, 586, 589, 592, 595, 598, 601, 604, 607, 610,
+    613, 617, 620, 623, 626, 629, 632, 636, 639, 642, 645, 648, 652, 655, 658, 661,
+    665, 668, 671, 674, 678, 681, 684, 688, 691, 694, 698, 701, 704, 708, 711, 714,
+    718, 721, 725, 728, 732, 735, 738, 742, 745, 749, 752, 756, 759, 763, 766, 770,
+    773, 777, 781, 784, 788, 791, 795, 798, 802, 806, 809, 813, 817, 820, 824, 828,
+    831, 835, 839, 842, 846, 850, 854, 857, 861, 865, 869, 872, 876, 880, 884, 888,
+    891, 895, 899, 903, 907, 911, 915, 918, 922, 926, 930, 934, 938, 942, 946, 950,
+    954, 958, 962, 966, 970, 974, 978, 982, 986, 990, 994, 998, 1002, 1006, 1010, 1015,
+    1019, 1023, 1027, 1031, 1035, 1039, 1044, 1048, 1052, 1056, 1060, 1064, 1069, 1073, 1077, 1081,
+    1086, 1090, 1094, 1099, 1103, 1107, 1111, 1116, 1120, 1124, 1129, 1133, 1138, 1142, 1146, 1151,
+    1155, 1160, 1164, 1168, 1173, 1177, 1182, 1186, 1191, 1195, 1200, 1204, 1209, 1213, 1218, 1222,
+    1227, 1231, 1236, 1241, 1245, 1250, 1254, 1259, 1264, 1268, 1273, 1278, 1282, 1287, 1292, 1296,
+    1301, 1306, 1310, 1315, 1320, 1325, 1329, 1334, 1339, 1344, 1349, 1353, 1358, 1363, 1368, 1373,
+    1378, 1382, 1387, 1392, 1397, 1402, 1407, 1412, 1417, 1422, 1427, 1432, 1437, 1441, 1446, 1451,
+    1456, 1461, 1466, 1472, 1477, 1482, 1487, 1492, 1497, 1502, 1507, 1512, 1517, 1522, 1527, 1533,
+    1538, 1543, 1548, 1553, 1558, 1564, 1569, 1574, 1579, 1585, 1590, 1595, 1600, 1606, 1611, 1616,
+    1621, 1627, 1632, 1637, 1643, 1648, 1654, 1659, 1664, 1670, 1675, 1680, 1686, 1691, 1697, 1702,
+    1708, 1713, 1719, 1724, 1730, 1735, 1741, 1746, 1752, 1757, 1763, 1768, 1774, 1779, 1785, 1791,
+    1796, 1802, 1807, 1813, 1819, 1824, 1830, 1836, 1841, 1847, 1853, 1859, 1864, 1870, 1876, 1881,
+    1887, 1893, 1899, 1905, 1910, 1916, 1922, 1928, 1934, 1940, 1945, 1951, 1957, 1963, 1969, 1975,
+    1981, 1987, 1993, 1999, 2005, 2010, 2016, 2022, 2028, 2034, 2040, 2046, 2053, 2059, 2065, 2071,
+    2077, 2083, 2089, 2095, 2101, 2107, 2113, 2119, 2126, 2132, 2138, 2144, 2150, 2157, 2163, 2169,
+    2175, 2181, 2188, 2194, 2200, 2206, 2213, 2219, 2225, 2232, 2238, 2244, 2251, 2257, 2263, 2270,
+    2276, 2283, 2289, 2295, 2302, 2308, 2315, 2321, 2328, 2334, 2340, 2347, 2353, 2360, 2366, 2373,
+    2380, 2386, 2393, 2399, 2406, 2412, 2419, 2426, 2432, 2439, 2445, 2452, 2459, 2465, 2472, 2479,
+    2486, 2492, 2499, 2506, 2512, 2519, 2526, 2533, 2539, 2546, 2553, 2560, 2567, 2573, 2580, 2587,
+    2594, 2601, 2608, 2615, 2622, 2628, 2635, 2642, 2649, 2656, 2663, 2670, 2677, 2684, 2691, 2698,
+    2705, 2712, 2719, 2726, 2733, 2740, 2747, 2754, 2761, 2769, 2776, 2783, 2790, 2797, 2804, 2811,
+    2819, 2826, 2833, 2840, 2847, 2855, 2862, 2869, 2876, 2884, 2891, 2898, 2905, 2913, 2920, 2927,
+    2935, 2942, 2949, 2957, 2964, 2971, 2979, 2986, 2994, 3001, 3009, 3016, 3023, 3031, 3038, 3046,
+    3053, 3061, 3068, 3076, 3083, 3091, 3099, 3106, 3114, 3121, 3129, 3136, 3144, 3152, 3159, 3167,
+    3175, 3182, 3190, 3198, 3205, 3213, 3221, 3228, 3236, 3244, 3252, 3259, 3267, 3275, 3283, 3291,
+    3298, 3306, 3314, 3322, 3330, 3338, 3346, 3353, 3361, 3369, 3377, 3385, 3393, 3401, 3409, 3417,
+    3425, 3433, 3441, 3449, 3457, 3465, 3473, 3481, 3489, 3497, 3505, 3513, 3521, 3529, 3538, 3546,
+    3554, 3562, 3570, 3578, 3586, 3595, 3603, 3611, 3619, 3628, 3636, 3644, 3652, 3661, 3669, 3677,
+    3685, 3694, 3702, 3710, 3719, 3727, 3735, 3744, 3752, 3761, 3769, 3777, 3786, 3794, 3803, 3811,
+    3820, 3828, 3837, 3845, 3854, 3862, 3871, 3879, 3888, 3896, 3905, 3913, 3922, 3931, 3939, 3948,
+    3957, 3965, 3974, 3982, 3991, 4000, 4009, 4017, 4026, 4035, 4043, 4052, 4061, 4070, 4078, 4087,
+    4096
+};
+
+static const uint16_t cie_curve[CURVE_POINTS] = {
+    0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5, 5, 6, 6, 7,
+    7, 8, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 12, 13, 13, 14,
+    14, 15, 15, 15, 16, 16, 17, 17, 18, 18, 19, 19, 19, 20, 20, 21,
+    21, 22, 22, 23, 23, 23, 24, 24, 25, 25, 26, 26, 27, 27, 27, 28,
+    28, 29, 29, 30, 30, 31, 31, 31, 32, 32, 33, 33, 34, 34, 35, 35,
+    35, 36, 36, 37, 37, 38, 38, 39, 39, 40, 40, 40, 41, 41, 42, 42,
+    43, 43, 44, 44, 45, 45, 46, 46, 47, 47, 48, 49, 49, 50, 50, 51,
+    51, 52, 52, 53, 54, 54, 55, 55, 56, 56, 57, 58, 58, 59, 60, 60,
+    61, 61, 62, 63, 63, 64, 65, 65, 66, 67, 67, 68, 69, 69, 70, 71,
+    71, 72, 73, 73, 74, 75, 76, 76, 77, 78, 78, 79, 80, 81, 81, 82,
+    83, 84, 85, 85, 86, 87, 88, 88, 89, 90, 91, 92, 93, 93, 94, 95,
+    96, 97, 98, 98, 99, 100, 101, 102, 103, 104, 105, 106, 106, 107, 108, 109,
+    110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125,
+    126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141,
+    143, 144, 145, 146, 147, 148, 149, 150, 152, 153, 154, 155, 156, 157, 159, 160,
+    161, 162, 163, 165, 166, 167, 168, 169, 171, 172, 173, 174, 176, 177, 178, 180,
+    181, 182, 183, 185, 186, 187, 189, 190, 191, 193, 194, 195, 197, 198, 200, 201,
+    202, 204, 205, 207, 208, 209, 211, 212, 214, 215, 217, 218, 220, 221, 222, 224,
+    225, 227, 228, 230, 231, 233, 235, 236, 238, 239, 241, 242, 244, 245, 247, 249,
+    250, 252, 253, 255, 257, 258, 260, 262, 263, 265, 267, 268, 270, 272, 273, 275,
+    277, 279, 280, 282, 284, 285, 287, 289, 291, 293, 294, 296, 298, 300, 302, 303,
+    305, 307, 309, 311, 313, 314, 316, 318, 320, 322, 324, 326, 328, 330, 332, 334,
+    335, 337, 339, 341, 343, 345, 347, 349, 351, 353, 355, 357, 359, 361, 364, 366,
+    368, 370, 372, 374, 376, 378, 380, 382, 384, 387, 389, 391, 393, 395, 397, 400,
+    402, 404, 406, 408, 411, 413, 415, 417, 420, 422, 424, 427, 429, 431, 433, 436,
+    438, 440, 443, 445, 447, 450, 452, 455, 457, 459, 462, 464, 467, 469, 472, 474,
+    476, 479, 481, 484, 486, 489, 491, 494, 496, 499, 502, 504, 507, 509, 512, 514,
+    517, 520, 522, 525, 527, 530, 533, 535, 538, 541, 543, 546, 549, 552, 554, 557,
+    560, 563, 565, 568, 571, 574, 576, 579, 582, 585, 588, 590, 593, 596, 599, 602,
+    605, 608, 611, 614, 616, 619, 622, 625, 628, 631, 634, 637, 640, 643, 646, 649,
+    652, 655, 658, 661, 664, 668, 671, 674, 677, 680, 683, 686, 689, 693, 696, 699,
+    702, 705, 709, 712, 715, 718, 721, 725, 728, 731, 735, 738, 741, 744, 748, 751,
+    754, 758, 761, 765, 768, 771, 775, 778, 782, 785, 788, 792, 795, 799, 802, 806,
+    809, 813, 816, 820, 823, 827, 831, 834, 838, 841, 845, 849, 852, 856, 859, 863,
+    867, 870, 874, 878, 882, 885, 889, 893, 896, 900, 904, 908, 912, 915, 919, 923,
+    927, 931, 935, 938, 942, 946, 950, 954, 958, 962, 966, 970, 974, 978, 982, 986,
+    990, 994, 998, 1002, 1006, 1010, 1014, 1018, 1022, 1026, 1030, 1034, 1039, 1043, 1047, 1051,
+    1055, 1059, 1064, 1068, 1072, 1076, 1081, 1085, 1089, 1093, 1098, 1102, 1106, 1111, 1115, 1119,
+    1124, 1128, 1133, 1137, 1141, 1146, 1150, 1155, 1159, 1164, 1168, 1172, 1177, 1181, 1186, 1191,
+    1195, 1200, 1204, 1209, 1213, 1218, 1223, 1227, 1232, 1237, 1241, 1246, 1251, 1255, 1260, 1265,
+    1269, 1274, 1279, 1284, 1288, 1293, 1298, 1303, 1308, 1313, 1317, 1322, 1327, 1332, 1337, 1342,
+    1347, 1352, 1357, 1362, 1367, 1371, 1376, 1381, 1387, 1392, 1397, 1402, 1407, 1412, 1417, 1422,
+    1427, 1432, 1437, 1443, 1448, 1453, 1458, 1463, 1468, 1474, 1479, 1484, 1489, 1495, 1500, 1505,
+    1511, 1516, 1521, 1527, 1532, 1537, 1543, 1548, 1554, 1559, 1564, 1570, 1575, 1581, 1586, 1592,
+    1597, 1603, 1608, 1614, 1620, 1625, 1631, 1636, 1642, 1648, 1653, 1659, 1665, 1670, 1676, 1682,
+    1687, 1693, 1699, 1705, 1710, 1716, 1722, 1728, 1734, 1739, 1745, 1751, 1757, 1763, 1769, 1775,
+    1781, 1787, 1793, 1799, 1805, 1811, 1817, 1823, 1829, 1835, 1841, 1847, 1853, 1859, 1865, 1871,
+    1877, 1884, 1890, 1896, 1902, 1908, 1914, 1921, 1927, 1933, 1940, 1946, 1952, 1958, 1965, 1971,
+    1977, 1984, 1990, 1997, 2003, 2009, 2016, 2022, 2029, 2035, 2042, 2048, 2055, 2061, 2068, 2075,
+    2081, 2088, 2094, 2101, 2108, 2114, 2121, 2128, 2134, 2141, 2148, 2154, 2161, 2168, 2175, 2181,
+    2188, 2195, 2202, 2209, 2216, 2223, 2229, 2236, 2243, 2250, 2257, 2264, 2271, 2278, 2285, 2292,
+    2299, 2306, 2313, 2320, 2327, 2334, 2342, 2349, 2356, 2363, 2370, 2377, 2385, 2392, 2399, 2406,
+    2414, 2421, 2428, 2435, 2443, 2450, 2457, 2465, 2472, 2480, 2487, 2494, 2502, 2509, 2517, 2524,
+    2532, 2539, 2547, 2554, 2562, 2569, 2577, 2585, 2592, 2600, 2608, 2615, 2623, 2631, 2638, 2646,
+    2654, 2662, 2669, 2677, 2685, 2693, 2701, 2708, 2716, 2724, 2732, 2740, 2748, 2756, 2764, 2772,
+    2780, 2788, 2796, 2804, 2812, 2820, 2828, 2836, 2844, 2852, 2860, 2868, 2877, 2885, 2893, 2901,
+    2909, 2918, 2926, 2934, 2942, 2951, 2959, 2967, 2976, 2984, 2993, 3001, 3009, 3018, 3026, 3035,
+    3043, 3052, 3060, 3069, 3077, 3086, 3094, 3103, 3112, 3120, 3129, 3137, 3146, 3155, 3164, 3172,
+    3181, 3190, 3199, 3207, 3216, 3225, 3234, 3243, 3251, 3260, 3269, 3278, 3287, 3296, 3305, 3314,
+    3323, 3332, 3341, 3350, 3359, 3368, 3377, 3386, 3395, 3405, 3414, 3423, 3432, 3441, 3450, 3460,
+    3469, 3478, 3488, 3497, 3506, 3515, 3525, 3534, 3544, 3553, 3562, 3572, 3581, 3591, 3600, 3610,
+    3619, 3629, 3638, 3648, 3657, 3667, 3677, 3686, 3696, 3706, 3715, 3725, 3735, 3744, 3754, 3764,
+    3774, 3784, 3793, 3803, 3813, 3823, 3833, 3843, 3853, 3863, 3873, 3883, 3893, 3903, 3913, 3923,
+    3933, 3943, 3953, 3963, 3973, 3983, 3993, 4004, 4014, 4024, 4034, 4044, 4055, 4065, 4075, 4086,
+    4096
+};
+
+#endif
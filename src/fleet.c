@@ -0,0 +1,236 @@
+#include "pca9685_fleet.h"
+#include "registers.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/** Arena layout: each array starts on its own cache line, so walking one never drags in another */
+
+static size_t fleet_layout(pca9685_fleet_s *f, u8 *base, int count) {
+    size_t offset = 0;
+
+    f->shadow = (void *)(base + offset);
+    offset += (size_t)count * PCA9685_FLEET_LED_BYTES;
+    f->staged = (void *)(base + offset);
+    offset += (size_t)count * PCA9685_FLEET_LED_BYTES;
+    f->known = (void *)(base + offset);
+    offset += PCA9685_FLEET_LINES((size_t)count * sizeof(uint16_t));
+    f->pending = (void *)(base + offset);
+    offset += PCA9685_FLEET_LINES((size_t)count * sizeof(uint16_t));
+    f->slave = base + offset;
+    offset += PCA9685_FLEET_LINES((size_t)count);
+    f->dirty = (void *)(base + offset);
+    offset += PCA9685_FLEET_LINES(((size_t)count + 63) / 64 * sizeof(uint64_t));
+
+    return offset;
+}
+
+size_t pca9685_fleet_arena_size(int count) {
+    return PCA9685_FLEET_ARENA_SIZE((size_t)count);
+}
+
+int pca9685_fleet_init(pca9685_fleet_s *f, void *arena, size_t size, const u8 *slaves, int count) {
+    if(count < 0 || size < pca9685_fleet_arena_size(count)) return -1;
+
+    uintptr_t const start = ((uintptr_t)arena + PCA9685_FLEET_LINE - 1) & ~(uintptr_t)(PCA9685_FLEET_LINE - 1);
+    u8 *base = (u8 *)arena + (start - (uintptr_t)arena);
+
+    memset(base, 0, fleet_layout(f, base, count));
+    memcpy(f->slave, slaves, (size_t)count);
+    f->count = count;
+    f->queued = 0;
+    f->result = OK;
+    f->settle_deadline = 0;
+
+    return 0;
+}
+
+/** Write queue: flushed when full and at the end of each operation */
+
+static int led_write(const pca9685_i2c_write_s *w) {
+    return w->address >= LED0_ON_L && w->address < LED0_ON_L + LED_REGISTERS;
+}
+
+// Channels a write to the LED registers touches
+static uint16_t write_channels(const pca9685_i2c_write_s *w) {
+    int const first = (w->address - LED0_ON_L) / MULTIPLIER;
+    int const last = (w->address - LED0_ON_L + w->length - 1) / MULTIPLIER;
+
+    return (uint16_t)(((1u << (last + 1)) - 1) & ~((1u << first) - 1));
+}
+
+static void flush(pca9685_fleet_s *f) {
+    if(f->queued == 0) return;
+
+    u8 const result = f->transfer(f, f->writes, f->queued);
+
+    for(int i = 0; i < f->queued; i++) {
+        const pca9685_fleet_write_s *w = &f->writes[i];
+        if(!led_write(&w->write)) continue;
+
+        if(result == OK) {
+            memcpy(&f->shadow[w->device][w->write.address - LED0_ON_L], w->write.data, w->write.length);
+            f->known[w->device] |= write_channels(&w->write);
+        } else {
+            f->known[w->device] &= (uint16_t)~write_channels(&w->write);
+        }
+    }
+
+    f->result |= result;
+    f->queued = 0;
+}
+
+static void queue(pca9685_fleet_s *f, int device, u8 address, u8 length, const u8 *data) {
+    if(f->queued == PCA9685_FLEET_MAX_WRITES) flush(f);
+
+    f->writes[f->queued++] = (pca9685_fleet_write_s){
+        .device = (uint16_t)device,
+        .slave = f->slave[device],
+        .write = { .address = address, .length = length, .data = data }
+    };
+}
+
+// Same MODE1 on every device, so one byte serves every write
+static u8 write_mode1_all(pca9685_fleet_s *f, const u8 *mode1) {
+    for(int d = 0; d < f->count; d++) queue(f, d, MODE1, 1, mode1);
+    flush(f);
+
+    return f->result;
+}
+
+/** Device setup */
+
+static const u8 mode1_awake = AI | ALLCALL;
+static const u8 mode1_asleep = SLEEP | AI | ALLCALL;
+static const u8 mode1_restart = RESTART | AI | ALLCALL;
+
+// PWM that was running comes back once the oscillator has settled (p. 15)
+static u8 restart_when_settled(pca9685_fleet_s *f) {
+    uint64_t const now = monotonic_ns();
+    if(now < f->settle_deadline) sleep_ns(f->settle_deadline - now);
+
+    f->settle_deadline = 0;
+
+    return write_mode1_all(f, &mode1_restart);
+}
+
+u8 pca9685_fleet_start(pca9685_fleet_s *f) {
+    f->result = OK;
+
+    return write_mode1_all(f, &mode1_awake);
+}
+
+u8 pca9685_fleet_set_frequency(pca9685_fleet_s *f, int frequency) {
+    frequency = (frequency < FREQ_MIN) ? FREQ_MIN
+        : frequency > FREQ_MAX ? FREQ_MAX
+        : frequency;
+
+    f->prescale = (u8)calculate_prescale_from_frequency(frequency);
+    f->result = OK;
+
+    // PRE_SCALE only takes writes while the oscillator is off
+    for(int d = 0; d < f->count; d++) {
+        queue(f, d, MODE1, 1, &mode1_asleep);
+        queue(f, d, PRE_SCALE, 1, &f->prescale);
+    }
+    write_mode1_all(f, &mode1_awake);
+
+    // One wait for the whole fleet; a nonblocking one leaves the restart to the next commit
+    f->settle_deadline = monotonic_ns() + BEAT;
+    if(f->nonblocking) return f->result;
+
+    return restart_when_settled(f);
+}
+
+int pca9685_fleet_is_ready(const pca9685_fleet_s *f) {
+    return f->settle_deadline == 0 || monotonic_ns() >= f->settle_deadline;
+}
+
+/** Staging: bytes the output doesn't depend on keep what the device holds, as on a handle */
+
+static void stage(pca9685_fleet_s *f, int device, int channel, int on, int off) {
+    if(device < 0 || device >= f->count || channel < ALL || channel > MAX_CHANNEL) return;
+
+    int const first = (channel == ALL) ? MIN_CHANNEL : channel;
+    int const last = (channel == ALL) ? MAX_CHANNEL : channel;
+    u8 led[MULTIPLIER], care[MULTIPLIER];
+
+    pca9685_encode_led(led, on, off);
+    pca9685_led_care_mask(led, care);
+
+    for(int c = first; c <= last; c++) {
+        u8 *staged = &f->staged[device][c * MULTIPLIER];
+        const u8 *held = &f->shadow[device][c * MULTIPLIER];
+        int const known = (f->known[device] >> c) & 1;
+
+        for(int i = 0; i < MULTIPLIER; i++) staged[i] = known ? (u8)((held[i] & ~care[i]) | (led[i] & care[i])) : led[i];
+    }
+
+    uint16_t const channels = (channel == ALL) ? (uint16_t)0xFFFF : (uint16_t)(1u << channel);
+    f->pending[device] |= channels;
+    f->dirty[device / 64] |= (uint64_t)1 << (device % 64);
+}
+
+void pca9685_fleet_set_steps(pca9685_fleet_s *f, int device, int channel, int on, int off) {
+    stage(f, device, channel, clamp_steps(on), clamp_steps(off));
+}
+
+void pca9685_fleet_set_brightness(pca9685_fleet_s *f, int device, int channel, uint32_t q16) {
+    int on, off;
+
+    steps_to_led(calculate_steps_from_curve(q16, f->curve), &on, &off);
+    stage(f, device, channel, on, off);
+}
+
+/** Commit: a handle frame's dirty-run merging (led_dirty_runs), one device at a time */
+
+// LED bytes of staged channels that differ from the shadow, or whose channel isn't known
+static uint64_t changed_bytes(const pca9685_fleet_s *f, int device) {
+    uint64_t changed = 0;
+
+    for(int c = 0; c < CHANNELS; c++) {
+        if(!((f->pending[device] >> c) & 1)) continue;
+
+        int const known = (f->known[device] >> c) & 1;
+        for(int i = c * MULTIPLIER; i < (c + 1) * MULTIPLIER; i++) {
+            if(!known || f->staged[device][i] != f->shadow[device][i]) changed |= (uint64_t)1 << i;
+        }
+    }
+
+    return changed;
+}
+
+// Merged gaps are shorter than a channel, so they only hold staged bytes that match the shadow
+static void commit_device(pca9685_fleet_s *f, int device) {
+    frame_range_s runs[FRAME_MAX_RANGES];
+    int const n = led_dirty_runs(changed_bytes(f, device), runs);
+
+    for(int i = 0; i < n; i++) {
+        queue(f, device, runs[i].address, runs[i].length, &f->staged[device][runs[i].address - LED0_ON_L]);
+    }
+
+    f->pending[device] = 0;
+}
+
+u8 pca9685_fleet_commit(pca9685_fleet_s *f) {
+    int const words = (f->count + 63) / 64;
+
+    f->result = OK;
+    if(f->settle_deadline) restart_when_settled(f);
+
+    // Staged bytes stay put until the last flush, so the queued writes can point at them
+    for(int w = 0; w < words; w++) {
+        for(uint64_t bits = f->dirty[w]; bits; bits &= bits - 1) {
+            commit_device(f, w * 64 + lowest_set_bit(bits));
+        }
+        f->dirty[w] = 0;
+    }
+
+    flush(f);
+
+    return f->result;
+}
+
+void pca9685_fleet_invalidate(pca9685_fleet_s *f) {
+    memset(f->known, 0, (size_t)f->count * sizeof(uint16_t));
+}
@@ -0,0 +1,212 @@
+#include "pca9685_linux.h"
+#include "registers.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/** Room for one frame's worth of register writes: every run plus its register byte */
+#define TRANSFER_BUFFER 512
+
+static int sys_open(const char *path, int flags) {
+    return open(path, flags);
+}
+
+static int sys_ioctl(int fd, unsigned long request, void *arg) {
+    return ioctl(fd, request, arg);
+}
+
+const pca9685_linux_io_s pca9685_linux_io = {
+    .open = sys_open,
+    .close = close,
+    .ioctl = sys_ioctl,
+    .write = write
+};
+
+static pca9685_linux_i2c_s *device_of(pca9685_s *h) {
+    return (pca9685_linux_i2c_s *)h->bus_context;
+}
+
+static u8 fail(pca9685_linux_i2c_s *dev) {
+    dev->error = errno;
+    return ERR;
+}
+
+int pca9685_linux_i2c_open(pca9685_linux_i2c_s *dev, int adapter, u8 slave, const pca9685_linux_io_s *io) {
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/i2c-%d", adapter);
+
+    dev->io = io ? io : &pca9685_linux_io;
+    dev->slave = slave;
+    dev->error = 0;
+    dev->fd = dev->io->open(path, O_RDWR);
+
+    if(dev->fd < 0) {
+        dev->error = errno;
+        return -1;
+    }
+
+    if(dev->io->ioctl(dev->fd, I2C_SLAVE, (void *)(unsigned long)slave) < 0) {
+        dev->error = errno;
+        dev->io->close(dev->fd);
+        dev->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void pca9685_linux_i2c_close(pca9685_linux_i2c_s *dev) {
+    if(dev->fd >= 0) dev->io->close(dev->fd);
+    dev->fd = -1;
+}
+
+// Register pointer write and data read in one combined transfer
+static u8 read_registers(pca9685_linux_i2c_s *dev, u8 slave, u8 address, u8 length, u8 *values) {
+    struct i2c_msg msgs[2] = {
+        { .addr = slave, .flags = 0, .len = 1, .buf = &address },
+        { .addr = slave, .flags = I2C_M_RD, .len = length, .buf = values }
+    };
+    struct i2c_rdwr_ioctl_data transfer = { .msgs = msgs, .nmsgs = 2 };
+
+    return (dev->io->ioctl(dev->fd, I2C_RDWR, &transfer) < 0) ? fail(dev) : OK;
+}
+
+static u8 read_register(pca9685_linux_i2c_s *dev, u8 slave, u8 address) {
+    u8 data = 0;
+
+    return (read_registers(dev, slave, address, 1, &data) == OK) ? data : 0;
+}
+
+u8 pca9685_linux_i2c_read(pca9685_s *h, u8 address) {
+    pca9685_linux_i2c_s *dev = device_of(h);
+
+    return read_register(dev, dev->slave, address);
+}
+
+u8 pca9685_linux_i2c_block_read(pca9685_s *h, u8 address, u8 length, u8 *values) {
+    pca9685_linux_i2c_s *dev = device_of(h);
+
+    return read_registers(dev, dev->slave, address, length, values);
+}
+
+u8 pca9685_linux_i2c_write(pca9685_s *h, u8 address, u8 data) {
+    pca9685_linux_i2c_s *dev = device_of(h);
+    const u8 buf[2] = { address, data };
+
+    return (dev->io->write(dev->fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf)) ? OK : fail(dev);
+}
+
+u8 pca9685_linux_i2c_block_write(pca9685_s *h, u8 address, u8 length, const u8 *values) {
+    pca9685_linux_i2c_s *dev = device_of(h);
+    u8 buf[1 + 255];
+
+    buf[0] = address;
+    memcpy(&buf[1], values, length);
+
+    return (dev->io->write(dev->fd, buf, (size_t)length + 1) == (ssize_t)length + 1) ? OK : fail(dev);
+}
+
+static u8 rdwr(pca9685_linux_i2c_s *dev, struct i2c_msg *msgs, unsigned n) {
+    struct i2c_rdwr_ioctl_data transfer = { .msgs = msgs, .nmsgs = n };
+
+    return (dev->io->ioctl(dev->fd, I2C_RDWR, &transfer) < 0) ? fail(dev) : OK;
+}
+
+/* A device's writes too many or too big for one ioctl become one write from the first register to the
+ * last, the registers between them read back first, as frame_join_ranges does for a latched frame */
+static u8 join_writes(pca9685_linux_i2c_s *dev, const pca9685_bus_write_s *writes, int count, u8 *buf, struct i2c_msg *msg) {
+    unsigned first = 0xFF, end = 0;
+
+    for(int i = 0; i < count; i++) {
+        const pca9685_i2c_write_s *w = &writes[i].write;
+        if(w->address < first) first = w->address;
+        if(w->address + w->length > end) end = w->address + w->length;
+    }
+
+    if(end - first > 0xFF) return (errno = EMSGSIZE, fail(dev));
+
+    u8 const length = (u8)(end - first);
+    if(read_registers(dev, writes[0].slave, (u8)first, length, &buf[1]) != OK) return ERR;
+
+    buf[0] = (u8)first;
+    for(int i = 0; i < count; i++) {
+        const pca9685_i2c_write_s *w = &writes[i].write;
+        memcpy(&buf[1 + w->address - first], w->data, w->length);
+    }
+
+    *msg = (struct i2c_msg){ .addr = writes[0].slave, .flags = 0, .len = (uint16_t)(length + 1), .buf = buf };
+
+    return OK;
+}
+
+/* Every write becomes one message of an I2C_RDWR ioctl. Transfers too big for one ioctl are only cut
+ * between devices: each ioctl ends in a STOP, and a latched device has to get all of its runs before it */
+static u8 rdwr_writes(pca9685_linux_i2c_s *dev, const pca9685_bus_write_s *writes, int count) {
+    struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+    u8 buf[TRANSFER_BUFFER];
+    unsigned n = 0;
+    size_t used = 0;
+
+    for(int i = 0, end; i < count; i = end) {
+        size_t bytes = 0;
+
+        for(end = i; end < count && writes[end].slave == writes[i].slave; end++) bytes += writes[end].write.length + 1u;
+
+        unsigned const runs = (unsigned)(end - i);
+        if(n > 0 && (n + runs > I2C_RDWR_IOCTL_MAX_MSGS || used + bytes > sizeof(buf))) {
+            if(rdwr(dev, msgs, n) != OK) return ERR;
+            n = 0;
+            used = 0;
+        }
+
+        if(runs > I2C_RDWR_IOCTL_MAX_MSGS || bytes > sizeof(buf)) {
+            if(join_writes(dev, &writes[i], (int)runs, buf, &msgs[0]) != OK) return ERR;
+            n = 1;
+            used = msgs[0].len;
+            continue;
+        }
+
+        for(int k = i; k < end; k++) {
+            const pca9685_i2c_write_s *w = &writes[k].write;
+            u8 *msg = &buf[used];
+            msg[0] = w->address;
+            memcpy(&msg[1], w->data, w->length);
+
+            msgs[n++] = (struct i2c_msg){ .addr = writes[k].slave, .flags = 0, .len = (uint16_t)(w->length + 1), .buf = msg };
+            used += w->length + 1u;
+        }
+    }
+
+    return n > 0 ? rdwr(dev, msgs, n) : OK;
+}
+
+u8 pca9685_linux_i2c_transfer(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count) {
+    pca9685_linux_i2c_s *dev = device_of(h);
+    pca9685_bus_write_s addressed[255];
+
+    for(u8 i = 0; i < count; i++) addressed[i] = (pca9685_bus_write_s){ .slave = dev->slave, .write = writes[i] };
+
+    return rdwr_writes(dev, addressed, count);
+}
+
+/** Bus-level callbacks */
+
+u8 pca9685_linux_i2c_bus_read(pca9685_bus_s *bus, u8 slave, u8 address) {
+    pca9685_linux_i2c_s *dev = (pca9685_linux_i2c_s *)bus->context;
+
+    return read_register(dev, slave, address);
+}
+
+u8 pca9685_linux_i2c_bus_block_read(pca9685_bus_s *bus, u8 slave, u8 address, u8 length, u8 *values) {
+    return read_registers((pca9685_linux_i2c_s *)bus->context, slave, address, length, values);
+}
+
+u8 pca9685_linux_i2c_bus_transfer(pca9685_bus_s *bus, const pca9685_bus_write_s *writes, int count) {
+    return rdwr_writes((pca9685_linux_i2c_s *)bus->context, writes, count);
+}
@@ -1,50 +1,177 @@
 #include "pca9685.h"
 #include "registers.h"
+#include "stats.h"
 
 #include <stdio.h>
+#include <string.h>
 
 static void set_frequency(pca9685_s *h, int frequency) {
+    uint64_t const start = STATS_START(h);
     set_pwm_frequency(h, frequency);
+    STATS_OP(h, PCA9685_STATS_SET_FREQUENCY, start);
 }
 
 static void set_duty_cycle(pca9685_s *h, int channel, int delay, int percent) {
-   set_pwm_duty_cycle(h, channel, delay, percent);
+    uint64_t const start = STATS_START(h);
+    set_pwm_duty_cycle(h, channel, delay, percent);
+    STATS_OP(h, PCA9685_STATS_SET_DUTY_CYCLE, start);
+}
+
+static void set_steps(pca9685_s *h, int channel, int on, int off) {
+    set_pwm_steps(h, channel, on, off);
+}
+
+static void set_brightness(pca9685_s *h, int channel, uint32_t q16) {
+    set_pwm_brightness(h, channel, q16);
+}
+
+static void set_brightness_all(pca9685_s *h, const uint32_t *q16) {
+    set_pwm_brightness_frame(h, q16);
 }
 
 static void channel_on(pca9685_s *h, int channel) {
-    set_pwm_duty_cycle(h, channel, 0, 100);
+    set_led_bytes(h, channel, LED_FULL_STEPS, 0);
 }
 
 static void channel_off(pca9685_s *h, int channel) {
-    set_pwm_duty_cycle(h, channel, 0, 0);
+    set_led_bytes(h, channel, 0, LED_FULL_STEPS);
 }
 
 static void soft_reset(pca9685_s *h) {
+    uint64_t const start = STATS_START(h);
     reset_driver_soft(h);
+    STATS_OP(h, PCA9685_STATS_SOFT_RESET, start);
 }
 
 static void hard_reset(pca9685_s *h) {
+    uint64_t const start = STATS_START(h);
     reset_driver_hard(h);
+    STATS_OP(h, PCA9685_STATS_HARD_RESET, start);
+}
+
+static void set_curve(pca9685_s *h, int channel, pca9685_curve curve) {
+    set_channel_curve(h, channel, curve);
+}
+
+static void invalidate(pca9685_s *h) {
+    shadow_invalidate(h);
+}
+
+static void resync(pca9685_s *h) {
+    shadow_resync(h);
+}
+
+static void snapshot(pca9685_s *h, pca9685_snapshot_s *state) {
+    snapshot_device(h, state);
+}
+
+static int reconcile(pca9685_s *h, const pca9685_snapshot_s *state) {
+    return reconcile_device(h, state);
+}
+
+static void read_stats(pca9685_s *h, pca9685_stats_s *stats) {
+    if(h->stats) *stats = *h->stats;
+    else memset(stats, 0, sizeof(*stats));
 }
 
+static void reset_stats(pca9685_s *h) {
+    if(h->stats) memset(h->stats, 0, sizeof(*h->stats));
+}
+
+static void begin_frame(pca9685_s *h) {
+    begin_led_frame(h);
+}
+
+static void commit_frame(pca9685_s *h) {
+    commit_led_frame(h);
+}
+
+static void write_frame(pca9685_s *h, const pca9685_frame_s *frame) {
+    set_led_image(h, frame->led);
+}
+
+static int is_ready(pca9685_s *h) {
+    return oscillator_ready(h);
+}
+
+static void wait_ready(pca9685_s *h) {
+    await_oscillator(h);
+}
+
+static int check_idle(pca9685_s *h) {
+    return power_check_idle(h);
+}
+
+const pca9685_ops_s pca9685_ops = {
+    .soft_reset = soft_reset,
+    .hard_reset = hard_reset,
+    .set_frequency = set_frequency,
+    .channel_on = channel_on,
+    .channel_off = channel_off,
+    .set_duty_cycle = set_duty_cycle,
+    .set_steps = set_steps,
+    .set_brightness = set_brightness,
+    .set_brightness_all = set_brightness_all,
+    .set_curve = set_curve,
+    .invalidate = invalidate,
+    .resync = resync,
+    .snapshot = snapshot,
+    .reconcile = reconcile,
+    .begin_frame = begin_frame,
+    .commit_frame = commit_frame,
+    .write_frame = write_frame,
+    .is_ready = is_ready,
+    .wait_ready = wait_ready,
+    .check_idle = check_idle,
+    .read_stats = read_stats,
+    .reset_stats = reset_stats
+};
+
 pca9685_s pca9685_configure_handle(pca9685_s handle){
     if(!(handle.bus_reader && handle.bus_writer)){
         handle.command = "cb_check";
         handle.status = "Invalid input: bus reader and bus writer callbacks are both required.";
+    } else if(handle.latched && !(handle.bus_block_writer || handle.bus_transfer)){
+        handle.command = "latch_check";
+        handle.status = "Invalid input: latched frames need a bus block writer or bus transfer callback.";
     } else {
         handle.command = "rw_check";
 
         // Quick & dirty read/write checks; only verifies the interface, should break on the caller's side.
         pca9685_i2c_bus_read(&handle, LED0_ON_L);
+        shadow_invalidate(&handle);
         pca9685_i2c_bus_write(&handle, LED0_ON_L, handle.data);
     }
 
-    handle.soft_reset = soft_reset;
-    handle.hard_reset = hard_reset;
-    handle.set_frequency = set_frequency;
-    handle.channel_on = channel_on;
-    handle.channel_off = channel_off;
-    handle.set_duty_cycle = set_duty_cycle;
+    const pca9685_ops_s *ops = &pca9685_ops;
+
+    handle.ops = ops;
+
+#if PCA9685_HANDLE_OPS
+    // Copied in as well, so handle.set_frequency(&handle, ...) and friends keep working as they always have
+    handle.soft_reset = ops->soft_reset;
+    handle.hard_reset = ops->hard_reset;
+    handle.set_frequency = ops->set_frequency;
+    handle.channel_on = ops->channel_on;
+    handle.channel_off = ops->channel_off;
+    handle.set_duty_cycle = ops->set_duty_cycle;
+    handle.set_steps = ops->set_steps;
+    handle.set_brightness = ops->set_brightness;
+    handle.set_brightness_all = ops->set_brightness_all;
+    handle.set_curve = ops->set_curve;
+    handle.invalidate = ops->invalidate;
+    handle.resync = ops->resync;
+    handle.snapshot = ops->snapshot;
+    handle.reconcile = ops->reconcile;
+    handle.begin_frame = ops->begin_frame;
+    handle.commit_frame = ops->commit_frame;
+    handle.write_frame = ops->write_frame;
+    handle.is_ready = ops->is_ready;
+    handle.wait_ready = ops->wait_ready;
+    handle.check_idle = ops->check_idle;
+    handle.read_stats = ops->read_stats;
+    handle.reset_stats = ops->reset_stats;
+#endif
 
     handle.command = handle.command == NULL ? "init" : handle.command;
     handle.status = handle.status == NULL ? "ok" : handle.status;
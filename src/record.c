@@ -0,0 +1,329 @@
+#include "record.h"
+#include "registers.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Recording: one record per register byte, each transaction whole or not at all */
+
+// Takes back the parts of the combined transfer being recorded; nothing is flushed in the middle of one
+static void unrecord_transfer(pca9685_recorder_s *r) {
+    while(r->head > r->tail) {
+        const pca9685_record_s *last = &r->ring[--r->head & (r->capacity - 1)];
+        r->dropped++;
+
+        if(last->part == 0 && last->index == 0) break;
+    }
+}
+
+void pca9685_record_bus(pca9685_s *h, pca9685_record_op op, u8 part, u8 address, u8 length, const u8 *data, u8 result) {
+    pca9685_recorder_s *r = h->recorder;
+
+    // A part that doesn't fit drops its whole transfer, so replay never sees half of one
+    if(part == 0) r->dropping = 0;
+    if(!r->dropping && r->capacity - (r->head - r->tail) < length) {
+        if(part != 0) unrecord_transfer(r);
+        r->dropping = 1;
+    }
+
+    if(r->dropping) {
+        r->dropped += length;
+        return;
+    }
+
+    // The parts of a combined transfer completed together
+    uint64_t const now = part != 0 && r->head != 0 ? r->ring[(r->head - 1) & (r->capacity - 1)].timestamp : monotonic_ns();
+
+    for(u8 i = 0; i < length; i++) {
+        r->ring[r->head++ & (r->capacity - 1)] = (pca9685_record_s){
+            .timestamp = now,
+            .slave = h->slave_address,
+            .address = (u8)(address + i),
+            .value = data[i],
+            .op = (u8)op,
+            .result = result,
+            .index = i,
+            .length = length,
+            .part = part
+        };
+    }
+}
+
+int pca9685_recorder_init(pca9685_recorder_s *recorder, pca9685_record_s *ring, uint32_t capacity) {
+    if(capacity == 0 || (capacity & (capacity - 1)) != 0) return -1;
+
+    *recorder = (pca9685_recorder_s){ .ring = ring, .capacity = capacity, .fd = -1 };
+
+    return 0;
+}
+
+/** Trace files */
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+
+    while(size > 0) {
+        ssize_t const n = write(fd, p, size);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return -1;
+
+        p += n;
+        size -= (size_t)n;
+    }
+
+    return 0;
+}
+
+int pca9685_recorder_open(pca9685_recorder_s *recorder, const char *path) {
+    pca9685_trace_header_s header = { .version = PCA9685_TRACE_VERSION, .record_size = sizeof(pca9685_record_s) };
+    memcpy(header.magic, PCA9685_TRACE_MAGIC, sizeof(header.magic));
+
+    int const fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) return -1;
+
+    if(write_all(fd, &header, sizeof(header)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    recorder->fd = fd;
+    recorder->tail = recorder->head;
+
+    return 0;
+}
+
+int pca9685_recorder_flush(pca9685_recorder_s *recorder) {
+    if(recorder->fd < 0) return -1;
+
+    uint64_t const pending = recorder->head - recorder->tail;
+
+    // Up to the end of the ring, then from its start
+    while(recorder->tail != recorder->head) {
+        uint32_t const at = (uint32_t)(recorder->tail & (recorder->capacity - 1));
+        uint64_t n = recorder->capacity - at;
+        if(n > recorder->head - recorder->tail) n = recorder->head - recorder->tail;
+
+        if(write_all(recorder->fd, &recorder->ring[at], (size_t)n * sizeof(pca9685_record_s)) != 0) return -1;
+        recorder->tail += n;
+    }
+
+    return (int)pending;
+}
+
+void pca9685_recorder_close(pca9685_recorder_s *recorder) {
+    if(recorder->fd < 0) return;
+
+    pca9685_recorder_flush(recorder);
+    close(recorder->fd);
+    recorder->fd = -1;
+}
+
+const pca9685_record_s *pca9685_trace_map(const char *path, size_t *count) {
+    struct stat st;
+    int const fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return NULL;
+
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(pca9685_trace_header_s)) {
+        close(fd);
+        return NULL;
+    }
+
+    // A record cut short by a crash mid-flush is left out
+    size_t const records = ((size_t)st.st_size - sizeof(pca9685_trace_header_s)) / sizeof(pca9685_record_s);
+    size_t const size = sizeof(pca9685_trace_header_s) + records * sizeof(pca9685_record_s);
+    void *const base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) return NULL;
+
+    const pca9685_trace_header_s *header = base;
+    if(memcmp(header->magic, PCA9685_TRACE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != PCA9685_TRACE_VERSION || header->record_size != sizeof(pca9685_record_s)) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    *count = records;
+
+    return (const pca9685_record_s *)(const void *)(header + 1);
+}
+
+void pca9685_trace_unmap(const pca9685_record_s *records, size_t count) {
+    const pca9685_trace_header_s *header = (const pca9685_trace_header_s *)(const void *)records - 1;
+
+    munmap((void *)(uintptr_t)header, sizeof(*header) + count * sizeof(pca9685_record_s));
+}
+
+/** Replay */
+
+// Combined transfers larger than this go out in several
+#define REPLAY_MAX_BYTES 4096
+#define REPLAY_MAX_WRITES UINT8_MAX
+
+typedef struct replay {
+    pca9685_s *device;
+    pca9685_replay_stats_s *stats;
+    u8 data[REPLAY_MAX_BYTES];
+    pca9685_i2c_write_s writes[REPLAY_MAX_WRITES];
+} replay_s;
+
+static void timed(replay_s *r, uint64_t start, uint32_t bytes, u8 result) {
+    pca9685_histogram_add(&r->stats->latency, monotonic_ns() - start);
+    r->stats->transactions++;
+    r->stats->bytes += bytes;
+    if(result != OK) r->stats->errors++;
+}
+
+static void replay_read(replay_s *r, u8 address, u8 expected) {
+    uint64_t const start = monotonic_ns();
+    u8 const value = r->device->bus_reader(r->device, address);
+    timed(r, start, 1, OK);
+
+    if(value != expected) r->stats->mismatched++;
+}
+
+static void replay_write(replay_s *r, u8 address, u8 value) {
+    uint64_t const start = monotonic_ns();
+    u8 const result = r->device->bus_writer(r->device, address, value);
+    timed(r, start, 1, result);
+}
+
+static void replay_block_write(replay_s *r, const pca9685_i2c_write_s *w) {
+    if(!r->device->bus_block_writer) {
+        for(u8 i = 0; i < w->length; i++) replay_write(r, (u8)(w->address + i), w->data[i]);
+        return;
+    }
+
+    uint64_t const start = monotonic_ns();
+    u8 const result = r->device->bus_block_writer(r->device, w->address, w->length, w->data);
+    timed(r, start, w->length, result);
+}
+
+static void replay_block_read(replay_s *r, u8 address, u8 length, const u8 *expected) {
+    if(!r->device->bus_block_reader) {
+        for(u8 i = 0; i < length; i++) replay_read(r, (u8)(address + i), expected[i]);
+        return;
+    }
+
+    u8 values[UINT8_MAX];
+    uint64_t const start = monotonic_ns();
+    u8 const result = r->device->bus_block_reader(r->device, address, length, values);
+    timed(r, start, length, result);
+
+    for(u8 i = 0; i < length; i++) r->stats->mismatched += values[i] != expected[i];
+}
+
+static void replay_transfer(replay_s *r, int count) {
+    if(!r->device->bus_transfer) {
+        for(int i = 0; i < count; i++) replay_block_write(r, &r->writes[i]);
+        return;
+    }
+
+    uint32_t bytes = 0;
+    for(int i = 0; i < count; i++) bytes += r->writes[i].length;
+
+    uint64_t const start = monotonic_ns();
+    u8 const result = r->device->bus_transfer(r->device, r->writes, (u8)count);
+    timed(r, start, bytes, result);
+}
+
+// Sends the transaction in records[0, n): its bytes are gathered into writes, one per part
+static void replay_transaction(replay_s *r, const pca9685_record_s *records, size_t n) {
+    int writes = 0;
+    size_t used = 0;
+
+    for(size_t i = 0; i < n; i++) {
+        if(records[i].index == 0) {
+            // Only combined transfers get this big
+            if(writes == REPLAY_MAX_WRITES || used + records[i].length > REPLAY_MAX_BYTES) {
+                replay_transfer(r, writes);
+                writes = 0;
+                used = 0;
+            }
+            r->writes[writes++] = (pca9685_i2c_write_s){ .address = records[i].address, .length = 0, .data = &r->data[used] };
+        }
+
+        r->data[used++] = records[i].value;
+        r->writes[writes - 1].length++;
+    }
+
+    for(int i = 0; i < writes; i++) {
+        const pca9685_i2c_write_s *w = &r->writes[i];
+
+        switch((pca9685_record_op)records[0].op) {
+            case PCA9685_RECORD_READ:
+                replay_read(r, w->address, w->data[0]);
+                break;
+            case PCA9685_RECORD_WRITE:
+                replay_write(r, w->address, w->data[0]);
+                break;
+            case PCA9685_RECORD_BLOCK_READ:
+                replay_block_read(r, w->address, w->length, w->data);
+                break;
+            case PCA9685_RECORD_BLOCK_WRITE:
+                replay_block_write(r, w);
+                break;
+            case PCA9685_RECORD_TRANSFER:
+                replay_transfer(r, writes);
+                return;
+        }
+    }
+}
+
+// Never slave 0, the general call address, which every chip on the bus answers
+static pca9685_s *device_with(pca9685_s *devices, int count, u8 slave) {
+    if(slave == 0) return NULL;
+
+    for(int i = 0; i < count; i++) {
+        if(devices[i].slave_address == slave) return &devices[i];
+    }
+
+    return NULL;
+}
+
+uint64_t pca9685_replay(const pca9685_record_s *records, size_t count, pca9685_s *devices, int device_count,
+        pca9685_replay_speed speed, pca9685_replay_stats_s *stats) {
+    replay_s r = { .stats = stats };
+
+    memset(stats, 0, sizeof(*stats));
+    if(count == 0) return 0;
+
+    stats->recorded_ns = records[count - 1].timestamp - records[0].timestamp;
+
+    uint64_t const begin = monotonic_ns();
+
+    for(size_t i = 0; i < count;) {
+        // A transaction runs up to the next record starting one
+        size_t n = 1;
+        while(i + n < count && (records[i + n].index != 0 || records[i + n].part != 0)) n++;
+
+        r.device = device_with(devices, device_count, records[i].slave);
+
+        if(!r.device) {
+            stats->skipped += n;
+        } else {
+            if(speed == PCA9685_REPLAY_ORIGINAL) {
+                uint64_t const due = begin + (records[i].timestamp - records[0].timestamp);
+                uint64_t now = monotonic_ns();
+
+                if(now < due) {
+                    sleep_ns(due - now);
+                    now = monotonic_ns();
+                }
+                pca9685_histogram_add(&stats->lag, now - due);
+            }
+
+            replay_transaction(&r, &records[i], n);
+        }
+
+        i += n;
+    }
+
+    stats->replayed_ns = monotonic_ns() - begin;
+
+    return stats->transactions;
+}
@@ -1,40 +1,388 @@
 #include "registers.h"
+#include "trace.h"
+#include "stats.h"
+#include "record.h"
+#include "curves.h"
 
 #include <inttypes.h>
-#include <stdio.h>
-#include <math.h>
+#include <string.h>
 #include <time.h>
 
-// for waiting 500μs
-static struct timespec req, rem;
+/** Oscillator settling
+ *
+ * The oscillator needs 500μs after waking before PWM can be restarted (p. 14). A blocking handle
+ * sleeps it out on the spot; a non-blocking one records a deadline, and only a write that needs the
+ * oscillator waits for whatever is left of it. */
 
-static void beat() {
-    // set up our timespec structs
-    if(req.tv_nsec != BEAT) {
-        req.tv_sec = 0;
-        req.tv_nsec = BEAT;
+uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void sleep_ns(uint64_t ns) {
+    struct timespec req = { .tv_sec = (time_t)(ns / 1000000000u), .tv_nsec = (long)(ns % 1000000000u) };
+    struct timespec rem;
+
+    while(nanosleep(&req, &rem) != 0) req = rem;
+}
+
+static void beat(pca9685_s *h) {
+    if(h->nonblocking) {
+        h->settle_deadline = monotonic_ns() + BEAT;
+    } else {
+        sleep_ns(BEAT);
+        STATS_SLEEP(h, BEAT);
+    }
+}
+
+int oscillator_ready(pca9685_s *h) {
+    if(h->settle_deadline && monotonic_ns() >= h->settle_deadline) h->settle_deadline = 0;
+
+    return h->settle_deadline == 0;
+}
+
+void await_oscillator(pca9685_s *h) {
+    if(oscillator_ready(h)) return;
+
+    uint64_t const now = monotonic_ns();
+    if(now < h->settle_deadline) {
+        sleep_ns(h->settle_deadline - now);
+        STATS_SLEEP(h, h->settle_deadline - now);
+    }
+
+    h->settle_deadline = 0;
+}
+
+/** Shadow register file
+ *
+ * The handle keeps a copy of every register the driver has read or written, so writes of bytes the
+ * chip already holds can be skipped and reads of them answered without touching the bus. */
+
+#define LED_LAST_REGISTER (LED0_ON_L + LED_REGISTERS - 1)
+
+// Registers that read back what was written; ALL_LED reads return 0, and the rest are reserved
+static int shadow_is_cacheable(u8 r) {
+    return r <= LED_LAST_REGISTER || r == PRE_SCALE;
+}
+
+static int shadow_matches(const pca9685_s *h, u8 r, u8 d) {
+    return pca9685_shadow_known(h, r) && h->shadow[r] == d;
+}
+
+static void shadow_forget(pca9685_s *h, u8 r) {
+    if(r >= ALL_LED_ON_L && r < PRE_SCALE) {
+        for(u8 c = 0; c < CHANNELS; c++) shadow_forget(h, (u8)(channel_to_register_base(c) + (r - ALL_LED_ON_L)));
+        return;
+    }
+
+    h->shadow_known[r >> 3] &= (u8)~(1 << (r & 7));
+}
+
+// 1 if any channel may be running, 0 if all are held fully off, -1 if the shadow can't tell
+static int shadow_pwm_active(const pca9685_s *h) {
+    for(u8 c = 0; c < CHANNELS; c++) {
+        u8 off_h = (u8)(channel_to_register_base(c) + 3);
+        if(!pca9685_shadow_known(h, off_h)) return -1;
+        if(!(h->shadow[off_h] & LED_FULL_BIT)) return 1;
+    }
+
+    return 0;
+}
+
+// RESTART is cleared by writing 1, unaffected by writing 0, and set by the chip when it is put
+// to sleep with PWM outputs running (p. 14). Where the shadow can't tell, RESTART is assumed set;
+// the worst case is a redundant restart.
+static void shadow_store_mode1(pca9685_s *h, u8 d) {
+    u8 value = (u8)(d & ~RESTART);
+
+    if(!(d & RESTART)) {
+        if(!pca9685_shadow_known(h, MODE1)) {
+            value |= RESTART;
+        } else if(!(h->shadow[MODE1] & SLEEP) && (d & SLEEP)) {
+            if(shadow_pwm_active(h) != 0) value |= RESTART;
+        } else {
+            value |= (u8)(h->shadow[MODE1] & RESTART);
+        }
+    }
+
+    pca9685_shadow_set(h, MODE1, value);
+}
+
+static void shadow_store(pca9685_s *h, u8 r, u8 d) {
+    if(r == MODE1) {
+        shadow_store_mode1(h, d);
+    } else if(r >= ALL_LED_ON_L && r < PRE_SCALE) {
+        // ALL_LED writes land in the same byte of every channel
+        for(u8 c = 0; c < CHANNELS; c++) pca9685_shadow_set(h, (u8)(channel_to_register_base(c) + (r - ALL_LED_ON_L)), d);
+    } else if(shadow_is_cacheable(r)) {
+        pca9685_shadow_set(h, r, d);
+    }
+}
+
+// Whether writing d to r would leave the device unchanged
+static int shadow_write_is_redundant(const pca9685_s *h, u8 r, u8 d) {
+    if(r == MODE1) return !(d & RESTART) && pca9685_shadow_known(h, r) && (h->shadow[r] & ~RESTART) == d;
+
+    if(r >= ALL_LED_ON_L && r < PRE_SCALE) {
+        for(u8 c = 0; c < CHANNELS; c++) {
+            if(!shadow_matches(h, (u8)(channel_to_register_base(c) + (r - ALL_LED_ON_L)), d)) return 0;
+        }
+        return 1;
     }
 
-    nanosleep(&req, &rem);
+    return shadow_is_cacheable(r) && shadow_matches(h, r, d);
+}
+
+void shadow_invalidate(pca9685_s *h) {
+    memset(h->shadow_known, 0, sizeof(h->shadow_known));
+}
+
+void shadow_resync(pca9685_s *h) {
+    shadow_invalidate(h);
+
+    for(int r = MODE1; r <= LED_LAST_REGISTER; r++) pca9685_i2c_bus_read(h, (u8)r);
+    pca9685_i2c_bus_read(h, PRE_SCALE);
 }
 
 /** Userland I2C bus read/write callback wrappers */
 
 void pca9685_i2c_bus_read(pca9685_s *h, u8 r) {
-    u8 result = h->bus_reader(h, r);
-    h->command = "i2c_read";
-    h->status = "ok";
-    h->address = r;
-    h->data = result;
+    u8 result;
+
+    if(pca9685_shadow_known(h, r)) {
+        result = h->shadow[r];
+        TRACE_BUS_EVENT(h, PCA9685_TRACE_SHADOW_READ, r, 1, result, 0, OK);
+    } else {
+        uint64_t const start = STATS_START(h);
+        result = h->bus_reader(h, r);
+        STATS_BUS_CALL(h, PCA9685_STATS_READ, start, 1, OK);
+        RECORD_BUS(h, PCA9685_RECORD_READ, 0, r, 1, &result, OK);
+        if(shadow_is_cacheable(r)) pca9685_shadow_set(h, r, result);
+        TRACE_BUS_EVENT(h, PCA9685_TRACE_READ, r, 1, result, 0, OK);
+    }
+
+    pca9685_bus_status(h, "i2c_read", r, result, OK);
 }
 
-void pca9685_i2c_bus_write(pca9685_s *h, u8 r, u8 d) {
-    fprintf(stdout, "\nWriting %X to register %X\n", d, r);
-    u8 result = h->bus_writer(h, r, d);
-    h->command = "i2c_write";
-    h->status = result == 0 ? "ok" : "error";
-    h->address = r;
-    h->data = d;
+u8 pca9685_i2c_bus_write(pca9685_s *h, u8 r, u8 d) {
+    u8 result = OK;
+
+    if(shadow_write_is_redundant(h, r, d)) {
+        TRACE_BUS_EVENT(h, PCA9685_TRACE_ELIDED_WRITE, r, 1, d, 0, OK);
+        STATS_ELIDED(h, 1);
+    } else {
+        uint64_t const start = STATS_START(h);
+        result = h->bus_writer(h, r, d);
+        STATS_BUS_CALL(h, PCA9685_STATS_WRITE, start, 1, result);
+        RECORD_BUS(h, PCA9685_RECORD_WRITE, 0, r, 1, &d, result);
+        TRACE_BUS_EVENT(h, PCA9685_TRACE_WRITE, r, 1, d, 0, result);
+
+        if(result == OK) shadow_store(h, r, d);
+        else shadow_forget(h, r);
+    }
+
+    pca9685_bus_status(h, "i2c_write", r, d, result);
+
+    return result;
+}
+
+// MODE1 writes keep auto-increment on when block writes are in use, and keep the handle's
+// subaddress/all-call bits so the device goes on answering its group addresses
+static u8 write_mode1(pca9685_s *h, u8 value) {
+    // Restarting PWM needs a stable oscillator
+    if(value & RESTART) await_oscillator(h);
+    if(h->bus_block_writer || h->bus_transfer) value |= AI;
+    value |= h->mode1_flags;
+
+    return pca9685_i2c_bus_write(h, MODE1, value);
+}
+
+// Sets the AI bit without touching the rest of MODE1; writing RESTART back would restart PWM
+u8 ensure_auto_increment(pca9685_s *h) {
+    if(pca9685_shadow_known(h, MODE1) && (h->shadow[MODE1] & AI)) return OK;
+
+    pca9685_i2c_bus_read(h, MODE1);
+    return write_mode1(h, (u8)(h->data & ~RESTART));
+}
+
+// Clears MODE2 OCH, so outputs change at the STOP that ends a transaction rather than at each channel's
+// last ACK; the rest of MODE2 is left as it is
+u8 ensure_latch_on_stop(pca9685_s *h) {
+    if(pca9685_shadow_known(h, MODE2) && !(h->shadow[MODE2] & OCH)) return OK;
+
+    pca9685_i2c_bus_read(h, MODE2);
+    return (h->data & OCH) ? pca9685_i2c_bus_write(h, MODE2, (u8)(h->data & ~OCH)) : OK;
+}
+
+void set_mode1_flags(pca9685_s *h, u8 flags) {
+    u8 const address_bits = ALLCALL | SUB1 | SUB2 | SUB3;
+
+    h->mode1_flags = (u8)(flags & address_bits);
+
+    pca9685_i2c_bus_read(h, MODE1);
+    write_mode1(h, (u8)(h->data & ~(RESTART | address_bits)));
+}
+
+/** Idle power policy
+ *
+ * With idle_sleep_ms set, check_idle puts a device to sleep once every channel has been fully off for
+ * that long, and the next update that lights a channel wakes it. The LED registers keep their values
+ * through sleep (p. 14), so the shadow stays valid and nothing is rewritten: the wake clears SLEEP and
+ * starts the 500μs settle, the update is staged or sent while it runs, and PWM is restarted once it
+ * ends, only if the chip was running PWM when it went to sleep. */
+
+static int power_asleep(const pca9685_s *h) {
+    return pca9685_shadow_known(h, MODE1) && (h->shadow[MODE1] & SLEEP);
+}
+
+// Whether any of \c channels channels' bytes in \c led leave full off
+static int leds_lit(const u8 *led, int channels) {
+    for(int c = 0; c < channels; c++) {
+        if(!(led[c * MULTIPLIER + 3] & LED_FULL_BIT)) return 1;
+    }
+
+    return 0;
+}
+
+// Starts the idle clock when the shadow shows every channel off, and stops it when any may be on
+static void power_note_leds(pca9685_s *h) {
+    if(shadow_pwm_active(h) != 0) h->idle_since = 0;
+    else if(h->idle_since == 0) h->idle_since = monotonic_ns();
+}
+
+static void power_wake(pca9685_s *h, const u8 *led, int channels) {
+    if(!h->idle_sleep_ms || h->waking || !power_asleep(h) || !leds_lit(led, channels)) return;
+
+    write_mode1(h, (u8)(h->shadow[MODE1] & ~(SLEEP | RESTART)));
+    h->settle_deadline = monotonic_ns() + BEAT;
+    h->waking = 1;
+}
+
+u8 power_leds_written(pca9685_s *h) {
+    u8 result = OK;
+
+    if(!h->idle_sleep_ms) return OK;
+
+    // The shadow's RESTART says whether PWM was running when the chip went to sleep; write_mode1 waits
+    // out whatever is left of the settle before restarting it
+    if(h->waking) {
+        h->waking = 0;
+        if(pca9685_shadow_known(h, MODE1) && (h->shadow[MODE1] & RESTART)) result = write_mode1(h, (u8)(h->shadow[MODE1] | RESTART));
+    }
+
+    power_note_leds(h);
+
+    return result;
+}
+
+int power_check_idle(pca9685_s *h) {
+    if(power_asleep(h)) return 1;
+    if(!h->idle_sleep_ms || h->frame_open) return 0;
+
+    power_note_leds(h);
+    if(h->idle_since == 0 || monotonic_ns() - h->idle_since < (uint64_t)h->idle_sleep_ms * 1000000u) return 0;
+
+    pca9685_i2c_bus_read(h, MODE1);
+    write_mode1(h, (u8)((h->data & ~RESTART) | SLEEP));
+
+    return power_asleep(h);
+}
+
+// Drops the redundant bytes at either end of a write
+static void trim_write(const pca9685_s *h, pca9685_i2c_write_s *w) {
+    while(w->length > 0 && shadow_write_is_redundant(h, w->address, w->data[0])) {
+        w->address++;
+        w->data++;
+        w->length--;
+    }
+    while(w->length > 0 && shadow_write_is_redundant(h, (u8)(w->address + w->length - 1), w->data[w->length - 1])) {
+        w->length--;
+    }
+}
+
+u8 pca9685_i2c_bus_write_block(pca9685_s *h, u8 r, u8 n, const u8 *d) {
+    // Only the span between the first and last changed byte goes on the bus
+    pca9685_i2c_write_s write = { .address = r, .length = n, .data = d };
+    trim_write(h, &write);
+    STATS_ELIDED(h, n - write.length);
+    r = write.address;
+    n = write.length;
+    d = write.data;
+
+    if(n == 0) {
+        h->command = h->bus_block_writer ? "i2c_block_write" : "i2c_write";
+        h->status = "ok";
+        return OK;
+    }
+
+    // One byte needs neither a block write nor auto-increment
+    if(n == 1) return pca9685_i2c_bus_write(h, r, d[0]);
+
+    if(!h->bus_block_writer && h->bus_transfer) return pca9685_i2c_bus_write_multi(h, &write, 1);
+
+    if(!h->bus_block_writer) {
+        u8 result = OK;
+        for(u8 i = 0; i < n; i++) result |= pca9685_i2c_bus_write(h, (u8)(r + i), d[i]);
+        return result;
+    }
+
+    u8 const setup = ensure_auto_increment(h);
+
+    uint64_t const start = STATS_START(h);
+    u8 result = h->bus_block_writer(h, r, n, d);
+    STATS_BUS_CALL(h, PCA9685_STATS_BLOCK_WRITE, start, n, result);
+    RECORD_BUS(h, PCA9685_RECORD_BLOCK_WRITE, 0, r, n, d, result);
+    TRACE_BUS_EVENT(h, PCA9685_TRACE_BLOCK_WRITE, r, n, d[0], 0, result);
+
+    for(u8 i = 0; i < n; i++) {
+        if(result == OK) shadow_store(h, (u8)(r + i), d[i]);
+        else shadow_forget(h, (u8)(r + i));
+    }
+
+    pca9685_bus_status(h, "i2c_block_write", r, d[n - 1], result);
+
+    return setup | result;
+}
+
+u8 pca9685_i2c_bus_write_multi(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count) {
+    if(count == 0) return OK;
+
+    if(!h->bus_transfer || (count < 2 && h->bus_block_writer)) {
+        u8 result = OK;
+        for(u8 i = 0; i < count; i++) result |= pca9685_i2c_bus_write_block(h, writes[i].address, writes[i].length, writes[i].data);
+        return result;
+    }
+
+    u8 const setup = ensure_auto_increment(h);
+
+    uint64_t const start = STATS_START(h);
+    u8 const result = h->bus_transfer(h, writes, count);
+    STATS_BUS_CALL(h, PCA9685_STATS_TRANSFER, start, 0, result);
+    for(u8 i = 0; i < count; i++) RECORD_BUS(h, PCA9685_RECORD_TRANSFER, i, writes[i].address, writes[i].length, writes[i].data, result);
+
+    pca9685_i2c_bus_writes_done(h, writes, count, result);
+
+    return setup | result;
+}
+
+void pca9685_i2c_bus_writes_done(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count, u8 result) {
+    if(count == 0) return;
+
+    STATS_TRANSFER_WRITES(h, writes, count, result);
+
+    for(u8 i = 0; i < count; i++) {
+        const pca9685_i2c_write_s *w = &writes[i];
+        TRACE_BUS_EVENT(h, PCA9685_TRACE_BLOCK_WRITE, w->address, w->length, w->data[0], 0, result);
+
+        for(u8 j = 0; j < w->length; j++) {
+            if(result == OK) shadow_store(h, (u8)(w->address + j), w->data[j]);
+            else shadow_forget(h, (u8)(w->address + j));
+        }
+    }
+
+    pca9685_bus_status(h, "i2c_transfer", writes[count - 1].address, writes[count - 1].data[writes[count - 1].length - 1], result);
 }
 
 /** Calculations */
@@ -49,13 +397,39 @@ u8 channel_to_register_base(u8 c){
     return (u8)(LED_OFFSET + (MULTIPLIER * channel));
 }
 
-static u8 led_low(int v) {
-    return (u8)(v & 0xFF);
-}
+/* Lookup tables, expanded by the preprocessor so the compiler folds every entry to a constant.
+ * Both round half up in integer arithmetic; neither quotient can land on exactly .5, so the results
+ * are identical to rounding the real-valued formulas. */
 
-static u8 led_high(int v) {
-    return (u8)(v >> 0x08);
-}
+#define REPEAT_10(M, b)   M((b) + 0), M((b) + 1), M((b) + 2), M((b) + 3), M((b) + 4), \
+                          M((b) + 5), M((b) + 6), M((b) + 7), M((b) + 8), M((b) + 9)
+#define REPEAT_100(M, b)  REPEAT_10(M, (b) + 0), REPEAT_10(M, (b) + 10), REPEAT_10(M, (b) + 20), \
+                          REPEAT_10(M, (b) + 30), REPEAT_10(M, (b) + 40), REPEAT_10(M, (b) + 50), \
+                          REPEAT_10(M, (b) + 60), REPEAT_10(M, (b) + 70), REPEAT_10(M, (b) + 80), \
+                          REPEAT_10(M, (b) + 90)
+#define REPEAT_500(M, b)  REPEAT_100(M, (b) + 0), REPEAT_100(M, (b) + 100), REPEAT_100(M, (b) + 200), \
+                          REPEAT_100(M, (b) + 300), REPEAT_100(M, (b) + 400)
+
+// round(LED_MAX_STEPS * p / 100)
+#define PERCENT_TO_STEPS(p) ((LED_MAX_STEPS * (p) + 50) / 100)
+
+// round(OSCILLATOR / (LED_MAX_STEPS * f)) - 1 (p. 25)
+#define FREQUENCY_TO_PRESCALE(f) ((2 * OSCILLATOR + LED_MAX_STEPS * (f)) / (2 * LED_MAX_STEPS * (f)) - 1)
+
+static const uint16_t percent_steps[101] = {
+    REPEAT_100(PERCENT_TO_STEPS, 0), PERCENT_TO_STEPS(100)
+};
+
+static const u8 frequency_prescales[FREQ_MAX - FREQ_MIN + 1] = {
+    REPEAT_500(FREQUENCY_TO_PRESCALE, FREQ_MIN),
+    REPEAT_500(FREQUENCY_TO_PRESCALE, FREQ_MIN + 500),
+    REPEAT_500(FREQUENCY_TO_PRESCALE, FREQ_MIN + 1000),
+    FREQUENCY_TO_PRESCALE(FREQ_MIN + 1500),
+    FREQUENCY_TO_PRESCALE(FREQ_MIN + 1501),
+    FREQUENCY_TO_PRESCALE(FREQ_MIN + 1502)
+};
+
+_Static_assert(FREQ_MAX - FREQ_MIN + 1 == 1503, "frequency_prescales initializer covers 1503 frequencies");
 
 // Calculates prescale value from a PWM output frequency, in Hz
 int calculate_prescale_from_frequency(int frequency){
@@ -64,9 +438,7 @@ int calculate_prescale_from_frequency(int frequency){
             : (frequency > FREQ_MAX) ? FREQ_MAX
             : frequency;
 
-    double prescale_value = round((OSCILLATOR / (LED_MAX_STEPS * frequency)) - 1);
-
-    return (int)prescale_value;
+    return frequency_prescales[frequency - FREQ_MIN];
 }
 
 // Calculate delay from percentage
@@ -76,7 +448,7 @@ int calculate_delay_time_from_percentage(int d) {
         : (d > 100) ? 100
         : d;
 
-    return (int)round(LED_MAX_STEPS * ((double)percent_delay / 100));
+    return percent_steps[percent_delay];
 }
 
 // Calculate on time from percentage
@@ -86,7 +458,7 @@ int calculate_on_time_from_percentage(int p) {
         : (p > 100) ? 100
         : p;
 
-    return (int)round((percent_on * (double)LED_MAX_STEPS) / 100);
+    return percent_steps[percent_on];
 }
 
 // calculate off steps from delay and on time
@@ -100,17 +472,308 @@ int calculate_off_time_from_delay_and_on_time(int d, int t) {
    return off_time;
 }
 
+// Q16 brightness (0x10000 is fully on) to 0–4096 steps, rounding half up
+int calculate_steps_from_brightness(uint32_t q16) {
+    if(q16 > BRIGHTNESS_MAX) q16 = BRIGHTNESS_MAX;
+
+    return (int)((q16 * LED_MAX_STEPS + (BRIGHTNESS_MAX >> 1)) >> 16);
+}
+
+const uint16_t *curve_table(pca9685_curve curve) {
+    return (curve == PCA9685_CURVE_LINEAR) ? NULL
+        : (curve == PCA9685_CURVE_CIE) ? cie_curve
+        : gamma_curve;
+}
+
+// Q16 brightness through a correction curve to 0–4096 steps, interpolating between table points
+int calculate_steps_from_curve(uint32_t q16, pca9685_curve curve) {
+    if(curve == PCA9685_CURVE_LINEAR) return calculate_steps_from_brightness(q16);
+    if(q16 > BRIGHTNESS_MAX) q16 = BRIGHTNESS_MAX;
+
+    const uint16_t *table = (curve == PCA9685_CURVE_CIE) ? cie_curve : gamma_curve;
+    uint32_t const i = q16 >> CURVE_SHIFT;
+    if(i >= CURVE_POINTS - 1) return table[CURVE_POINTS - 1];
+
+    uint32_t const fraction = q16 & ((1u << CURVE_SHIFT) - 1);
+    uint32_t const rise = (uint32_t)(table[i + 1] - table[i]);
+
+    return (int)(table[i] + ((rise * fraction + (1u << (CURVE_SHIFT - 1))) >> CURVE_SHIFT));
+}
+
+int clamp_steps(int steps) {
+    return (steps < 0) ? 0
+        : (steps > LED_MAX_BITS) ? LED_MAX_BITS
+        : steps;
+}
+
+// 0 and 4096 steps use the full-off and full-on bits; anything between starts the pulse at step 0
+void steps_to_led(int steps, int *on, int *off) {
+    *on = (steps >= LED_MAX_STEPS) ? LED_FULL_STEPS : 0;
+    *off = (steps <= 0) ? LED_FULL_STEPS
+        : (steps >= LED_MAX_STEPS) ? 0
+        : steps;
+}
+
+/** Brightness curves: a channel's curve applies to its brightness and duty cycle setters */
+
+// Out-of-range channels clamp as in channel_to_register_base, so the curve is that of the channel written
+static pca9685_curve channel_curve(const pca9685_s *h, int c) {
+    int const channel = (c < MIN_CHANNEL) ? MIN_CHANNEL
+        : (c > MAX_CHANNEL) ? MAX_CHANNEL
+        : c;
+
+    return (pca9685_curve)h->curves[channel];
+}
+
+// ALL can only go out through the ALL_LED registers if every channel uses the same curve
+static int curves_uniform(const pca9685_s *h) {
+    for(int c = MIN_CHANNEL + 1; c < CHANNELS; c++) {
+        if(h->curves[c] != h->curves[MIN_CHANNEL]) return 0;
+    }
+
+    return 1;
+}
+
+void set_channel_curve(pca9685_s *h, int c, pca9685_curve curve) {
+    if(c == ALL) {
+        memset(h->curves, curve, sizeof(h->curves));
+    } else if(c >= MIN_CHANNEL && c <= MAX_CHANNEL) {
+        h->curves[c] = (u8)curve;
+    }
+}
+
+static int duty_cycle_on_time(const pca9685_s *h, int c, int p) {
+    pca9685_curve const curve = channel_curve(h, c);
+    if(curve == PCA9685_CURVE_LINEAR) return calculate_on_time_from_percentage(p);
+
+    int const percent = (p < 0) ? 0 : (p > 100) ? 100 : p;
+
+    return calculate_steps_from_curve(((uint32_t)percent * BRIGHTNESS_MAX + 50) / 100, curve);
+}
+
 /** Register operations */
 
+// What the device holds in byte \c i of the LED registers at \c base; for ALL_LED, every channel has to agree
+static int led_shadow_byte(const pca9685_s *h, u8 base, int i, u8 *value) {
+    if(base != ALL_LED_ON_L) {
+        *value = h->shadow[base + i];
+        return pca9685_shadow_known(h, (u8)(base + i));
+    }
+
+    for(u8 c = 0; c < CHANNELS; c++) {
+        u8 const r = (u8)(channel_to_register_base(c) + i);
+        if(!pca9685_shadow_known(h, r) || h->shadow[r] != h->shadow[LED0_ON_L + i]) return 0;
+    }
+
+    *value = h->shadow[LED0_ON_L + i];
+    return 1;
+}
+
+// pca9685_led_minimize, and for ALL_LED against what every channel holds
+static void minimize_led(const pca9685_s *h, u8 base, u8 *led) {
+    if(base != ALL_LED_ON_L) {
+        pca9685_led_minimize(h, base, led);
+        return;
+    }
+
+    u8 care[MULTIPLIER];
+    pca9685_led_care_mask(led, care);
+
+    for(int i = 0; i < MULTIPLIER; i++) {
+        u8 held;
+        if(led_shadow_byte(h, base, i, &held)) led[i] = (u8)((held & ~care[i]) | (led[i] & care[i]));
+    }
+}
+
+// Copies one channel's (or every channel's, for ALL) bytes into the open frame
+static void stage_led(pca9685_s *h, int c, const u8 *led) {
+    int const first = (c == ALL) ? MIN_CHANNEL : (int)(channel_to_register_base((u8)c) - LED_OFFSET) / MULTIPLIER;
+    int const last = (c == ALL) ? MAX_CHANNEL : first;
+
+    for(int channel = first; channel <= last; channel++) {
+        u8 *staged = &h->frame[channel * MULTIPLIER];
+
+        memcpy(staged, led, MULTIPLIER);
+        minimize_led(h, channel_to_register_base((u8)channel), staged);
+        h->frame_staged |= (uint16_t)(1u << channel);
+    }
+}
+
 void set_led_bytes(pca9685_s *h, int c, int on, int off) {
     u8 channel = (c == ALL) ? (u8)ALL_LED_ON_L : channel_to_register_base((u8)c);
 
-    fprintf(stdout, "\nSetting time ON %d time OFF %d on channel %X\n", on, off, channel);
+    TRACE_OP_EVENT(h, PCA9685_TRACE_LED, channel, MULTIPLIER, (uint16_t)on, (uint16_t)off, OK);
+
+    u8 bytes[MULTIPLIER];
+    pca9685_encode_led(bytes, on, off);
+
+    // Waking before staging or sending lets the oscillator settle meanwhile
+    power_wake(h, bytes, 1);
+
+    if(h->frame_open) {
+        stage_led(h, c, bytes);
+        return;
+    }
+
+    minimize_led(h, channel, bytes);
+    pca9685_i2c_bus_write_block(h, channel, MULTIPLIER, bytes);
+    power_leds_written(h);
+}
+
+void set_led_frame(pca9685_s *h, const int *on, const int *off) {
+    u8 bytes[LED_REGISTERS];
+
+    for(int c = 0; c < CHANNELS; c++) {
+        pca9685_encode_led(&bytes[c * MULTIPLIER], on[c], off[c]);
+        if(!h->frame_open) minimize_led(h, channel_to_register_base((u8)c), &bytes[c * MULTIPLIER]);
+    }
+
+    power_wake(h, bytes, CHANNELS);
+
+    if(h->frame_open) {
+        for(int c = 0; c < CHANNELS; c++) stage_led(h, c, &bytes[c * MULTIPLIER]);
+    } else {
+        pca9685_i2c_bus_write_block(h, LED0_ON_L, LED_REGISTERS, bytes);
+        power_leds_written(h);
+    }
+}
+
+// The caller's image is the write's data: no minimal-write encoding, which would need a copy
+void set_led_image(pca9685_s *h, const u8 *led) {
+    TRACE_OP_EVENT(h, PCA9685_TRACE_LED, LED0_ON_L, LED_REGISTERS, 0, 0, OK);
+
+    power_wake(h, led, CHANNELS);
+
+    if(h->frame_open) {
+        memcpy(h->frame, led, LED_REGISTERS);
+        h->frame_staged = (uint16_t)((1u << CHANNELS) - 1);
+        return;
+    }
+
+    pca9685_i2c_bus_write_block(h, LED0_ON_L, LED_REGISTERS, led);
+    power_leds_written(h);
+}
+
+/** Frames: LED writes between begin and commit are staged in memory, then flushed together */
+
+void begin_led_frame(pca9685_s *h) {
+    if(h->frame_open) return;
+
+    h->frame_open = 1;
+    h->frame_staged = 0;
+}
+
+int led_dirty_runs(uint64_t dirty, frame_range_s *ranges) {
+    int count = 0;
+    int end = -1;
+
+    for(; dirty; dirty &= dirty - 1) {
+        int const i = lowest_set_bit(dirty);
+        u8 const r = (u8)(LED0_ON_L + i);
+
+        // A short clean run costs less to resend than a new transaction's start, address and stop
+        if(count > 0 && i - end - 1 <= FRAME_GAP_MERGE) {
+            ranges[count - 1].length = (u8)(r - ranges[count - 1].address + 1);
+        } else {
+            ranges[count].address = r;
+            ranges[count].length = 1;
+            count++;
+        }
+        end = i;
+    }
+
+    return count;
+}
+
+int frame_dirty_ranges(const pca9685_s *h, frame_range_s *ranges) {
+    uint64_t dirty = 0;
+
+    for(int i = 0; i < LED_REGISTERS; i++) {
+        if(((h->frame_staged >> (i / MULTIPLIER)) & 1) && !shadow_write_is_redundant(h, (u8)(LED0_ON_L + i), h->frame[i])) {
+            dirty |= (uint64_t)1 << i;
+        }
+    }
+
+    return led_dirty_runs(dirty, ranges);
+}
+
+// Every channel staged with the same bytes goes out through the ALL_LED registers instead
+static int frame_is_uniform(const pca9685_s *h) {
+    if(h->frame_staged != (uint16_t)((1u << CHANNELS) - 1)) return 0;
+
+    for(int c = 1; c < CHANNELS; c++) {
+        if(memcmp(&h->frame[c * MULTIPLIER], h->frame, MULTIPLIER) != 0) return 0;
+    }
+
+    return 1;
+}
+
+/* Latched frames: without a combined transfer, each run would end in its own STOP and the outputs
+ * would pass through a mix of old and new values. Instead the runs are joined into one write from the
+ * first changed register to the last, the bytes in between resent as the device holds them; they
+ * are read once if the shadow doesn't know them. */
+static void frame_fill_gap(pca9685_s *h, u8 from, u8 to) {
+    for(u8 r = from; r < to; r++) {
+        int const i = r - LED0_ON_L;
+        if((h->frame_staged >> (i / MULTIPLIER)) & 1) continue;
+
+        pca9685_i2c_bus_read(h, r);
+        h->frame[i] = h->data;
+    }
+}
+
+static int frame_join_ranges(pca9685_s *h, frame_range_s *ranges, int count) {
+    if(count < 2) return count;
+
+    for(int i = 1; i < count; i++) {
+        frame_fill_gap(h, (u8)(ranges[i - 1].address + ranges[i - 1].length), ranges[i].address);
+    }
+
+    ranges[0].length = (u8)(ranges[count - 1].address + ranges[count - 1].length - ranges[0].address);
+
+    return 1;
+}
+
+u8 frame_collect_writes(pca9685_s *h, pca9685_i2c_write_s *writes) {
+    u8 count = 0;
+
+    if(!h->frame_open) return 0;
+
+    h->frame_open = 0;
+
+    if(frame_is_uniform(h)) {
+        writes[0] = (pca9685_i2c_write_s){ .address = ALL_LED_ON_L, .length = MULTIPLIER, .data = h->frame };
+        trim_write(h, &writes[0]);
+        count = writes[0].length > 0;
+    } else {
+        frame_range_s ranges[FRAME_MAX_RANGES];
+        int n = frame_dirty_ranges(h, ranges);
+
+        if(h->latched && !h->bus_transfer) n = frame_join_ranges(h, ranges, n);
+
+        for(int i = 0; i < n; i++) {
+            writes[count++] = (pca9685_i2c_write_s){
+                .address = ranges[i].address,
+                .length = ranges[i].length,
+                .data = &h->frame[ranges[i].address - LED0_ON_L]
+            };
+        }
+    }
+
+    h->frame_staged = 0;
+
+    return count;
+}
+
+u8 commit_led_frame(pca9685_s *h) {
+    pca9685_i2c_write_s writes[FRAME_MAX_RANGES];
+    u8 result = OK;
 
-    pca9685_i2c_bus_write(h, channel, led_low(on));
-    pca9685_i2c_bus_write(h, channel + (u8)1, led_high(on));
-    pca9685_i2c_bus_write(h, channel + (u8)2, led_low(off));
-    pca9685_i2c_bus_write(h, channel + (u8)3, led_high(off));
+    if(h->frame_open && h->latched) result |= ensure_latch_on_stop(h);
+    result |= pca9685_i2c_bus_write_multi(h, writes, frame_collect_writes(h, writes));
+    result |= power_leds_written(h);
+
+    return result;
 }
 
 // Sets the value of the PRE_SCALE register with the provided output frequency
@@ -122,51 +785,265 @@ void set_pwm_frequency(pca9685_s *h, int frequency) {
 
     const u8 prescale = (u8)calculate_prescale_from_frequency(frequency);
 
-    pca9685_i2c_bus_write(h, MODE1, SLEEP);
+    // Already running at this frequency; skip the sleep/wake cycle and the oscillator wait
+    if(shadow_matches(h, PRE_SCALE, prescale) && pca9685_shadow_known(h, MODE1) && !(h->shadow[MODE1] & SLEEP)) return;
+
+    write_mode1(h, SLEEP);
     pca9685_i2c_bus_write(h, PRE_SCALE, prescale);
-    pca9685_i2c_bus_write(h, MODE1, MODE1_NO_SLEEP);
+    write_mode1(h, MODE1_NO_SLEEP);
 
-    beat();
+    beat(h);
 }
 
 void set_pwm_duty_cycle(pca9685_s *h, int c, int d, int p) {
     int delay_time = calculate_delay_time_from_percentage(d);
-    int on_time = calculate_on_time_from_percentage(p);
-    int off_time = calculate_off_time_from_delay_and_on_time(delay_time, on_time);
-
     int on_steps = (delay_time <= 0) ? 0 : (delay_time - 1);
 
-    fprintf(stdout, "\nreceived delay %d and on_time %d\n", d, p);
-    fprintf(stdout, "\ndelay_time: %d\n", delay_time);
-    fprintf(stdout, "\non_time: %d\n", on_time);
-    fprintf(stdout, "\non_steps: %d\n", on_time);
-    fprintf(stdout, "\noff_time: %d\n", off_time);
+    TRACE_OP_EVENT(h, PCA9685_TRACE_DUTY_CYCLE, (u8)c, 0, (uint16_t)p, (uint16_t)d, OK);
+
+    if(c == ALL && !curves_uniform(h)) {
+        int on[CHANNELS], off[CHANNELS];
+
+        for(int channel = 0; channel < CHANNELS; channel++) {
+            on[channel] = on_steps;
+            off[channel] = calculate_off_time_from_delay_and_on_time(delay_time, duty_cycle_on_time(h, channel, p));
+        }
+
+        set_led_frame(h, on, off);
+        return;
+    }
+
+    int off_time = calculate_off_time_from_delay_and_on_time(delay_time, duty_cycle_on_time(h, c, p));
 
     set_led_bytes(h, c, on_steps, off_time);
 }
 
+void set_pwm_steps(pca9685_s *h, int c, int on, int off) {
+    set_led_bytes(h, c, clamp_steps(on), clamp_steps(off));
+}
+
+void set_pwm_brightness(pca9685_s *h, int c, uint32_t q16) {
+    if(c == ALL && !curves_uniform(h)) {
+        uint32_t levels[CHANNELS];
+
+        for(int channel = 0; channel < CHANNELS; channel++) levels[channel] = q16;
+        set_pwm_brightness_frame(h, levels);
+        return;
+    }
+
+    int on, off;
+
+    steps_to_led(calculate_steps_from_curve(q16, channel_curve(h, c)), &on, &off);
+    set_led_bytes(h, c, on, off);
+}
+
+void set_pwm_brightness_frame(pca9685_s *h, const uint32_t *q16) {
+    int on[CHANNELS], off[CHANNELS];
+
+    for(int c = 0; c < CHANNELS; c++) steps_to_led(calculate_steps_from_curve(q16[c], channel_curve(h, c)), &on[c], &off[c]);
+
+    set_led_frame(h, on, off);
+}
+
+/** Read-back: snapshots of the device's registers, and reconciling them with the shadow */
+
+#define SNAPSHOT_REGISTERS (LED_LAST_REGISTER + 1)
+
+// One register or a run of them from the device itself, never from the shadow
+static u8 read_register(pca9685_s *h, u8 r) {
+    uint64_t const start = STATS_START(h);
+    u8 const value = h->bus_reader(h, r);
+    STATS_BUS_CALL(h, PCA9685_STATS_READ, start, 1, OK);
+    RECORD_BUS(h, PCA9685_RECORD_READ, 0, r, 1, &value, OK);
+    TRACE_BUS_EVENT(h, PCA9685_TRACE_READ, r, 1, value, 0, OK);
+
+    return value;
+}
+
+static u8 read_block(pca9685_s *h, u8 r, u8 n, u8 *values) {
+    uint64_t const start = STATS_START(h);
+    u8 const result = h->bus_block_reader(h, r, n, values);
+    STATS_BUS_CALL(h, PCA9685_STATS_BLOCK_READ, start, n, result);
+    RECORD_BUS(h, PCA9685_RECORD_BLOCK_READ, 0, r, n, values, result);
+    TRACE_BUS_EVENT(h, PCA9685_TRACE_BLOCK_READ, r, n, values[0], 0, result);
+
+    return result;
+}
+
+// Sets AI on top of the MODE1 found on the device, as ensure_auto_increment does, but leaves the
+// shadow's MODE1 as it was: reconcile takes it for what the device should hold
+static void read_device_auto_increment(pca9685_s *h, u8 found) {
+    int const known = pca9685_shadow_known(h, MODE1);
+    u8 const intended = h->shadow[MODE1];
+
+    shadow_forget(h, MODE1);
+    pca9685_i2c_bus_write(h, MODE1, (u8)((found & ~RESTART) | AI));
+
+    if(known) pca9685_shadow_set(h, MODE1, intended);
+    else shadow_forget(h, MODE1);
+}
+
+/* Reads registers from the device itself, never from the shadow; one transaction with a block reader.
+ * AI is set first if it isn't: a power-on reset clears it, and after a brownout is when a snapshot
+ * matters most. A shadow showing AI set saves asking the device, and a brownout since then shows in
+ * the block read: without AI the device sends the first register over and over, so MODE1 comes back
+ * without AI and the registers are read again once it is set. Snapshots report MODE1 as found. */
+static void read_device(pca9685_s *h, u8 r, u8 n, u8 *values) {
+    u8 result = OK;
+
+    if(!h->bus_block_reader || n == 1) {
+        for(u8 i = 0; i < n; i++) values[i] = read_register(h, (u8)(r + i));
+        h->command = "i2c_read";
+    } else {
+        int const ai_known = pca9685_shadow_known(h, MODE1) && (h->shadow[MODE1] & AI);
+        int found = -1;
+
+        if(!ai_known) {
+            u8 const mode1 = read_register(h, MODE1);
+            if(!(mode1 & AI)) {
+                read_device_auto_increment(h, mode1);
+                found = mode1;
+            }
+        }
+
+        result = read_block(h, r, n, values);
+
+        if(ai_known && r == MODE1 && result == OK && !(values[0] & AI)) {
+            found = values[0];
+            read_device_auto_increment(h, values[0]);
+            result = read_block(h, r, n, values);
+        }
+
+        if(r == MODE1 && found >= 0) values[0] = (u8)found;
+        h->command = "i2c_block_read";
+    }
+
+    h->status = result == OK ? "ok" : "error";
+    h->address = r;
+    h->data = values[n - 1];
+}
+
+static uint16_t led_steps(const u8 *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] & (LED_FULL_BIT | 0x0F)) << 8);
+}
+
+void snapshot_device(pca9685_s *h, pca9685_snapshot_s *s) {
+    memset(s, 0, sizeof(*s));
+
+    read_device(h, MODE1, SNAPSHOT_REGISTERS, s->registers);
+    read_device(h, PRE_SCALE, 1, &s->prescale);
+
+    // Datasheet p. 25, inverted and rounded to the nearest Hz
+    int const period = LED_MAX_STEPS * (s->prescale + 1);
+    s->frequency = (OSCILLATOR + period / 2) / period;
+
+    for(u8 c = 0; c < CHANNELS; c++) {
+        const u8 *led = &s->registers[channel_to_register_base(c)];
+        s->on[c] = led_steps(led);
+        s->off[c] = led_steps(led + 2);
+    }
+
+    u8 const mode1 = s->registers[MODE1], mode2 = s->registers[MODE2];
+    s->sleeping = (mode1 & SLEEP) != 0;
+    s->restart = (mode1 & RESTART) != 0;
+    s->auto_increment = (mode1 & AI) != 0;
+    s->inverted = (mode2 & INVRT) != 0;
+    s->totem_pole = (mode2 & OUTDRV) != 0;
+}
+
+// Whether the shadow holds a value for r that the device doesn't
+static int diverged(const pca9685_s *h, u8 r, u8 device) {
+    return pca9685_shadow_known(h, r) && h->shadow[r] != device;
+}
+
+int reconcile_device(pca9685_s *h, const pca9685_snapshot_s *s) {
+    u8 intended[SNAPSHOT_REGISTERS];
+    int rewritten = 0;
+
+    memcpy(intended, h->shadow, sizeof(intended));
+    u8 const intended_prescale = h->shadow[PRE_SCALE];
+
+    // RESTART reads back whatever the chip last did with PWM; it isn't part of what was written
+    int const mode1_diverged = pca9685_shadow_known(h, MODE1)
+        && ((h->shadow[MODE1] ^ s->registers[MODE1]) & ~RESTART);
+    int const prescale_diverged = diverged(h, PRE_SCALE, s->prescale);
+
+    // From here on the shadow holds what the device holds, so every write below goes on the wire
+    pca9685_shadow_set(h, MODE1, s->registers[MODE1]);
+
+    int first = -1, gap = 0;
+
+    for(int r = MODE2; r <= SNAPSHOT_REGISTERS; r++) {
+        int const dirty = r < SNAPSHOT_REGISTERS && diverged(h, (u8)r, s->registers[r]);
+
+        if(!dirty) {
+            gap++;
+
+            // A short run of known bytes is cheaper to resend than a new transaction
+            if(first >= 0 && (gap > FRAME_GAP_MERGE || r == SNAPSHOT_REGISTERS || !pca9685_shadow_known(h, (u8)r))) {
+                int const last = r - gap;
+                for(int i = first; i <= last; i++) pca9685_shadow_set(h, (u8)i, s->registers[i]);
+                pca9685_i2c_bus_write_block(h, (u8)first, (u8)(last - first + 1), &intended[first]);
+                rewritten += last - first + 1;
+                first = -1;
+            }
+            continue;
+        }
+
+        if(first < 0) first = r;
+        gap = 0;
+    }
+
+    for(int r = MODE2; r < SNAPSHOT_REGISTERS; r++) {
+        if(!pca9685_shadow_known(h, (u8)r)) pca9685_shadow_set(h, (u8)r, s->registers[r]);
+    }
+
+    // PRE_SCALE only takes a write while the oscillator is off
+    if(prescale_diverged) {
+        pca9685_shadow_set(h, PRE_SCALE, s->prescale);
+        write_mode1(h, SLEEP);
+        pca9685_i2c_bus_write(h, PRE_SCALE, intended_prescale);
+        rewritten++;
+    }
+
+    if(mode1_diverged || prescale_diverged) {
+        u8 const mode1 = (u8)((mode1_diverged ? intended[MODE1] : s->registers[MODE1]) & ~RESTART);
+
+        write_mode1(h, mode1);
+        if(!(mode1 & SLEEP)) beat(h);
+        rewritten++;
+    }
+
+    if(!pca9685_shadow_known(h, PRE_SCALE)) pca9685_shadow_set(h, PRE_SCALE, s->prescale);
+
+    return rewritten;
+}
+
 // Reset without having to power cycle (p. 15)
 void reset_driver_soft(pca9685_s *h){
     // Set oscillator sleep bit
-    pca9685_i2c_bus_write(h, MODE1, SLEEP);
+    write_mode1(h, SLEEP);
 
-    // default duty cycle and frequency
-    set_pwm_duty_cycle(h, ALL, 0, 0);
+    // all channels off, default frequency
+    set_led_bytes(h, ALL, 0, LED_FULL_STEPS);
     set_pwm_frequency(h, 200);
 
     // check restart bit and reset; saves PWM register contents
     pca9685_i2c_bus_read(h, MODE1);
     u8 value = h->data;
-    if(value & RESTART) pca9685_i2c_bus_write(h, MODE1, MODE1_NO_SLEEP);
-    beat();
-    pca9685_i2c_bus_write(h, MODE1, RESTART);
+    if(value & RESTART) write_mode1(h, MODE1_NO_SLEEP);
+    beat(h);
+    write_mode1(h, RESTART);
 }
 
 void reset_driver_hard(pca9685_s *h) {
-    pca9685_i2c_bus_write(h, MODE1, SLEEP);
+    // A hard reset rewrites everything, whatever the shadow believes
+    shadow_invalidate(h);
+
+    write_mode1(h, SLEEP);
 
     /** Turn off all channels and reset frequency to default */
-    set_pwm_duty_cycle(h, ALL, 0, 0);
+    set_led_bytes(h, ALL, 0, LED_FULL_STEPS);
     set_pwm_frequency(h, 200);
 
     /** Reset register default values */
@@ -175,8 +1052,8 @@ void reset_driver_hard(pca9685_s *h) {
     pca9685_i2c_bus_write(h, SUBADR3, SUBADR3_DEFAULTS);
     pca9685_i2c_bus_write(h, ALLCALLADR, ALLCALLADR_DEFAULTS);
     pca9685_i2c_bus_write(h, MODE2, MODE2_DEFAULTS);
-    pca9685_i2c_bus_write(h, MODE1, MODE1_DEFAULTS);
+    write_mode1(h, MODE1_DEFAULTS);
 
-    beat();
+    beat(h);
 }
 
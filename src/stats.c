@@ -0,0 +1,52 @@
+#include "stats.h"
+#include "registers.h"
+
+#include <string.h>
+
+// Latencies under 2^10 ns land in bucket 0, then one bucket per doubling
+#define BUCKET_SHIFT 10
+
+void pca9685_histogram_add(pca9685_histogram_s *histogram, uint64_t ns) {
+    int bucket = 0;
+
+    for(uint64_t scaled = ns >> BUCKET_SHIFT; scaled > 0 && bucket < PCA9685_STATS_BUCKETS - 1; scaled >>= 1) bucket++;
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ns += ns;
+    if(ns > histogram->max_ns) histogram->max_ns = ns;
+}
+
+void pca9685_stats_record_bus_call(pca9685_s *h, pca9685_stats_bus call, uint64_t start, uint32_t bytes, u8 result) {
+    pca9685_stats_s *s = h->stats;
+
+    pca9685_histogram_add(&s->bus[call], monotonic_ns() - start);
+    s->transactions++;
+
+    // Combined transfers count their writes through pca9685_stats_record_writes
+    if(call == PCA9685_STATS_TRANSFER) return;
+
+    if(call == PCA9685_STATS_READ || call == PCA9685_STATS_BLOCK_READ) s->reads++;
+    else s->writes++;
+
+    s->bytes += bytes;
+    if(result != OK) s->errors++;
+}
+
+void pca9685_stats_record_writes(pca9685_s *h, const pca9685_i2c_write_s *writes, u8 count, u8 result) {
+    pca9685_stats_s *s = h->stats;
+
+    for(u8 i = 0; i < count; i++) s->bytes += writes[i].length;
+
+    s->writes += count;
+    if(result != OK) s->errors += count;
+}
+
+void pca9685_stats_record_op(pca9685_s *h, pca9685_stats_op op, uint64_t start) {
+    pca9685_histogram_add(&h->stats->ops[op], monotonic_ns() - start);
+}
+
+void pca9685_stats_record_sleep(pca9685_s *h, uint64_t ns) {
+    h->stats->sleeps++;
+    h->stats->sleep_ns += ns;
+}
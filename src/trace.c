@@ -0,0 +1,17 @@
+#include "trace.h"
+#include "registers.h"
+
+void pca9685_trace_emit(pca9685_s *h, pca9685_trace_op op, u8 address, u8 length,
+        uint16_t value, uint16_t extra, u8 result) {
+    const pca9685_trace_event_s event = {
+        .timestamp = monotonic_ns(),
+        .op = op,
+        .address = address,
+        .length = length,
+        .result = result,
+        .value = value,
+        .extra = extra
+    };
+
+    h->trace(h, &event);
+}
@@ -0,0 +1,216 @@
+#include "pca9685_worker.h"
+#include "registers.h"
+
+
+/** Submission ring: producers claim a slot by advancing tail, the worker frees it by advancing its
+ * sequence a lap ahead */
+
+static int ring_push(pca9685_worker_s *w, const pca9685_worker_entry_s *entry) {
+    size_t pos = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    pca9685_worker_slot_s *slot;
+
+    for(;;) {
+        slot = &w->ring[pos & (PCA9685_WORKER_RING - 1)];
+        size_t const sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        ptrdiff_t const diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&w->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) break;
+        } else if(diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&w->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->entry = *entry;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    return 0;
+}
+
+static int ring_ready(pca9685_worker_s *w) {
+    const pca9685_worker_slot_s *slot = &w->ring[w->head & (PCA9685_WORKER_RING - 1)];
+
+    return atomic_load(&slot->sequence) == w->head + 1;
+}
+
+static int ring_pop(pca9685_worker_s *w, pca9685_worker_entry_s *entry) {
+    pca9685_worker_slot_s *slot = &w->ring[w->head & (PCA9685_WORKER_RING - 1)];
+
+    if(!ring_ready(w)) return -1;
+
+    *entry = slot->entry;
+    atomic_store_explicit(&slot->sequence, w->head + PCA9685_WORKER_RING, memory_order_release);
+    w->head++;
+
+    return 0;
+}
+
+static void complete(pca9685_request_s *request, pca9685_request_state state) {
+    if(request) atomic_store_explicit(&request->state, state, memory_order_release);
+}
+
+/** Worker thread: drain the ring, keep the latest update per channel, send them as one frame */
+
+typedef struct pending {
+    u8 queued;
+    pca9685_worker_entry_s entry;
+} pending_s;
+
+static void replace(pending_s *p, const pca9685_worker_entry_s *entry) {
+    if(p->queued) complete(p->entry.request, PCA9685_REQUEST_SUPERSEDED);
+
+    p->queued = 1;
+    p->entry = *entry;
+}
+
+static void apply(pca9685_s *h, const pca9685_worker_entry_s *entry) {
+    if(entry->op == PCA9685_WORKER_BRIGHTNESS) {
+        set_pwm_brightness(h, entry->channel, entry->q16);
+    } else {
+        set_pwm_steps(h, entry->channel, entry->on, entry->off);
+    }
+}
+
+static int drain(pca9685_worker_s *w) {
+    pending_s all = { 0 }, channels[CHANNELS] = { { 0 } };
+    pca9685_worker_entry_s entry;
+    int count = 0;
+
+    while(ring_pop(w, &entry) == 0) {
+        count++;
+
+        if(entry.channel == ALL) {
+            for(int c = 0; c < CHANNELS; c++) {
+                if(channels[c].queued) complete(channels[c].entry.request, PCA9685_REQUEST_SUPERSEDED);
+                channels[c].queued = 0;
+            }
+            replace(&all, &entry);
+        } else {
+            replace(&channels[entry.channel], &entry);
+        }
+    }
+
+    if(count == 0) return 0;
+
+    pca9685_s *h = w->driver;
+
+    // Per-channel updates queued after an ALL update override it, and frames keep the last write
+    begin_led_frame(h);
+    if(all.queued) apply(h, &all.entry);
+    for(int c = 0; c < CHANNELS; c++) {
+        if(channels[c].queued) apply(h, &channels[c].entry);
+    }
+    // Any failed call of the commit fails them all, not only the last one status tells of
+    pca9685_request_state const state = commit_led_frame(h) == OK ? PCA9685_REQUEST_DONE : PCA9685_REQUEST_FAILED;
+    if(all.queued) complete(all.entry.request, state);
+    for(int c = 0; c < CHANNELS; c++) {
+        if(channels[c].queued) complete(channels[c].entry.request, state);
+    }
+
+    return count;
+}
+
+static void *run(void *arg) {
+    pca9685_worker_s *w = arg;
+
+    while(atomic_load(&w->running)) {
+        if(drain(w)) continue;
+
+        // Producers check idle after publishing, and the worker checks the ring after setting it,
+        // so one of them always sees the other
+        pthread_mutex_lock(&w->lock);
+        atomic_store(&w->idle, 1);
+        if(!ring_ready(w) && atomic_load(&w->running)) pthread_cond_wait(&w->wake, &w->lock);
+        atomic_store(&w->idle, 0);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    while(drain(w)) {}
+
+    return NULL;
+}
+
+static void wake(pca9685_worker_s *w) {
+    // Orders the slot's publication before the idle check, against the worker's idle store and ring check
+    atomic_thread_fence(memory_order_seq_cst);
+    if(!atomic_load(&w->idle)) return;
+
+    pthread_mutex_lock(&w->lock);
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/** Public API */
+
+int pca9685_worker_start(pca9685_worker_s *worker, pca9685_s *driver) {
+    worker->driver = driver;
+    worker->head = 0;
+    atomic_init(&worker->tail, 0);
+    atomic_init(&worker->running, 1);
+    atomic_init(&worker->idle, 0);
+    for(size_t i = 0; i < PCA9685_WORKER_RING; i++) atomic_init(&worker->ring[i].sequence, i);
+
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+
+    // Channel updates only need AI set once, before the worker takes the bus
+    if(driver->bus_block_writer || driver->bus_transfer) ensure_auto_increment(driver);
+
+    int const result = pthread_create(&worker->thread, NULL, run, worker);
+    if(result != 0) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+    }
+
+    return result;
+}
+
+void pca9685_worker_stop(pca9685_worker_s *worker) {
+    atomic_store(&worker->running, 0);
+
+    pthread_mutex_lock(&worker->lock);
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_join(worker->thread, NULL);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+}
+
+static int submit(pca9685_worker_s *w, const pca9685_worker_entry_s *entry) {
+    if(entry->channel < ALL || entry->channel >= CHANNELS) return -1;
+
+    if(entry->request) atomic_store_explicit(&entry->request->state, PCA9685_REQUEST_PENDING, memory_order_relaxed);
+
+    if(ring_push(w, entry) != 0) {
+        if(entry->request) atomic_store_explicit(&entry->request->state, PCA9685_REQUEST_IDLE, memory_order_relaxed);
+        return -1;
+    }
+
+    wake(w);
+
+    return 0;
+}
+
+int pca9685_worker_submit_steps(pca9685_worker_s *worker, int channel, int on, int off, pca9685_request_s *request) {
+    const pca9685_worker_entry_s entry = {
+        .op = PCA9685_WORKER_STEPS, .channel = channel, .on = on, .off = off, .request = request
+    };
+
+    return submit(worker, &entry);
+}
+
+int pca9685_worker_submit_brightness(pca9685_worker_s *worker, int channel, uint32_t q16, pca9685_request_s *request) {
+    const pca9685_worker_entry_s entry = {
+        .op = PCA9685_WORKER_BRIGHTNESS, .channel = channel, .q16 = q16, .request = request
+    };
+
+    return submit(worker, &entry);
+}
+
+pca9685_request_state pca9685_request_poll(pca9685_request_s *request) {
+    return (pca9685_request_state)atomic_load_explicit(&request->state, memory_order_acquire);
+}
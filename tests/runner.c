@@ -13,6 +13,31 @@ int main(int argc, char **argv) {
 
     RUN_SUITE(test_driver_init);
     RUN_SUITE(test_register_ops);
+    RUN_SUITE(test_frames);
+    RUN_SUITE(test_trace);
+    RUN_SUITE(test_bus);
+    RUN_SUITE(test_anim);
+    RUN_SUITE(test_stats);
+    RUN_SUITE(test_emu);
+    RUN_SUITE(test_fleet);
+    RUN_SUITE(test_convert);
+    RUN_SUITE(test_power);
+
+#ifdef PCA9685_HAVE_LINUX_I2C
+    RUN_SUITE(test_linux_i2c);
+#endif
+
+#ifdef PCA9685_HAVE_WORKER
+    RUN_SUITE(test_worker);
+#endif
+
+#if PCA9685_RECORDER
+    RUN_SUITE(test_record);
+#endif
+
+#ifdef PCA9685_HAVE_CXX
+    RUN_SUITE(test_wrapper);
+#endif
 
     GREATEST_PRINT_REPORT();
 
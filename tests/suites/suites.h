@@ -5,5 +5,30 @@
 
 SUITE_EXTERN(test_driver_init);
 SUITE_EXTERN(test_register_ops);
+SUITE_EXTERN(test_frames);
+SUITE_EXTERN(test_trace);
+SUITE_EXTERN(test_bus);
+SUITE_EXTERN(test_anim);
+SUITE_EXTERN(test_stats);
+SUITE_EXTERN(test_emu);
+SUITE_EXTERN(test_fleet);
+SUITE_EXTERN(test_convert);
+SUITE_EXTERN(test_power);
+
+#ifdef PCA9685_HAVE_LINUX_I2C
+SUITE_EXTERN(test_linux_i2c);
+#endif
+
+#ifdef PCA9685_HAVE_WORKER
+SUITE_EXTERN(test_worker);
+#endif
+
+#if PCA9685_RECORDER
+SUITE_EXTERN(test_record);
+#endif
+
+#ifdef PCA9685_HAVE_CXX
+SUITE_EXTERN(test_wrapper);
+#endif
 
 #endif
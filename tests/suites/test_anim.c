@@ -0,0 +1,188 @@
+#include "tests.h"
+#include "pca9685_anim.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+#define MS 1000000u
+
+static pca9685_s mock_block_driver;
+static pca9685_track_s tracks[8];
+static pca9685_anim_s anim;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    set_up_mock_driver_with_block_writer(&mock_block_driver);
+    reset_mock_bus();
+    memset(tracks, 0, sizeof(tracks));
+    anim = (pca9685_anim_s){ .tracks = tracks, .capacity = 8 };
+}
+
+static int channel_off_steps(int channel) {
+    u8 const base = channel_to_register_base((u8)channel);
+
+    return mock_bus.registers[base + 2] | (mock_bus.registers[base + 3] & 0x1F) << 8;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_easing_curves_to_run_from_zero_to_one(void) {
+    for(int e = PCA9685_EASE_LINEAR; e <= PCA9685_EASE_EXPONENTIAL; e++) {
+        uint32_t previous = 0;
+
+        ASSERT_EQ(pca9685_ease((pca9685_easing)e, 0), 0);
+        ASSERT_EQ(pca9685_ease((pca9685_easing)e, 0x10000), 0x10000);
+
+        for(uint32_t t = 0; t <= 0x10000; t += 0x100) {
+            uint32_t const v = pca9685_ease((pca9685_easing)e, t);
+            ASSERT(v >= previous);
+            ASSERT(v <= 0x10000);
+            previous = v;
+        }
+    }
+
+    ASSERT_EQ(pca9685_ease(PCA9685_EASE_IN_OUT, 0x8000), 0x8000);
+    ASSERT(pca9685_ease(PCA9685_EASE_IN, 0x8000) < 0x8000);
+    ASSERT(pca9685_ease(PCA9685_EASE_OUT, 0x8000) > 0x8000);
+    ASSERT(pca9685_ease(PCA9685_EASE_EXPONENTIAL, 0x8000) < 0x800);
+
+    PASS();
+}
+
+TEST expect_fades_to_reach_their_target_and_stop(void) {
+    ASSERT(pca9685_anim_fade(&anim, &mock_block_driver, 3, 0, 0x10000, 100, PCA9685_EASE_LINEAR, 0));
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 0), 1);
+    ASSERT_EQ(channel_off_steps(3), LED_FULL_STEPS);
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 50 * MS), 1);
+    ASSERT_EQ(channel_off_steps(3), 2048);
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 100 * MS), 0);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(3) + 1], LED_FULL_BIT);
+
+    PASS();
+}
+
+TEST expect_ticks_to_send_only_changed_channels(void) {
+    static const pca9685_keyframe_s hold[] = { { 0, 0x4000, PCA9685_EASE_LINEAR }, { 1000, 0x4000, PCA9685_EASE_LINEAR } };
+
+    pca9685_anim_fade(&anim, &mock_block_driver, 2, 0, 0x10000, 1000, PCA9685_EASE_IN, 0);
+    pca9685_anim_play(&anim, &mock_block_driver, 5, hold, 2, 0);
+    pca9685_anim_fade(&anim, &mock_block_driver, 11, 0x10000, 0, 1000, PCA9685_EASE_OUT, 0);
+    pca9685_anim_tick(&anim, 0);
+
+    // Channel 5 holds still, so it drops out; 2 and 11 are too far apart to merge
+    int const transactions = mock_bus.writes + mock_bus.block_writes;
+    pca9685_anim_tick(&anim, 500 * MS);
+
+    ASSERT_EQ(mock_bus.writes + mock_bus.block_writes, transactions + 2);
+    ASSERT_EQ(channel_off_steps(5), 1024);
+
+    PASS();
+}
+
+TEST expect_tick_rate_to_be_capped_by_the_bus(void) {
+    anim.tick_hz = 1000;
+    anim.bus_hz = 100000;
+
+    for(int c = 0; c < CHANNELS; c++) pca9685_anim_fade(&anim, &mock_block_driver, c % 8 * 2, 0, 0x10000, 1000, PCA9685_EASE_LINEAR, 0);
+    pca9685_anim_tick(&anim, 0);
+
+    // Eight channels at 54 bits each take 4.32ms at 100kHz, longer than the 1ms tick requested
+    ASSERT(pca9685_anim_next_tick(&anim) >= 4320000u);
+
+    int const block_writes = mock_bus.block_writes;
+    pca9685_anim_tick(&anim, 2 * MS);
+    ASSERT_EQ(mock_bus.block_writes, block_writes);
+
+    pca9685_anim_tick(&anim, pca9685_anim_next_tick(&anim));
+    ASSERT(mock_bus.block_writes > block_writes);
+
+    PASS();
+}
+
+TEST expect_keyframes_to_loop(void) {
+    static const pca9685_keyframe_s saw[] = { { 0, 0, PCA9685_EASE_LINEAR }, { 100, 0x10000, PCA9685_EASE_LINEAR } };
+
+    pca9685_track_s *t = pca9685_anim_play(&anim, &mock_block_driver, 7, saw, 2, 0);
+    t->loop = 1;
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 325 * MS), 1);
+    ASSERT_EQ(channel_off_steps(7), 1024);
+
+    pca9685_anim_stop(&anim, &mock_block_driver, 7);
+    ASSERT_EQ(pca9685_anim_tick(&anim, 400 * MS), 0);
+
+    PASS();
+}
+
+TEST expect_level_to_hold_until_the_first_keyframe(void) {
+    static const pca9685_keyframe_s late[] = { { 100, 0x8000, PCA9685_EASE_LINEAR }, { 200, 0x10000, PCA9685_EASE_LINEAR } };
+
+    pca9685_anim_play(&anim, &mock_block_driver, 7, late, 2, 0);
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 50 * MS), 1);
+    ASSERT_EQ(channel_off_steps(7), 2048);
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, 150 * MS), 1);
+    ASSERT_EQ(channel_off_steps(7), 3072);
+
+    PASS();
+}
+
+TEST expect_unsorted_keyframes_to_be_rejected(void) {
+    static const pca9685_keyframe_s unsorted[] = { { 0, 0, PCA9685_EASE_LINEAR }, { 500, 0x10000, PCA9685_EASE_LINEAR }, { 200, 0, PCA9685_EASE_LINEAR } };
+    static const pca9685_keyframe_s step[] = { { 0, 0, PCA9685_EASE_LINEAR }, { 100, 0, PCA9685_EASE_LINEAR }, { 100, 0x10000, PCA9685_EASE_LINEAR } };
+
+    pca9685_track_s *t = pca9685_anim_fade(&anim, &mock_block_driver, 7, 0, 0x10000, 1000, PCA9685_EASE_LINEAR, 0);
+
+    // The running track is left alone
+    ASSERT_EQ(pca9685_anim_play(&anim, &mock_block_driver, 7, unsorted, 3, 0), NULL);
+    ASSERT_EQ(t->keyframes, t->fade);
+
+    // Equal times are a jump
+    ASSERT_EQ(pca9685_anim_play(&anim, &mock_block_driver, 7, step, 3, 0), t);
+    ASSERT_EQ(pca9685_anim_tick(&anim, 150 * MS), 0);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(7) + 1], LED_FULL_BIT);
+
+    PASS();
+}
+
+TEST expect_long_segments_to_interpolate(void) {
+    uint32_t const hour_ms = 3600u * 1000u;
+
+    // 100 hours; at 90 hours the ns elapsed shifted by 16 no longer fits in 64 bits
+    pca9685_anim_fade(&anim, &mock_block_driver, 7, 0, 0x10000, 100 * hour_ms, PCA9685_EASE_LINEAR, 0);
+
+    ASSERT_EQ(pca9685_anim_tick(&anim, (uint64_t)90 * hour_ms * MS), 1);
+    ASSERT_IN_RANGE(3686, channel_off_steps(7), 1);
+
+    PASS();
+}
+
+TEST expect_tracks_to_be_reused_per_channel(void) {
+    for(int c = 0; c < 8; c++) ASSERT(pca9685_anim_fade(&anim, &mock_block_driver, c, 0, 1, 10, PCA9685_EASE_LINEAR, 0));
+
+    ASSERT_EQ(pca9685_anim_fade(&anim, &mock_block_driver, 8, 0, 1, 10, PCA9685_EASE_LINEAR, 0), NULL);
+    ASSERT_EQ(pca9685_anim_fade(&anim, &mock_block_driver, 3, 0, 1, 10, PCA9685_EASE_LINEAR, 0), &tracks[3]);
+    ASSERT_EQ(pca9685_anim_fade(&anim, &mock_block_driver, CHANNELS, 0, 1, 10, PCA9685_EASE_LINEAR, 0), NULL);
+
+    PASS();
+}
+
+SUITE(test_anim) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_easing_curves_to_run_from_zero_to_one);
+    RUN_TEST(expect_fades_to_reach_their_target_and_stop);
+    RUN_TEST(expect_ticks_to_send_only_changed_channels);
+    RUN_TEST(expect_tick_rate_to_be_capped_by_the_bus);
+    RUN_TEST(expect_keyframes_to_loop);
+    RUN_TEST(expect_level_to_hold_until_the_first_keyframe);
+    RUN_TEST(expect_unsorted_keyframes_to_be_rejected);
+    RUN_TEST(expect_long_segments_to_interpolate);
+    RUN_TEST(expect_tracks_to_be_reused_per_channel);
+}
@@ -0,0 +1,316 @@
+#include "tests.h"
+#include "pca9685_bus.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+#define FIRST_SLAVE 0x40
+
+// Register images for every address the bus can reach, plus transfer counts
+static struct {
+    u8 registers[128][256];
+    int reads;
+    int transfers;
+    int writes;
+} wire;
+
+static pca9685_bus_s bus;
+
+static u8 wire_reader(pca9685_bus_s *b, u8 slave, u8 address) {
+    (void)b;
+    wire.reads++;
+
+    return wire.registers[slave & 0x7F][address];
+}
+
+// A chip answers its own address, and a group address when the group's MODE1 bit is set
+static int wire_answers(int chip, u8 slave) {
+    static const u8 group_registers[] = { ALLCALLADR, SUBADR1, SUBADR2, SUBADR3 };
+    static const u8 group_bits[] = { ALLCALL, SUB1, SUB2, SUB3 };
+    const u8 *r = wire.registers[chip];
+
+    if(chip == slave) return 1;
+    for(int g = 0; g < 4; g++) {
+        if((r[MODE1] & group_bits[g]) && r[group_registers[g]] >> 1 == slave) return 1;
+    }
+
+    return 0;
+}
+
+static u8 wire_transfer(pca9685_bus_s *b, const pca9685_bus_write_s *writes, int count) {
+    (void)b;
+    wire.transfers++;
+
+    for(int i = 0; i < count; i++) {
+        const pca9685_i2c_write_s *w = &writes[i].write;
+        u8 const slave = writes[i].slave & 0x7F;
+        int answered[128];
+
+        for(int chip = 0; chip < 128; chip++) answered[chip] = wire_answers(chip, slave);
+        for(int chip = 0; chip < 128; chip++) {
+            if(!answered[chip]) continue;
+            for(int j = 0; j < w->length; j++) wire.registers[chip][(u8)(w->address + j)] = w->data[j];
+        }
+        wire.writes++;
+    }
+
+    return 0;
+}
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(&wire, 0, sizeof(wire));
+    memset(&bus, 0, sizeof(bus));
+    bus.reader = wire_reader;
+    bus.transfer = wire_transfer;
+}
+
+static void add_devices(int n) {
+    for(int i = 0; i < n; i++) pca9685_bus_add(&bus, (u8)(FIRST_SLAVE + i));
+    wire.transfers = 0;
+    wire.writes = 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_devices_to_keep_their_addresses(void) {
+    pca9685_s *a = pca9685_bus_add(&bus, 0x40);
+    pca9685_s *b = pca9685_bus_add(&bus, 0x55);
+
+    ASSERT_EQ(bus.count, 2);
+    ASSERT_EQ(a->slave_address, 0x40);
+    ASSERT_EQ(b->slave_address, 0x55);
+    ASSERT_EQ(pca9685_bus_device(&bus, 0x55), b);
+    ASSERT_EQ(pca9685_bus_device(&bus, 0x56), NULL);
+    ASSERT_STR_EQ(a->status, "ok");
+
+    PASS();
+}
+
+TEST expect_duplicate_and_excess_devices_to_be_refused(void) {
+    ASSERT(pca9685_bus_add(&bus, 0x40));
+    ASSERT_EQ(pca9685_bus_add(&bus, 0x40), NULL);
+
+    for(int i = 1; i < PCA9685_BUS_MAX_DEVICES; i++) ASSERT(pca9685_bus_add(&bus, (u8)(0x40 + i)));
+    ASSERT_EQ(pca9685_bus_add(&bus, 0x10), NULL);
+
+    PASS();
+}
+
+TEST expect_unicast_writes_to_reach_only_their_device(void) {
+    add_devices(2);
+
+    pca9685_s *second = pca9685_bus_device(&bus, FIRST_SLAVE + 1);
+    second->ops->set_steps(second, 0, 0x123, 0x456);
+
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][LED0_ON_L], 0x23);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE][LED0_ON_L], 0x00);
+
+    PASS();
+}
+
+TEST expect_commit_all_to_send_every_device_in_one_transfer(void) {
+    add_devices(40);
+
+    // Auto-increment is switched on once per device, ahead of the first multi-byte write
+    for(int i = 0; i < bus.count; i++) ensure_auto_increment(&bus.devices[i]);
+    wire.transfers = 0;
+
+    pca9685_bus_begin_all(&bus);
+    for(int i = 0; i < bus.count; i++) {
+        pca9685_s *h = &bus.devices[i];
+        h->ops->set_steps(h, i % CHANNELS, i, 0x800 + i);
+        h->ops->set_steps(h, (i + 5) % CHANNELS, 0, 0x100);
+    }
+    pca9685_bus_commit_all(&bus);
+
+    ASSERT_EQ(wire.transfers, 1);
+
+    for(int i = 0; i < bus.count; i++) {
+        u8 base = channel_to_register_base((u8)(i % CHANNELS));
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][base], i);
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][base + 2], (u8)(0x800 + i));
+        ASSERT_FALSE(bus.devices[i].frame_open);
+    }
+
+    PASS();
+}
+
+TEST expect_commit_all_to_update_each_devices_shadow(void) {
+    add_devices(3);
+
+    pca9685_bus_begin_all(&bus);
+    for(int i = 0; i < bus.count; i++) bus.devices[i].ops->set_steps(&bus.devices[i], 2, 1, 2);
+    pca9685_bus_commit_all(&bus);
+
+    int const transfers = wire.transfers;
+
+    pca9685_bus_begin_all(&bus);
+    for(int i = 0; i < bus.count; i++) bus.devices[i].ops->set_steps(&bus.devices[i], 2, 1, 2);
+    pca9685_bus_commit_all(&bus);
+
+    ASSERT_EQ(wire.transfers, transfers);
+
+    PASS();
+}
+
+TEST expect_idle_devices_to_be_skipped(void) {
+    add_devices(4);
+
+    pca9685_s *third = &bus.devices[2];
+    begin_led_frame(third);
+    third->ops->set_steps(third, 7, 0, 1);
+    pca9685_bus_commit_all(&bus);
+
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 2][channel_to_register_base(7) + 2], 1);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 3][channel_to_register_base(7) + 2], 0);
+
+    PASS();
+}
+
+TEST expect_joining_to_program_the_group_address(void) {
+    add_devices(2);
+
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR2);
+
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][SUBADR2], SUBADR2_DEFAULTS);
+    ASSERT(wire.registers[FIRST_SLAVE + 1][MODE1] & SUB2);
+    ASSERT_FALSE(wire.registers[FIRST_SLAVE][MODE1] & SUB2);
+
+    pca9685_bus_set_group_address(&bus, PCA9685_SUBADR2, 0x60);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][SUBADR2], 0x60 << 1);
+
+    pca9685_bus_leave(&bus, &bus.devices[1], PCA9685_SUBADR2);
+    ASSERT_FALSE(wire.registers[FIRST_SLAVE + 1][MODE1] & SUB2);
+
+    PASS();
+}
+
+TEST expect_group_writes_to_reach_members_in_one_transfer(void) {
+    add_devices(3);
+
+    pca9685_bus_join(&bus, &bus.devices[0], PCA9685_SUBADR1);
+    pca9685_bus_join(&bus, &bus.devices[2], PCA9685_SUBADR1);
+    for(int i = 0; i < bus.count; i++) ensure_auto_increment(&bus.devices[i]);
+    wire.transfers = 0;
+
+    pca9685_s *group = pca9685_bus_group(&bus, PCA9685_SUBADR1);
+    group->ops->set_steps(group, 4, 0x10, 0x210);
+
+    ASSERT_EQ(wire.transfers, 1);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE][channel_to_register_base(4) + 2], 0x10);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 2][channel_to_register_base(4) + 2], 0x10);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][channel_to_register_base(4) + 2], 0x00);
+
+    // Members' shadows saw the broadcast, so the same unicast write is elided
+    bus.devices[2].ops->set_steps(&bus.devices[2], 4, 0x10, 0x210);
+    ASSERT_EQ(wire.transfers, 1);
+
+    PASS();
+}
+
+TEST expect_group_elision_to_need_every_member(void) {
+    add_devices(2);
+
+    pca9685_bus_join(&bus, &bus.devices[0], PCA9685_SUBADR3);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR3);
+    for(int i = 0; i < bus.count; i++) ensure_auto_increment(&bus.devices[i]);
+
+    // Only one member already holds the value, so the broadcast still goes out
+    bus.devices[0].ops->set_steps(&bus.devices[0], 1, 0, 0x300);
+    wire.transfers = 0;
+
+    pca9685_s *group = pca9685_bus_group(&bus, PCA9685_SUBADR3);
+    group->ops->set_steps(group, 1, 0, 0x300);
+    ASSERT_EQ(wire.transfers, 1);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][channel_to_register_base(1) + 2], 0x00);
+
+    group = pca9685_bus_group(&bus, PCA9685_SUBADR3);
+    group->ops->set_steps(group, 1, 0, 0x300);
+    ASSERT_EQ(wire.transfers, 1);
+
+    PASS();
+}
+
+TEST expect_group_mode1_writes_to_keep_member_flags(void) {
+    add_devices(2);
+
+    pca9685_bus_join(&bus, &bus.devices[0], PCA9685_SUBADR1);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR1);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR2);
+
+    pca9685_s *group = pca9685_bus_group(&bus, PCA9685_SUBADR1);
+    group->ops->set_frequency(group, 200);
+
+    ASSERT_EQ(wire.registers[FIRST_SLAVE][PRE_SCALE], wire.registers[FIRST_SLAVE + 1][PRE_SCALE]);
+    ASSERT(wire.registers[FIRST_SLAVE][MODE1] & SUB1);
+    ASSERT_FALSE(wire.registers[FIRST_SLAVE][MODE1] & SUB2);
+    ASSERT(wire.registers[FIRST_SLAVE + 1][MODE1] & SUB2);
+    ASSERT_FALSE(wire.registers[FIRST_SLAVE + 1][MODE1] & SLEEP);
+
+    PASS();
+}
+
+TEST expect_group_writes_to_leave_members_mode1_as_it_was(void) {
+    add_devices(2);
+
+    pca9685_bus_join(&bus, &bus.devices[0], PCA9685_SUBADR1);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR1);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_SUBADR2);
+    pca9685_i2c_bus_write(&bus.devices[0], MODE1, SLEEP | SUB1);
+
+    pca9685_s *group = pca9685_bus_group(&bus, PCA9685_SUBADR1);
+    group->ops->set_steps(group, 4, 0x10, 0x210);
+
+    // Each member got AI on top of its own MODE1; the sleeping one didn't put the other to sleep
+    ASSERT_EQ(wire.registers[FIRST_SLAVE][MODE1], SLEEP | SUB1 | AI);
+    ASSERT_EQ(wire.registers[FIRST_SLAVE + 1][MODE1], SUB1 | SUB2 | AI);
+    ASSERT_FALSE(pca9685_shadow_known(group, MODE1));
+
+    for(int i = 0; i < bus.count; i++) {
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][channel_to_register_base(4) + 2], 0x10);
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][channel_to_register_base(4) + 3], 0x02);
+    }
+
+    PASS();
+}
+
+TEST expect_blackout_to_switch_off_all_call_members(void) {
+    add_devices(2);
+
+    for(int i = 0; i < bus.count; i++) bus.devices[i].ops->set_steps(&bus.devices[i], 9, 0, 0x400);
+    pca9685_bus_join(&bus, &bus.devices[0], PCA9685_ALLCALL);
+    pca9685_bus_join(&bus, &bus.devices[1], PCA9685_ALLCALL);
+    for(int i = 0; i < bus.count; i++) ensure_auto_increment(&bus.devices[i]);
+    wire.transfers = 0;
+
+    pca9685_bus_blackout(&bus);
+    ASSERT_EQ(wire.transfers, 1);
+
+    for(int i = 0; i < bus.count; i++) {
+        const u8 *shadow = &bus.devices[i].shadow[channel_to_register_base(9)];
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][ALL_LED_ON_L + 2], shadow[2]);
+        ASSERT_EQ(wire.registers[FIRST_SLAVE + i][ALL_LED_ON_L + 3], shadow[3]);
+    }
+
+    PASS();
+}
+
+SUITE(test_bus) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_devices_to_keep_their_addresses);
+    RUN_TEST(expect_duplicate_and_excess_devices_to_be_refused);
+    RUN_TEST(expect_unicast_writes_to_reach_only_their_device);
+    RUN_TEST(expect_commit_all_to_send_every_device_in_one_transfer);
+    RUN_TEST(expect_commit_all_to_update_each_devices_shadow);
+    RUN_TEST(expect_idle_devices_to_be_skipped);
+    RUN_TEST(expect_joining_to_program_the_group_address);
+    RUN_TEST(expect_group_writes_to_reach_members_in_one_transfer);
+    RUN_TEST(expect_group_elision_to_need_every_member);
+    RUN_TEST(expect_group_mode1_writes_to_keep_member_flags);
+    RUN_TEST(expect_group_writes_to_leave_members_mode1_as_it_was);
+    RUN_TEST(expect_blackout_to_switch_off_all_call_members);
+}
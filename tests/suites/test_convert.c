@@ -0,0 +1,103 @@
+#include "tests.h"
+#include "pca9685_convert.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+// Every 16-bit level once: 4096 devices of 16 channels
+#define DEVICES 4096
+
+static uint16_t levels[DEVICES * CHANNELS];
+static pca9685_frame_s expected[DEVICES], actual[DEVICES];
+
+static const uint16_t phase[CHANNELS] = {
+    0, 256, 512, 768, 1024, 1280, 1536, 1792, 2048, 2304, 2560, 2816, 3072, 3328, 3584, 4095
+};
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    for(int n = 0; n < DEVICES * CHANNELS; n++) levels[n] = (uint16_t)n;
+}
+
+static void teardown_cb(void *data) {
+    (void)data;
+
+    pca9685_convert_select(PCA9685_SIMD_AUTO);
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_scalar_images_to_match_set_brightness(void) {
+    static const pca9685_curve curves[] = { PCA9685_CURVE_LINEAR, PCA9685_CURVE_GAMMA, PCA9685_CURVE_CIE };
+
+    ASSERT_EQ(pca9685_convert_select(PCA9685_SIMD_SCALAR), 0);
+
+    for(size_t k = 0; k < sizeof(curves) / sizeof(curves[0]); k++) {
+        pca9685_convert_frames(actual, levels, DEVICES, curves[k], NULL);
+
+        for(int n = 0; n < DEVICES * CHANNELS; n++) {
+            int on, off;
+            u8 led[MULTIPLIER];
+
+            steps_to_led(calculate_steps_from_curve(levels[n] + (levels[n] >> 15), curves[k]), &on, &off);
+            pca9685_encode_led(led, on, off);
+            ASSERT_MEM_EQ(led, &actual[n / CHANNELS].led[(n % CHANNELS) * MULTIPLIER], MULTIPLIER);
+        }
+    }
+
+    PASS();
+}
+
+TEST expect_phase_to_move_the_pulse(void) {
+    uint16_t half[CHANNELS];
+
+    for(int c = 0; c < CHANNELS; c++) half[c] = 0x8000;
+    pca9685_convert_frames(actual, half, 1, PCA9685_CURVE_LINEAR, phase);
+
+    // 2048 steps on from step 3072, wrapping past the end of the period
+    const u8 *led = &actual[0].led[12 * MULTIPLIER];
+    ASSERT_EQ(led[0] | led[1] << 8, 3072);
+    ASSERT_EQ(led[2] | led[3] << 8, 1024);
+
+    PASS();
+}
+
+TEST expect_every_kernel_to_match_the_scalar_one(void) {
+    static const pca9685_simd kernels[] = { PCA9685_SIMD_SSE2, PCA9685_SIMD_AVX2, PCA9685_SIMD_NEON };
+
+    for(pca9685_curve curve = PCA9685_CURVE_LINEAR; curve <= PCA9685_CURVE_CIE; curve++) {
+        pca9685_convert_select(PCA9685_SIMD_SCALAR);
+        pca9685_convert_frames(expected, levels, DEVICES, curve, phase);
+
+        for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if(pca9685_convert_select(kernels[k]) != 0) continue;
+
+            memset(actual, 0, sizeof(actual));
+            pca9685_convert_frames(actual, levels, DEVICES, curve, phase);
+            ASSERT_MEM_EQ(expected, actual, sizeof(expected));
+        }
+    }
+
+    PASS();
+}
+
+TEST expect_auto_to_pick_an_available_kernel(void) {
+    ASSERT_EQ(pca9685_convert_select(PCA9685_SIMD_AUTO), 0);
+    ASSERT(pca9685_convert_kernel() != PCA9685_SIMD_AUTO);
+    ASSERT_EQ(pca9685_convert_select((pca9685_simd)99), -1);
+    ASSERT_STR_EQ(pca9685_simd_name(PCA9685_SIMD_SCALAR), "scalar");
+
+    PASS();
+}
+
+SUITE(test_convert) {
+    SET_SETUP(setup_cb, NULL);
+    SET_TEARDOWN(teardown_cb, NULL);
+
+    RUN_TEST(expect_scalar_images_to_match_set_brightness);
+    RUN_TEST(expect_phase_to_move_the_pulse);
+    RUN_TEST(expect_every_kernel_to_match_the_scalar_one);
+    RUN_TEST(expect_auto_to_pick_an_available_kernel);
+}
@@ -28,17 +28,37 @@ TEST expect_callback_identities(void) {
 }
 
 TEST expect_public_functions_to_be_present(void) {
-    ASSERT(mock_driver.soft_reset &&
-        mock_driver.hard_reset &&
-        mock_driver.set_frequency &&
-        mock_driver.channel_on &&
-        mock_driver.channel_off &&
-        mock_driver.set_duty_cycle
+    ASSERT(mock_driver.ops->soft_reset &&
+        mock_driver.ops->hard_reset &&
+        mock_driver.ops->set_frequency &&
+        mock_driver.ops->channel_on &&
+        mock_driver.ops->channel_off &&
+        mock_driver.ops->set_duty_cycle &&
+        mock_driver.ops->set_steps &&
+        mock_driver.ops->set_brightness &&
+        mock_driver.ops->set_brightness_all &&
+        mock_driver.ops->invalidate &&
+        mock_driver.ops->resync &&
+        mock_driver.ops->begin_frame &&
+        mock_driver.ops->commit_frame &&
+        mock_driver.ops->write_frame &&
+        mock_driver.ops->check_idle
     );
 
     PASS();
 }
 
+TEST expect_handles_to_share_one_operations_table(void) {
+    ASSERT_EQ(mock_driver.ops, &pca9685_ops);
+#if PCA9685_HANDLE_OPS
+    ASSERT_EQ(mock_driver.set_steps, pca9685_ops.set_steps);
+    ASSERT_EQ(mock_driver.commit_frame, pca9685_ops.commit_frame);
+    ASSERT_EQ(mock_driver.reset_stats, pca9685_ops.reset_stats);
+#endif
+
+    PASS();
+}
+
 TEST expect_verifies_callbacks(void) {
     pca9685_s mock_d = pca9685();
     ASSERT_FALSE(mock_d.bus_reader && mock_d.bus_writer);
@@ -48,6 +68,17 @@ TEST expect_verifies_callbacks(void) {
     PASS();
 }
 
+TEST expect_latched_handles_to_need_a_multi_byte_callback(void) {
+    pca9685_s mock_d = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer, .latched=1);
+    ASSERT(mock_d.status != (char *)"ok");
+    ASSERT_STR_EQ(mock_d.command, "latch_check");
+
+    mock_d = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer, .bus_block_writer=mock_bus_block_writer, .latched=1);
+    ASSERT_STR_EQ(mock_d.status, "ok");
+
+    PASS();
+}
+
 TEST expect_command_to_be_i2c_write(void) {
     ASSERT_STR_EQ(mock_driver.command, "i2c_write");
 
@@ -67,7 +98,9 @@ SUITE(test_driver_init) {
     RUN_TEST(expect_callbacks_to_be_present);
     RUN_TEST(expect_callback_identities);
     RUN_TEST(expect_public_functions_to_be_present);
+    RUN_TEST(expect_handles_to_share_one_operations_table);
     RUN_TEST(expect_verifies_callbacks);
+    RUN_TEST(expect_latched_handles_to_need_a_multi_byte_callback);
     RUN_TEST(expect_command_to_be_i2c_write);
     RUN_TEST(expect_status_to_be_ok);
 }
@@ -0,0 +1,252 @@
+#include "tests.h"
+#include "pca9685_emu.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+static pca9685_emu_s boards[2];
+static pca9685_emu_bus_s emu_bus;
+static uint64_t emu_now;
+
+static uint64_t emu_clock(const pca9685_emu_s *emu) {
+    (void)emu;
+
+    return emu_now;
+}
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(boards, 0, sizeof(boards));
+    emu_now = 0;
+    for(int i = 0; i < 2; i++) {
+        boards[i].clock = emu_clock;
+        pca9685_emu_power_on(&boards[i], (u8)(0x40 + i));
+    }
+    emu_bus = (pca9685_emu_bus_s){ .devices = boards, .count = 2 };
+}
+
+// One transaction: register address, then data
+static void send(u8 slave, const u8 *bytes, int length) {
+    pca9685_emu_bus_write(&emu_bus, slave, bytes, length);
+}
+
+static void set_register(u8 slave, u8 r, u8 value) {
+    const u8 bytes[] = { r, value };
+
+    send(slave, bytes, 2);
+}
+
+static void set_channel(u8 slave, u8 channel, int on, int off) {
+    const u8 bytes[] = { channel_to_register_base(channel), (u8)on, (u8)(on >> 8), (u8)off, (u8)(off >> 8) };
+
+    set_register(slave, MODE1, AI);
+    send(slave, bytes, 5);
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_power_on_state_to_match_the_datasheet(void) {
+    pca9685_emu_wave_s wave;
+
+    ASSERT_EQ(boards[0].registers[MODE1], SLEEP | ALLCALL);
+    ASSERT_EQ(boards[0].registers[PRE_SCALE], 0x1E);
+    ASSERT_EQ(pca9685_emu_frequency(&boards[0]), 197);
+    ASSERT_FALSE(pca9685_emu_running(&boards[0]));
+
+    pca9685_emu_waveform(&boards[0], 0, &wave);
+    ASSERT(wave.constant);
+    ASSERT_EQ(wave.level, 0);
+
+    PASS();
+}
+
+TEST expect_auto_increment_to_walk_and_wrap(void) {
+    const u8 bytes[] = { LED0_ON_L, 1, 2, 3 };
+    u8 values[2];
+
+    send(0x40, bytes, 4);
+    ASSERT_EQ(boards[0].registers[LED0_ON_L], 3);
+    ASSERT_EQ(boards[0].registers[LED0_ON_L + 1], 0);
+
+    set_register(0x40, MODE1, SLEEP | AI);
+    send(0x40, bytes, 4);
+    ASSERT_EQ(boards[0].registers[LED0_ON_L + 2], 3);
+
+    // From LED15_OFF_H the pointer wraps to MODE1
+    pca9685_emu_bus_read(&emu_bus, 0x40, LED0_ON_L + LED_REGISTERS - 1, 2, values);
+    ASSERT_EQ(values[0], LED_FULL_BIT);
+    ASSERT_EQ(values[1], SLEEP | AI);
+
+    PASS();
+}
+
+TEST expect_prescale_to_take_only_in_sleep(void) {
+    set_register(0x40, MODE1, 0);
+    set_register(0x40, PRE_SCALE, 0x79);
+
+    ASSERT_EQ(boards[0].registers[PRE_SCALE], 0x1E);
+    ASSERT(boards[0].violations & PCA9685_EMU_PRESCALE_AWAKE);
+
+    set_register(0x40, MODE1, SLEEP);
+    set_register(0x40, PRE_SCALE, 0x79);
+    ASSERT_EQ(pca9685_emu_frequency(&boards[0]), 50);
+
+    PASS();
+}
+
+TEST expect_sleep_with_pwm_running_to_need_a_restart(void) {
+    set_register(0x40, MODE1, 0);
+    set_channel(0x40, 0, 0, 2048);
+    ASSERT(pca9685_emu_running(&boards[0]));
+
+    set_register(0x40, MODE1, SLEEP);
+    ASSERT(boards[0].registers[MODE1] & RESTART);
+
+    // Awake again, PWM stays off until RESTART is written with a 1, 500μs after waking
+    emu_now = 1000000;
+    set_register(0x40, MODE1, 0);
+    ASSERT_FALSE(pca9685_emu_running(&boards[0]));
+
+    set_register(0x40, MODE1, 0);
+    ASSERT_FALSE(pca9685_emu_running(&boards[0]));
+
+    emu_now += 100000;
+    set_register(0x40, MODE1, RESTART);
+    ASSERT(boards[0].violations & PCA9685_EMU_EARLY_RESTART);
+    ASSERT(pca9685_emu_running(&boards[0]));
+
+    PASS();
+}
+
+TEST expect_waveforms_to_carry_edge_times(void) {
+    pca9685_emu_wave_s wave;
+
+    set_register(0x40, PRE_SCALE, 0x79);
+    set_register(0x40, MODE1, 0);
+    set_channel(0x40, 1, 1024, 3072);
+    set_channel(0x40, 2, 3072, 1024);
+
+    pca9685_emu_waveform(&boards[0], 1, &wave);
+    ASSERT_FALSE(wave.constant);
+    ASSERT_EQ(wave.period_ns, 19988480);
+    ASSERT_EQ(wave.rise_ns, wave.period_ns / 4);
+    ASSERT_EQ(wave.fall_ns, wave.period_ns / 4 * 3);
+
+    // On after off: high from the rising edge, through the end of the period, to the falling edge
+    pca9685_emu_waveform(&boards[0], 2, &wave);
+    ASSERT(wave.rise_ns > wave.fall_ns);
+
+    set_register(0x40, MODE2, OUTDRV | INVRT);
+    pca9685_emu_waveform(&boards[0], 1, &wave);
+    ASSERT_EQ(wave.rise_ns, wave.period_ns / 4 * 3);
+
+    // Full on, and full off winning over it
+    set_channel(0x40, 3, LED_FULL_STEPS, 0);
+    pca9685_emu_waveform(&boards[0], 3, &wave);
+    ASSERT(wave.constant);
+    ASSERT_EQ(wave.level, 0);
+
+    set_register(0x40, MODE2, OUTDRV);
+    pca9685_emu_waveform(&boards[0], 3, &wave);
+    ASSERT_EQ(wave.level, 1);
+
+    set_channel(0x40, 3, LED_FULL_STEPS, LED_FULL_STEPS);
+    pca9685_emu_waveform(&boards[0], 3, &wave);
+    ASSERT_EQ(wave.level, 0);
+
+    PASS();
+}
+
+TEST expect_outputs_to_latch_on_stop_or_on_the_fourth_ack(void) {
+    const u8 first[] = { LED0_ON_L, 0, 0, 0 }, last[] = { LED0_ON_L + 3, 0x08 };
+
+    set_register(0x40, MODE1, AI);
+
+    // OCH=0: nothing changes until the STOP
+    pca9685_emu_write(&boards[0], first, 4);
+    pca9685_emu_write(&boards[0], last, 2);
+    ASSERT_EQ(boards[0].off[0], LED_FULL_STEPS);
+    pca9685_emu_stop(&boards[0]);
+    ASSERT_EQ(boards[0].off[0], 0x800);
+
+    // OCH=1: a channel changes on the ACK of the last of its four registers, STOP or not
+    set_register(0x40, MODE2, OUTDRV | OCH);
+    const u8 three[] = { LED0_ON_L + 4, 0, 0, 0 }, fourth[] = { LED0_ON_L + 7, 0x04 };
+    send(0x40, three, 4);
+    ASSERT_EQ(boards[0].off[1], LED_FULL_STEPS);
+    pca9685_emu_write(&boards[0], fourth, 2);
+    ASSERT_EQ(boards[0].off[1], 0x400);
+
+    PASS();
+}
+
+TEST expect_all_led_and_group_addresses_to_reach_every_listener(void) {
+    const u8 all_on[] = { ALL_LED_ON_L, 0, LED_FULL_BIT, 0, 0 };
+    u8 value;
+
+    set_register(0x40, MODE1, AI | ALLCALL | SUB1);
+    set_register(0x41, MODE1, AI | ALLCALL);
+
+    // The All Call address reaches both; SUBADR1 only the board listening to it
+    send(ALLCALLADR_DEFAULTS >> 1, all_on, 5);
+    ASSERT_EQ(boards[1].on[15], LED_FULL_STEPS);
+
+    set_register(SUBADR1_DEFAULTS >> 1, LED0_ON_L + 3, LED_FULL_BIT);
+    ASSERT_EQ(boards[0].off[0], LED_FULL_STEPS);
+    ASSERT_EQ(boards[1].off[0], 0);
+
+    pca9685_emu_bus_read(&emu_bus, 0x40, ALL_LED_ON_L + 1, 1, &value);
+    ASSERT_EQ(value, 0);
+
+    // General call software reset
+    const u8 swrst = 0x06;
+    send(0x00, &swrst, 1);
+    ASSERT_EQ(boards[1].registers[MODE1], SLEEP | ALLCALL);
+
+    PASS();
+}
+
+TEST expect_the_driver_to_produce_the_requested_timing(void) {
+    pca9685_emu_wave_s wave;
+
+    boards[0].clock = NULL;
+    pca9685_s driver = pca9685(PCA9685_EMU(&emu_bus, 0x40));
+    ASSERT_STR_EQ(driver.status, "ok");
+
+    driver.ops->set_frequency(&driver, 100);
+    driver.ops->set_steps(&driver, 3, 0, 1024);
+    driver.ops->channel_on(&driver, 4);
+    driver.ops->set_brightness(&driver, 5, 0);
+
+    ASSERT_EQ(pca9685_emu_frequency(&boards[0]), 100);
+
+    pca9685_emu_waveform(&boards[0], 3, &wave);
+    ASSERT_EQ(wave.rise_ns, 0);
+    ASSERT_EQ(wave.fall_ns, wave.period_ns / 4);
+
+    pca9685_emu_waveform(&boards[0], 4, &wave);
+    ASSERT(wave.constant && wave.level);
+
+    pca9685_emu_waveform(&boards[0], 5, &wave);
+    ASSERT(wave.constant && !wave.level);
+
+    driver.ops->soft_reset(&driver);
+    ASSERT_EQ(boards[0].violations, 0);
+
+    PASS();
+}
+
+SUITE(test_emu) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_power_on_state_to_match_the_datasheet);
+    RUN_TEST(expect_auto_increment_to_walk_and_wrap);
+    RUN_TEST(expect_prescale_to_take_only_in_sleep);
+    RUN_TEST(expect_sleep_with_pwm_running_to_need_a_restart);
+    RUN_TEST(expect_waveforms_to_carry_edge_times);
+    RUN_TEST(expect_outputs_to_latch_on_stop_or_on_the_fourth_ack);
+    RUN_TEST(expect_all_led_and_group_addresses_to_reach_every_listener);
+    RUN_TEST(expect_the_driver_to_produce_the_requested_timing);
+}
@@ -0,0 +1,197 @@
+#include "tests.h"
+#include "pca9685_emu.h"
+#include "pca9685_fleet.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+// Two emulated buses of 48 boards each (0x40–0x6F; 0x70 is the All Call address)
+#define PER_BUS 48
+#define DEVICES (2 * PER_BUS)
+
+static pca9685_emu_s boards[2][PER_BUS];
+static pca9685_emu_bus_s emu_buses[2];
+static u8 arena[PCA9685_FLEET_ARENA_SIZE(DEVICES) + 1];
+static u8 slaves[DEVICES];
+static pca9685_fleet_s fleet;
+
+static int transfers, writes, bytes, fail;
+
+// Routes each write to its device's bus
+static u8 fleet_transfer(pca9685_fleet_s *f, const pca9685_fleet_write_s *w, int count) {
+    pca9685_emu_bus_s *buses = f->context;
+
+    transfers++;
+    if(fail) return ERR;
+
+    for(int i = 0; i < count; i++) {
+        const pca9685_bus_write_s write = { .slave = w[i].slave, .write = w[i].write };
+
+        writes++;
+        bytes += w[i].write.length;
+        if(pca9685_emu_bus_transfer(&buses[w[i].device / PER_BUS], &write, 1) != OK) return ERR;
+    }
+
+    return OK;
+}
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(boards, 0, sizeof(boards));
+    for(int b = 0; b < 2; b++) {
+        for(int i = 0; i < PER_BUS; i++) pca9685_emu_power_on(&boards[b][i], (u8)(0x40 + i));
+        emu_buses[b] = (pca9685_emu_bus_s){ .devices = boards[b], .count = PER_BUS };
+    }
+    for(int d = 0; d < DEVICES; d++) slaves[d] = (u8)(0x40 + d % PER_BUS);
+
+    transfers = writes = bytes = fail = 0;
+    fleet = (pca9685_fleet_s){ .transfer = fleet_transfer, .context = emu_buses };
+
+    // Off by one byte, so init has to align it
+    pca9685_fleet_init(&fleet, arena + 1, sizeof(arena) - 1, slaves, DEVICES);
+}
+
+static pca9685_emu_s *board(int device) {
+    return &boards[device / PER_BUS][device % PER_BUS];
+}
+
+static void reset_counts(void) {
+    transfers = writes = bytes = 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_arena_arrays_to_start_on_cache_lines(void) {
+    const void *arrays[] = { fleet.shadow, fleet.staged, fleet.known, fleet.pending, fleet.slave, fleet.dirty };
+
+    for(size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        ASSERT_EQ((uintptr_t)arrays[i] % PCA9685_FLEET_LINE, 0);
+        ASSERT((const u8 *)arrays[i] > arena && (const u8 *)arrays[i] < arena + sizeof(arena));
+    }
+
+    ASSERT((const u8 *)(fleet.dirty + (DEVICES + 63) / 64) <= arena + sizeof(arena));
+    ASSERT_EQ(fleet.slave[PER_BUS + 1], 0x41);
+    ASSERT_EQ(pca9685_fleet_arena_size(DEVICES), PCA9685_FLEET_ARENA_SIZE(DEVICES));
+    ASSERT_EQ(pca9685_fleet_init(&fleet, arena, PCA9685_FLEET_ARENA_SIZE(DEVICES) - 1, slaves, DEVICES), -1);
+
+    PASS();
+}
+
+TEST expect_commit_to_reach_every_device(void) {
+    pca9685_emu_wave_s wave;
+
+    ASSERT_EQ(pca9685_fleet_start(&fleet), OK);
+    ASSERT_EQ(pca9685_fleet_set_frequency(&fleet, 1000), OK);
+    for(int d = 0; d < DEVICES; d++) pca9685_fleet_set_steps(&fleet, d, d % CHANNELS, 0, 2048);
+    ASSERT_EQ(pca9685_fleet_commit(&fleet), OK);
+
+    for(int d = 0; d < DEVICES; d++) {
+        ASSERT(pca9685_emu_running(board(d)));
+        ASSERT_EQ(board(d)->violations, 0);
+        ASSERT_EQ(pca9685_emu_frequency(board(d)), 1017);
+
+        pca9685_emu_waveform(board(d), d % CHANNELS, &wave);
+        ASSERT_FALSE(wave.constant);
+        ASSERT_EQ(wave.fall_ns - wave.rise_ns, wave.period_ns / 2);
+    }
+
+    PASS();
+}
+
+TEST expect_nonblocking_frequency_to_restart_with_the_next_commit(void) {
+    fleet.nonblocking = 1;
+
+    ASSERT_EQ(pca9685_fleet_start(&fleet), OK);
+    ASSERT_EQ(pca9685_fleet_set_frequency(&fleet, 1000), OK);
+    ASSERT(fleet.settle_deadline != 0);
+
+    pca9685_fleet_set_steps(&fleet, 3, 0, 0, 2048);
+    ASSERT_EQ(pca9685_fleet_commit(&fleet), OK);
+
+    // The restart waited for the oscillator, however soon the commit came
+    ASSERT(pca9685_fleet_is_ready(&fleet));
+    ASSERT_EQ(fleet.settle_deadline, 0);
+    for(int d = 0; d < DEVICES; d++) {
+        ASSERT(pca9685_emu_running(board(d)));
+        ASSERT_EQ(board(d)->violations, 0);
+    }
+
+    PASS();
+}
+
+TEST expect_commit_to_send_only_changed_bytes(void) {
+    pca9685_fleet_start(&fleet);
+    for(int d = 0; d < DEVICES; d++) pca9685_fleet_set_brightness(&fleet, d, ALL, 0x8000);
+    pca9685_fleet_commit(&fleet);
+
+    // Unchanged values send nothing at all
+    reset_counts();
+    for(int d = 0; d < DEVICES; d++) pca9685_fleet_set_brightness(&fleet, d, ALL, 0x8000);
+    ASSERT_EQ(pca9685_fleet_commit(&fleet), OK);
+    ASSERT_EQ(transfers, 0);
+
+    // Full off only needs OFF_H, on the one device that changed
+    pca9685_fleet_set_brightness(&fleet, 70, 9, 0);
+    pca9685_fleet_commit(&fleet);
+    ASSERT_EQ(writes, 1);
+    ASSERT_EQ(bytes, 1);
+    ASSERT(board(70)->off[9] & LED_FULL_STEPS);
+
+    PASS();
+}
+
+TEST expect_nearby_runs_to_merge(void) {
+    pca9685_fleet_start(&fleet);
+    pca9685_fleet_set_steps(&fleet, 5, ALL, 0, 100);
+    pca9685_fleet_commit(&fleet);
+
+    // OFF of channel 2 and ON of channel 3 are one clean register apart
+    reset_counts();
+    pca9685_fleet_set_steps(&fleet, 5, 2, 0, 200);
+    pca9685_fleet_set_steps(&fleet, 5, 3, 1, 100);
+    pca9685_fleet_commit(&fleet);
+    ASSERT_EQ(writes, 1);
+    ASSERT_EQ(bytes, 3);
+
+    reset_counts();
+    pca9685_fleet_set_steps(&fleet, 5, 2, 0, 300);
+    pca9685_fleet_set_steps(&fleet, 5, 6, 0, 300);
+    pca9685_fleet_commit(&fleet);
+    ASSERT_EQ(writes, 2);
+    ASSERT_EQ(board(5)->off[6], 300);
+
+    PASS();
+}
+
+TEST expect_failed_transfers_to_forget_the_shadow(void) {
+    pca9685_fleet_start(&fleet);
+    pca9685_fleet_set_steps(&fleet, 40, 0, 0, 100);
+    pca9685_fleet_commit(&fleet);
+
+    fail = 1;
+    pca9685_fleet_set_steps(&fleet, 40, 0, 0, 200);
+    ASSERT_EQ(pca9685_fleet_commit(&fleet), ERR);
+
+    // The same value again goes out in full, since the device may hold anything
+    fail = 0;
+    reset_counts();
+    pca9685_fleet_set_steps(&fleet, 40, 0, 0, 200);
+    ASSERT_EQ(pca9685_fleet_commit(&fleet), OK);
+    ASSERT_EQ(bytes, MULTIPLIER);
+    ASSERT_EQ(board(40)->off[0], 200);
+
+    PASS();
+}
+
+SUITE(test_fleet) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_arena_arrays_to_start_on_cache_lines);
+    RUN_TEST(expect_commit_to_reach_every_device);
+    RUN_TEST(expect_nonblocking_frequency_to_restart_with_the_next_commit);
+    RUN_TEST(expect_commit_to_send_only_changed_bytes);
+    RUN_TEST(expect_nearby_runs_to_merge);
+    RUN_TEST(expect_failed_transfers_to_forget_the_shadow);
+}
@@ -0,0 +1,233 @@
+#include "tests.h"
+
+/* Test setup begin */
+
+static pca9685_s mock_driver, mock_block_driver, latched_driver;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    set_up_mock_driver(&mock_driver);
+    set_up_mock_driver_with_block_writer(&mock_block_driver);
+    latched_driver = pca9685(.bus_reader=mock_bus_register_reader, .bus_writer=mock_bus_writer,
+        .bus_block_writer=mock_bus_block_writer, .latched=1);
+    reset_mock_bus();
+}
+
+// Block writer that remembers where its data came from
+static const u8 *block_write_data;
+
+static u8 recording_block_writer(pca9685_s *h, u8 address, u8 length, const u8 *data) {
+    block_write_data = data;
+
+    return mock_bus_block_writer(h, address, length, data);
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_staged_updates_to_stay_off_the_bus(void) {
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    mock_block_driver.ops->set_duty_cycle(&mock_block_driver, 1, 0, 50);
+    mock_block_driver.ops->channel_on(&mock_block_driver, 2);
+    mock_block_driver.ops->channel_off(&mock_block_driver, ALL);
+
+    ASSERT_EQ(mock_bus.writes + mock_bus.block_writes, 0);
+    ASSERT_EQ(mock_block_driver.frame_staged, 0xFFFF);
+
+    PASS();
+}
+
+TEST expect_contiguous_channels_to_commit_as_one_transaction(void) {
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    for(int c = 4; c <= 9; c++) set_led_bytes(&mock_block_driver, c, c, 0x100 + c);
+    mock_block_driver.ops->commit_frame(&mock_block_driver);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(9) + 2], 9);
+    ASSERT_FALSE(mock_block_driver.frame_open);
+
+    PASS();
+}
+
+TEST expect_separate_runs_to_commit_as_separate_transactions(void) {
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    set_led_bytes(&mock_block_driver, 1, 1, 2);
+    set_led_bytes(&mock_block_driver, 12, 1, 2);
+    mock_block_driver.ops->commit_frame(&mock_block_driver);
+
+    ASSERT_EQ(mock_bus.block_writes, 2);
+
+    PASS();
+}
+
+TEST expect_short_clean_runs_to_be_merged(void) {
+    set_led_bytes(&mock_block_driver, 0, 0, 0);
+    set_led_bytes(&mock_block_driver, 1, 0, 0);
+    int const block_writes = mock_bus.block_writes;
+
+    // Channel 0's OFF_H and channel 1's ON_L are unchanged, between two changed bytes
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    set_led_bytes(&mock_block_driver, 0, 0, 0x0A);
+    set_led_bytes(&mock_block_driver, 1, 0x100, 0);
+    mock_block_driver.ops->commit_frame(&mock_block_driver);
+
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 1);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(0) + 2], 0x0A);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(1) + 1], 0x01);
+
+    PASS();
+}
+
+TEST expect_last_write_to_a_channel_to_win(void) {
+    mock_driver.ops->begin_frame(&mock_driver);
+    set_led_bytes(&mock_driver, 3, 1, 0x111);
+    set_led_bytes(&mock_driver, 3, 2, 0x222);
+    set_led_bytes(&mock_driver, 3, 3, 0x333);
+    mock_driver.ops->commit_frame(&mock_driver);
+
+    ASSERT_EQ(mock_bus.writes, MULTIPLIER);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(3)], 3);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(3) + 3], 3);
+
+    PASS();
+}
+
+TEST expect_uniform_frames_to_use_all_led_registers(void) {
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    set_led_bytes(&mock_block_driver, ALL, 0, 0x7FF);
+    mock_block_driver.ops->commit_frame(&mock_block_driver);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    ASSERT_EQ(mock_block_driver.address, ALL_LED_ON_L);
+    ASSERT_EQ(mock_bus.registers[ALL_LED_ON_L + 3], 0x07);
+
+    PASS();
+}
+
+TEST expect_unchanged_frames_to_send_nothing(void) {
+    set_led_bytes(&mock_block_driver, 5, 1, 2);
+    int const block_writes = mock_bus.block_writes;
+
+    mock_block_driver.ops->begin_frame(&mock_block_driver);
+    set_led_bytes(&mock_block_driver, 5, 1, 2);
+    mock_block_driver.ops->commit_frame(&mock_block_driver);
+
+    ASSERT_EQ(mock_bus.block_writes, block_writes);
+
+    PASS();
+}
+
+TEST expect_dirty_ranges_to_cover_only_changed_bytes(void) {
+    frame_range_s ranges[FRAME_MAX_RANGES];
+
+    mock_driver.ops->begin_frame(&mock_driver);
+    set_led_bytes(&mock_driver, 0, 1, 2);
+    set_led_bytes(&mock_driver, 15, 1, 2);
+
+    ASSERT_EQ(frame_dirty_ranges(&mock_driver, ranges), 2);
+    ASSERT_EQ(ranges[0].address, LED0_ON_L);
+    ASSERT_EQ(ranges[0].length, MULTIPLIER);
+    ASSERT_EQ(ranges[1].address, channel_to_register_base(15));
+    ASSERT_EQ(ranges[1].length, MULTIPLIER);
+
+    PASS();
+}
+
+TEST expect_latched_frames_to_commit_as_one_transaction(void) {
+    u8 const between = channel_to_register_base(5);
+
+    mock_bus.registers[MODE2] = OCH | OUTDRV;
+    mock_bus.registers[between + 2] = 0x42;
+    int const block_writes = mock_bus.block_writes;
+
+    latched_driver.ops->begin_frame(&latched_driver);
+    set_led_bytes(&latched_driver, 1, 1, 2);
+    set_led_bytes(&latched_driver, 12, 1, 2);
+    latched_driver.ops->commit_frame(&latched_driver);
+
+    // Outputs change on STOP, and the channels in between are resent as the device held them
+    ASSERT_EQ(mock_bus.registers[MODE2], OUTDRV);
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 1);
+    ASSERT_EQ(latched_driver.address, channel_to_register_base(1));
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(12) + 2], 2);
+    ASSERT_EQ(mock_bus.registers[between + 2], 0x42);
+
+    PASS();
+}
+
+TEST expect_latched_frames_to_read_gaps_only_once(void) {
+    latched_driver.ops->begin_frame(&latched_driver);
+    set_led_bytes(&latched_driver, 0, 1, 2);
+    set_led_bytes(&latched_driver, 15, 1, 2);
+    latched_driver.ops->commit_frame(&latched_driver);
+
+    int const reads = mock_bus.reads;
+
+    latched_driver.ops->begin_frame(&latched_driver);
+    set_led_bytes(&latched_driver, 0, 3, 4);
+    set_led_bytes(&latched_driver, 15, 3, 4);
+    latched_driver.ops->commit_frame(&latched_driver);
+
+    ASSERT_EQ(mock_bus.reads, reads);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(15) + 2], 4);
+
+    PASS();
+}
+
+TEST expect_frame_images_to_match_the_register_map(void) {
+    pca9685_frame_s image = { { 0 } };
+
+    pca9685_frame_set_steps(&image, 10, 0x123, 0xABC);
+    pca9685_frame_set_full_off(&image, 11);
+    pca9685_frame_set_full_on(&image, 12);
+
+    u8 const base = (u8)(channel_to_register_base(10) - LED0_ON_L);
+    ASSERT_EQ(image.led[base], 0x23);
+    ASSERT_EQ(image.led[base + 1], 0x01);
+    ASSERT_EQ(image.led[base + 2], 0xBC);
+    ASSERT_EQ(image.led[base + 3], 0x0A);
+    ASSERT_EQ(image.led[base + 7], LED_FULL_BIT);
+    ASSERT_EQ(image.led[base + 9], LED_FULL_BIT);
+
+    PASS();
+}
+
+TEST expect_frame_images_to_go_out_without_a_copy(void) {
+    pca9685_frame_s image = { { 0 } };
+    pca9685_s driver = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer, .bus_block_writer=recording_block_writer);
+
+    for(int c = 0; c < CHANNELS; c++) pca9685_frame_set_steps(&image, c, 0, (uint16_t)(c * 100 + 1));
+    driver.ops->write_frame(&driver, &image);
+    ASSERT_EQ(block_write_data, image.led);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(15) + 2], (1501 & 0xFF));
+
+    // Only the span that changed goes out, still straight from the image
+    int const block_writes = mock_bus.block_writes;
+    pca9685_frame_set_steps(&image, 3, 0, 7);
+    pca9685_frame_set_steps(&image, 4, 0, 8);
+    driver.ops->write_frame(&driver, &image);
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 1);
+    ASSERT_EQ(block_write_data, &image.led[3 * MULTIPLIER + 2]);
+
+    driver.ops->write_frame(&driver, &image);
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 1);
+
+    PASS();
+}
+
+SUITE(test_frames) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_staged_updates_to_stay_off_the_bus);
+    RUN_TEST(expect_contiguous_channels_to_commit_as_one_transaction);
+    RUN_TEST(expect_separate_runs_to_commit_as_separate_transactions);
+    RUN_TEST(expect_short_clean_runs_to_be_merged);
+    RUN_TEST(expect_last_write_to_a_channel_to_win);
+    RUN_TEST(expect_uniform_frames_to_use_all_led_registers);
+    RUN_TEST(expect_unchanged_frames_to_send_nothing);
+    RUN_TEST(expect_dirty_ranges_to_cover_only_changed_bytes);
+    RUN_TEST(expect_latched_frames_to_commit_as_one_transaction);
+    RUN_TEST(expect_latched_frames_to_read_gaps_only_once);
+    RUN_TEST(expect_frame_images_to_match_the_register_map);
+    RUN_TEST(expect_frame_images_to_go_out_without_a_copy);
+}
@@ -0,0 +1,290 @@
+#include "tests.h"
+#include "pca9685_linux.h"
+#include "pca9685_record.h"
+
+#include <errno.h>
+#include <string.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/* Test setup begin */
+
+#define FAKE_FD 7
+
+// A userspace stand-in for an i2c-dev adapter with one PCA9685 behind it
+static struct {
+    u8 registers[256];
+    u8 pointer;
+    unsigned long slave;
+    int syscalls;
+    int fail;
+    int any_slave;              // Accept every address, for a bus of boards; only the registers are shared
+    int rdwrs;                  // I2C_RDWR ioctls that wrote LED0_ON_L or above
+    uint64_t rdwr_slaves[16];   // Slaves 0x40–0x7F each of those wrote to, one bit each
+} fake;
+
+static pca9685_linux_i2c_s bus;
+static pca9685_s driver;
+
+static void fake_store(const u8 *buf, size_t len) {
+    fake.pointer = buf[0];
+    for(size_t i = 1; i < len; i++) fake.registers[fake.pointer++] = buf[i];
+}
+
+static int fake_open(const char *path, int flags) {
+    (void)flags;
+    fake.syscalls++;
+
+    return strcmp(path, "/dev/i2c-1") == 0 ? FAKE_FD : (errno = ENOENT, -1);
+}
+
+static int fake_close(int fd) {
+    (void)fd;
+    fake.syscalls++;
+
+    return 0;
+}
+
+static int fake_ioctl(int fd, unsigned long request, void *arg) {
+    fake.syscalls++;
+    if(fd != FAKE_FD || fake.fail) return (errno = EIO, -1);
+
+    if(request == I2C_SLAVE) {
+        fake.slave = (unsigned long)arg;
+        return 0;
+    }
+
+    if(request == I2C_RDWR) {
+        struct i2c_rdwr_ioctl_data *transfer = arg;
+        if(transfer->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS) return (errno = EINVAL, -1);
+
+        for(unsigned i = 0; i < transfer->nmsgs; i++) {
+            struct i2c_msg *msg = &transfer->msgs[i];
+            if(msg->addr != fake.slave && !fake.any_slave) return (errno = ENXIO, -1);
+            if(!(msg->flags & I2C_M_RD) && msg->len > 1 && msg->buf[0] >= LED0_ON_L && fake.rdwrs < 16) {
+                fake.rdwr_slaves[fake.rdwrs] |= (uint64_t)1 << (msg->addr & 0x3F);
+            }
+
+            if(msg->flags & I2C_M_RD) {
+                for(unsigned j = 0; j < msg->len; j++) msg->buf[j] = fake.registers[fake.pointer++];
+            } else {
+                fake_store(msg->buf, msg->len);
+            }
+        }
+        if(fake.rdwrs < 16 && fake.rdwr_slaves[fake.rdwrs]) fake.rdwrs++;
+        return (int)transfer->nmsgs;
+    }
+
+    return (errno = ENOTTY, -1);
+}
+
+static ssize_t fake_write(int fd, const void *buf, size_t count) {
+    fake.syscalls++;
+    if(fd != FAKE_FD || fake.fail) return (errno = EIO, -1);
+
+    fake_store(buf, count);
+
+    return (ssize_t)count;
+}
+
+static const pca9685_linux_io_s fake_io = {
+    .open = fake_open,
+    .close = fake_close,
+    .ioctl = fake_ioctl,
+    .write = fake_write
+};
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(&fake, 0, sizeof(fake));
+    pca9685_linux_i2c_open(&bus, 1, 0x40, &fake_io);
+    driver = pca9685(PCA9685_LINUX_I2C(&bus));
+    fake.syscalls = 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_open_to_bind_the_slave_address(void) {
+    ASSERT_EQ(bus.fd, FAKE_FD);
+    ASSERT_EQ(fake.slave, 0x40);
+    ASSERT_STR_EQ(driver.status, "ok");
+
+    PASS();
+}
+
+TEST expect_open_to_report_missing_adapters(void) {
+    pca9685_linux_i2c_s missing;
+
+    ASSERT_EQ(pca9685_linux_i2c_open(&missing, 9, 0x40, &fake_io), -1);
+    ASSERT_EQ(missing.error, ENOENT);
+
+    PASS();
+}
+
+TEST expect_reads_to_take_one_syscall(void) {
+    fake.registers[PRE_SCALE] = 0x1E;
+    driver.ops->invalidate(&driver);
+
+    pca9685_i2c_bus_read(&driver, PRE_SCALE);
+
+    ASSERT_EQ(driver.data, 0x1E);
+    ASSERT_EQ(fake.syscalls, 1);
+
+    PASS();
+}
+
+TEST expect_block_reads_to_take_one_syscall(void) {
+    u8 values[LED_REGISTERS];
+
+    for(int i = 0; i < LED_REGISTERS; i++) fake.registers[LED0_ON_L + i] = (u8)i;
+
+    ASSERT_EQ(driver.bus_block_reader(&driver, LED0_ON_L, LED_REGISTERS, values), 0);
+    ASSERT_EQ(fake.syscalls, 1);
+    ASSERT_EQ(values[LED_REGISTERS - 1], LED_REGISTERS - 1);
+
+    PASS();
+}
+
+TEST expect_channel_updates_to_take_one_syscall(void) {
+    driver.ops->set_steps(&driver, 3, 1, 2);
+    int const syscalls = fake.syscalls;
+
+    driver.ops->set_steps(&driver, 4, 0x123, 0x456);
+
+    ASSERT_EQ(fake.syscalls, syscalls + 1);
+    ASSERT_EQ(fake.registers[channel_to_register_base(4) + 3], 0x04);
+
+    PASS();
+}
+
+TEST expect_frames_to_take_one_syscall(void) {
+    driver.ops->set_steps(&driver, 0, 0, 0);
+    int const syscalls = fake.syscalls;
+
+    driver.ops->begin_frame(&driver);
+    driver.ops->set_steps(&driver, 1, 10, 20);
+    driver.ops->set_steps(&driver, 6, 30, 40);
+    driver.ops->set_steps(&driver, 12, 50, 60);
+    driver.ops->commit_frame(&driver);
+
+    ASSERT_EQ(fake.syscalls, syscalls + 1);
+    ASSERT_EQ(fake.registers[channel_to_register_base(1) + 2], 20);
+    ASSERT_EQ(fake.registers[channel_to_register_base(6) + 2], 40);
+    ASSERT_EQ(fake.registers[channel_to_register_base(12) + 2], 60);
+    ASSERT(fake.registers[MODE1] & AI);
+
+    PASS();
+}
+
+TEST expect_split_transfers_to_keep_each_device_whole(void) {
+    static pca9685_bus_s boards = { PCA9685_LINUX_I2C_BUS(&bus) };
+    int const devices = 6;
+
+    fake.any_slave = 1;
+    boards.count = 0;
+    for(int d = 0; d < devices; d++) {
+        pca9685_s *h = pca9685_bus_add(&boards, (u8)(0x40 + d));
+        h->latched = 1;
+        for(int c = 0; c < CHANNELS; c++) h->ops->set_steps(h, c, 0, 0);
+    }
+
+    // Every other channel changes: eight runs a device, 48 in all, more than one ioctl takes
+    pca9685_bus_begin_all(&boards);
+    for(int d = 0; d < devices; d++) {
+        for(int c = 0; c < CHANNELS; c += 2) boards.devices[d].ops->set_steps(&boards.devices[d], c, 10, 20);
+    }
+    fake.rdwrs = 0;
+    memset(fake.rdwr_slaves, 0, sizeof(fake.rdwr_slaves));
+    pca9685_bus_commit_all(&boards);
+
+    ASSERT_EQ(fake.rdwrs, 2);
+    ASSERT_EQ(fake.rdwr_slaves[0] & fake.rdwr_slaves[1], 0);
+    ASSERT_EQ(fake.rdwr_slaves[0] | fake.rdwr_slaves[1], (1u << devices) - 1);
+    for(int d = 0; d < devices; d++) ASSERT_STR_EQ(boards.devices[d].status, "ok");
+
+    PASS();
+}
+
+TEST expect_oversized_device_transfers_to_be_joined(void) {
+    pca9685_i2c_write_s writes[I2C_RDWR_IOCTL_MAX_MSGS + 1];
+    u8 const value = 0x5A;
+
+    for(int i = 0; i < 2 * I2C_RDWR_IOCTL_MAX_MSGS; i++) fake.registers[LED0_ON_L + i] = (u8)i;
+
+    // One byte in every other register: the ones between keep what the device holds
+    for(int i = 0; i < I2C_RDWR_IOCTL_MAX_MSGS + 1; i++) {
+        writes[i] = (pca9685_i2c_write_s){ .address = (u8)(LED0_ON_L + 2 * i), .length = 1, .data = &value };
+    }
+    int const syscalls = fake.syscalls;
+
+    // One ioctl reads the span back, and one writes it whole
+    ASSERT_EQ(pca9685_linux_i2c_transfer(&driver, writes, I2C_RDWR_IOCTL_MAX_MSGS + 1), OK);
+    ASSERT_EQ(fake.syscalls, syscalls + 2);
+    ASSERT_EQ(fake.rdwrs, 1);
+    ASSERT_EQ(fake.registers[LED0_ON_L], value);
+    ASSERT_EQ(fake.registers[LED0_ON_L + 1], 1);
+    ASSERT_EQ(fake.registers[LED0_ON_L + 2 * I2C_RDWR_IOCTL_MAX_MSGS], value);
+    ASSERT_EQ(fake.registers[LED0_ON_L + 2 * I2C_RDWR_IOCTL_MAX_MSGS - 1], 2 * I2C_RDWR_IOCTL_MAX_MSGS - 1);
+
+    PASS();
+}
+
+#if PCA9685_RECORDER
+TEST expect_recorded_transactions_to_carry_the_opened_slave(void) {
+    pca9685_record_s ring[8];
+    pca9685_recorder_s recorder;
+    pca9685_replay_stats_s stats;
+
+    pca9685_recorder_init(&recorder, ring, 8);
+    driver.recorder = &recorder;
+    driver.ops->set_steps(&driver, 4, 0x123, 0x456);
+    driver.recorder = NULL;
+
+    // Auto-increment, then the channel's four registers
+    int const records = (int)recorder.head;
+
+    ASSERT_EQ(driver.slave_address, 0x40);
+    ASSERT(records >= 4);
+    for(int i = 0; i < records; i++) ASSERT_EQ(ring[i].slave, 0x40);
+
+    // A trace without the address has to go nowhere, not to the general call address
+    for(int i = 0; i < records; i++) ring[i].slave = 0;
+    driver.slave_address = 0;
+    fake.syscalls = 0;
+
+    ASSERT_EQ(pca9685_replay(ring, (size_t)records, &driver, 1, PCA9685_REPLAY_MAX, &stats), 0);
+    ASSERT_EQ(stats.skipped, (uint64_t)records);
+    ASSERT_EQ(fake.syscalls, 0);
+
+    PASS();
+}
+#endif
+
+TEST expect_failures_to_be_reported(void) {
+    fake.fail = 1;
+    driver.ops->set_steps(&driver, 2, 1, 2);
+
+    ASSERT_STR_EQ(driver.status, "error");
+    ASSERT_EQ(bus.error, EIO);
+    ASSERT_FALSE(pca9685_shadow_known(&driver, channel_to_register_base(2)));
+
+    PASS();
+}
+
+SUITE(test_linux_i2c) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_open_to_bind_the_slave_address);
+    RUN_TEST(expect_open_to_report_missing_adapters);
+    RUN_TEST(expect_reads_to_take_one_syscall);
+    RUN_TEST(expect_block_reads_to_take_one_syscall);
+    RUN_TEST(expect_channel_updates_to_take_one_syscall);
+    RUN_TEST(expect_frames_to_take_one_syscall);
+    RUN_TEST(expect_split_transfers_to_keep_each_device_whole);
+    RUN_TEST(expect_oversized_device_transfers_to_be_joined);
+#if PCA9685_RECORDER
+    RUN_TEST(expect_recorded_transactions_to_carry_the_opened_slave);
+#endif
+    RUN_TEST(expect_failures_to_be_reported);
+}
@@ -0,0 +1,142 @@
+#include "tests.h"
+#include "pca9685_emu.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+#define IDLE_MS 20
+#define PAST_IDLE_NS ((IDLE_MS + 5) * 1000000u)
+
+static pca9685_emu_s board;
+static pca9685_emu_bus_s emu_bus;
+static pca9685_s driver;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(&board, 0, sizeof(board));
+    pca9685_emu_power_on(&board, 0x40);
+    emu_bus = (pca9685_emu_bus_s){ .devices = &board, .count = 1 };
+
+    driver = pca9685(PCA9685_EMU(&emu_bus, 0x40), .idle_sleep_ms = IDLE_MS);
+    driver.ops->set_frequency(&driver, 200);
+}
+
+// Every channel off, then past the idle timeout
+static void idle_to_sleep(void) {
+    driver.ops->channel_off(&driver, ALL);
+    sleep_ns(PAST_IDLE_NS);
+    driver.ops->check_idle(&driver);
+    emu_bus.transactions = 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_idle_board_to_sleep_after_the_timeout(void) {
+    driver.ops->channel_off(&driver, ALL);
+
+    ASSERT_EQ(driver.ops->check_idle(&driver), 0);
+    ASSERT(pca9685_emu_running(&board));
+
+    sleep_ns(PAST_IDLE_NS);
+
+    ASSERT_EQ(driver.ops->check_idle(&driver), 1);
+    ASSERT(board.registers[MODE1] & SLEEP);
+    ASSERT_FALSE(pca9685_emu_running(&board));
+
+    PASS();
+}
+
+TEST expect_lit_channel_to_keep_the_board_awake(void) {
+    driver.ops->channel_off(&driver, ALL);
+    driver.ops->channel_on(&driver, 3);
+    sleep_ns(PAST_IDLE_NS);
+
+    ASSERT_EQ(driver.ops->check_idle(&driver), 0);
+    ASSERT(pca9685_emu_running(&board));
+
+    PASS();
+}
+
+TEST expect_lit_update_to_wake_without_rewriting(void) {
+    pca9685_emu_wave_s wave;
+
+    idle_to_sleep();
+    driver.ops->set_steps(&driver, 5, 0, 2048);
+
+    // The wake, then the one byte of OFF_H that changed; the settle isn't waited out
+    ASSERT_EQ(emu_bus.transactions, 2);
+    ASSERT(driver.settle_deadline != 0);
+    ASSERT_FALSE(driver.waking);
+    ASSERT(pca9685_emu_running(&board));
+
+    pca9685_emu_waveform(&board, 5, &wave);
+    ASSERT_EQ(wave.fall_ns - wave.rise_ns, wave.period_ns / 2);
+    ASSERT_EQ(board.violations, 0);
+
+    PASS();
+}
+
+TEST expect_wake_to_restart_pwm_running_at_sleep(void) {
+    pca9685_emu_wave_s wave;
+
+    driver.ops->channel_on(&driver, 4);
+    pca9685_i2c_bus_write(&driver, MODE1, (u8)((driver.shadow[MODE1] & ~RESTART) | SLEEP));
+    ASSERT(board.registers[MODE1] & RESTART);
+
+    driver.ops->set_steps(&driver, 6, 0, 1024);
+
+    ASSERT(pca9685_emu_running(&board));
+    ASSERT_FALSE(driver.shadow[MODE1] & RESTART);
+    ASSERT_EQ(board.violations, 0);
+
+    pca9685_emu_waveform(&board, 4, &wave);
+    ASSERT(wave.constant && wave.level);
+
+    PASS();
+}
+
+TEST expect_frame_to_be_staged_while_the_oscillator_settles(void) {
+    pca9685_emu_wave_s wave;
+
+    idle_to_sleep();
+    driver.ops->begin_frame(&driver);
+    driver.ops->set_steps(&driver, 1, 0, 1024);
+    driver.ops->set_steps(&driver, 2, 0, 1024);
+
+    // Awake from the first lit update; the LED writes wait for the commit
+    ASSERT_EQ(emu_bus.transactions, 1);
+    ASSERT_FALSE(board.registers[MODE1] & SLEEP);
+    ASSERT(driver.waking);
+
+    driver.ops->commit_frame(&driver);
+
+    ASSERT_FALSE(driver.waking);
+    pca9685_emu_waveform(&board, 2, &wave);
+    ASSERT_EQ(wave.fall_ns - wave.rise_ns, wave.period_ns / 4);
+
+    PASS();
+}
+
+TEST expect_no_policy_to_leave_the_board_running(void) {
+    driver.idle_sleep_ms = 0;
+    driver.ops->channel_off(&driver, ALL);
+    sleep_ns(PAST_IDLE_NS);
+
+    ASSERT_EQ(driver.ops->check_idle(&driver), 0);
+    ASSERT(pca9685_emu_running(&board));
+
+    PASS();
+}
+
+SUITE(test_power) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_idle_board_to_sleep_after_the_timeout);
+    RUN_TEST(expect_lit_channel_to_keep_the_board_awake);
+    RUN_TEST(expect_lit_update_to_wake_without_rewriting);
+    RUN_TEST(expect_wake_to_restart_pwm_running_at_sleep);
+    RUN_TEST(expect_frame_to_be_staged_while_the_oscillator_settles);
+    RUN_TEST(expect_no_policy_to_leave_the_board_running);
+}
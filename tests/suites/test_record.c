@@ -0,0 +1,226 @@
+#include "tests.h"
+#include "pca9685_emu.h"
+#include "pca9685_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Test setup begin */
+
+#define RING 64
+
+static pca9685_emu_s board;
+static pca9685_emu_bus_s emu_bus;
+static pca9685_s driver;
+static pca9685_record_s ring[RING];
+static pca9685_recorder_s recorder;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    memset(&board, 0, sizeof(board));
+    pca9685_emu_power_on(&board, 0x40);
+    emu_bus = (pca9685_emu_bus_s){ .devices = &board, .count = 1 };
+
+    driver = pca9685(PCA9685_EMU(&emu_bus, 0x40));
+    driver.ops->set_frequency(&driver, 200);
+
+    pca9685_recorder_init(&recorder, ring, RING);
+    driver.recorder = &recorder;
+}
+
+// Everything but the timestamp, for slave 0x40 and a successful call
+static int record_is(const pca9685_record_s *r, pca9685_record_op op, u8 address, u8 value, u8 index, u8 length, u8 part) {
+    return r->slave == 0x40 && r->op == op && r->address == address && r->value == value && r->index == index
+        && r->length == length && r->part == part && r->result == OK;
+}
+
+// Flushed to a fresh temporary trace file; the caller removes it
+static void record_to_file(char *path) {
+    int const fd = mkstemp(path);
+    close(fd);
+
+    pca9685_recorder_open(&recorder, path);
+    driver.ops->set_steps(&driver, 0, 0x123, 0x456);
+    driver.ops->begin_frame(&driver);
+    driver.ops->set_steps(&driver, 1, 0, 1024);
+    driver.ops->set_steps(&driver, 8, 0, 3072);
+    driver.ops->commit_frame(&driver);
+    pca9685_recorder_close(&recorder);
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_block_write_to_be_recorded_per_byte(void) {
+    u8 const bytes[] = { 0x23, 0x01, 0x56, 0x04 };
+
+    driver.ops->set_steps(&driver, 0, 0x123, 0x456);
+
+    ASSERT_EQ(recorder.head, 4);
+    for(u8 i = 0; i < 4; i++) {
+        ASSERT(record_is(&ring[i], PCA9685_RECORD_BLOCK_WRITE, (u8)(LED0_ON_L + i), bytes[i], i, 4, 0));
+    }
+    ASSERT(ring[0].timestamp != 0 && ring[3].timestamp == ring[0].timestamp);
+
+    PASS();
+}
+
+TEST expect_frame_to_be_recorded_as_one_transfer(void) {
+    driver.ops->begin_frame(&driver);
+    driver.ops->set_steps(&driver, 1, 0, 1024);
+    driver.ops->set_steps(&driver, 8, 0, 1024);
+
+    ASSERT_EQ(recorder.head, 0);
+
+    driver.ops->commit_frame(&driver);
+
+    // Each channel's four registers as one write of the transfer
+    ASSERT_EQ(recorder.head, 8);
+    ASSERT(record_is(&ring[0], PCA9685_RECORD_TRANSFER, LED0_ON_L + 4 * 1, 0x00, 0, 4, 0));
+    ASSERT(record_is(&ring[3], PCA9685_RECORD_TRANSFER, LED0_ON_L + 4 * 1 + 3, 0x04, 3, 4, 0));
+    ASSERT(record_is(&ring[4], PCA9685_RECORD_TRANSFER, LED0_ON_L + 4 * 8, 0x00, 0, 4, 1));
+    ASSERT(record_is(&ring[7], PCA9685_RECORD_TRANSFER, LED0_ON_L + 4 * 8 + 3, 0x04, 3, 4, 1));
+    ASSERT_EQ(ring[4].timestamp, ring[0].timestamp);
+
+    PASS();
+}
+
+TEST expect_full_ring_to_drop_whole_transactions(void) {
+    ASSERT_EQ(pca9685_recorder_init(&recorder, ring, 6), -1);
+    ASSERT_EQ(pca9685_recorder_init(&recorder, ring, 4), 0);
+
+    driver.ops->set_steps(&driver, 0, 0x123, 0x456);
+    driver.ops->set_steps(&driver, 2, 0, 1024);
+
+    // The first fills the ring; the second still reaches the board
+    ASSERT_EQ(recorder.head, 4);
+    ASSERT(recorder.dropped > 0);
+    ASSERT_EQ(board.registers[LED0_ON_L + 4 * 2 + 3], 0x04);
+
+    PASS();
+}
+
+TEST expect_full_ring_to_drop_whole_transfers(void) {
+    ASSERT_EQ(pca9685_recorder_init(&recorder, ring, 8), 0);
+
+    driver.ops->set_steps(&driver, 0, 0x123, 0x456);
+    ASSERT_EQ(recorder.head, 4);
+
+    // The first channel's write still fits, the second doesn't: neither is kept
+    driver.ops->begin_frame(&driver);
+    driver.ops->set_steps(&driver, 1, 0, 1024);
+    driver.ops->set_steps(&driver, 8, 0, 1024);
+    driver.ops->commit_frame(&driver);
+
+    ASSERT_EQ(recorder.head, 4);
+    ASSERT_EQ(recorder.dropped, 8);
+    ASSERT(record_is(&ring[3], PCA9685_RECORD_BLOCK_WRITE, LED0_ON_L + 3, 0x04, 3, 4, 0));
+
+    // The next transaction is recorded as usual
+    driver.ops->set_steps(&driver, 2, 0, 0x456);
+    ASSERT_EQ(recorder.head, 8);
+    ASSERT(record_is(&ring[4], PCA9685_RECORD_BLOCK_WRITE, LED0_ON_L + 4 * 2, 0x00, 0, 4, 0));
+
+    PASS();
+}
+
+TEST expect_trace_to_round_trip_through_a_file(void) {
+    char path[] = "/tmp/pca9685_traceXXXXXX";
+    size_t count;
+
+    record_to_file(path);
+    const pca9685_record_s *trace = pca9685_trace_map(path, &count);
+
+    ASSERT(trace != NULL);
+    ASSERT_EQ(count, 12);
+    ASSERT_EQ(recorder.tail, recorder.head);
+    ASSERT_EQ(memcmp(trace, ring, count * sizeof(*trace)), 0);
+
+    pca9685_trace_unmap(trace, count);
+    unlink(path);
+
+    PASS();
+}
+
+TEST expect_other_files_not_to_map(void) {
+    char path[] = "/tmp/pca9685_traceXXXXXX";
+    size_t count;
+    int const fd = mkstemp(path);
+
+    ASSERT_EQ(write(fd, "PCA9685X\1\0\0\0\20\0\0\0", 16), 16);
+    close(fd);
+
+    ASSERT_EQ(pca9685_trace_map(path, &count), NULL);
+    ASSERT_EQ(pca9685_trace_map("/nonexistent/trace", &count), NULL);
+
+    unlink(path);
+
+    PASS();
+}
+
+TEST expect_replay_to_reproduce_the_registers(void) {
+    char path[] = "/tmp/pca9685_traceXXXXXX";
+    size_t count;
+    pca9685_emu_s fresh;
+    pca9685_emu_bus_s fresh_bus = { .devices = &fresh, .count = 1 };
+    pca9685_replay_stats_s stats;
+
+    record_to_file(path);
+    const pca9685_record_s *trace = pca9685_trace_map(path, &count);
+
+    // Configured as the recorded board was before recording began
+    pca9685_emu_power_on(&fresh, 0x40);
+    pca9685_s target = pca9685(PCA9685_EMU(&fresh_bus, 0x40));
+    target.ops->set_frequency(&target, 200);
+    fresh_bus.transactions = 0;
+
+    ASSERT_EQ(pca9685_replay(trace, count, &target, 1, PCA9685_REPLAY_MAX, &stats), 2);
+    ASSERT_EQ(stats.bytes, 12);
+    ASSERT_EQ(stats.errors, 0);
+    ASSERT_EQ(stats.skipped, 0);
+    ASSERT_EQ(stats.latency.count, 2);
+    ASSERT_EQ(stats.lag.count, 0);
+    ASSERT_EQ(fresh_bus.transactions, 2);
+    ASSERT_EQ(memcmp(&fresh.registers[LED0_ON_L], &board.registers[LED0_ON_L], 4 * 9), 0);
+
+    pca9685_trace_unmap(trace, count);
+    unlink(path);
+
+    PASS();
+}
+
+TEST expect_replay_to_skip_unknown_slaves_and_count_mismatches(void) {
+    pca9685_replay_stats_s stats;
+    pca9685_record_s const trace[] = {
+        { .timestamp = 1000, .slave = 0x40, .address = MODE1, .value = 0xff, .op = PCA9685_RECORD_READ, .length = 1 },
+        { .timestamp = 2000, .slave = 0x41, .address = MODE1, .value = 0x01, .op = PCA9685_RECORD_WRITE, .length = 1 },
+        { .timestamp = 3000, .slave = 0x40, .address = MODE1, .value = board.registers[MODE1], .op = PCA9685_RECORD_READ, .length = 1 }
+    };
+
+    ASSERT_EQ(pca9685_replay(trace, 3, &driver, 1, PCA9685_REPLAY_ORIGINAL, &stats), 2);
+    ASSERT_EQ(stats.mismatched, 1);
+    ASSERT_EQ(stats.skipped, 1);
+    ASSERT_EQ(stats.recorded_ns, 2000);
+    ASSERT_EQ(stats.lag.count, 2);
+    ASSERT(stats.replayed_ns >= 2000);
+
+    // Replay bypasses the driver, so nothing of it is recorded
+    ASSERT_EQ(recorder.head, 0);
+
+    PASS();
+}
+
+SUITE(test_record) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_block_write_to_be_recorded_per_byte);
+    RUN_TEST(expect_frame_to_be_recorded_as_one_transfer);
+    RUN_TEST(expect_full_ring_to_drop_whole_transactions);
+    RUN_TEST(expect_full_ring_to_drop_whole_transfers);
+    RUN_TEST(expect_trace_to_round_trip_through_a_file);
+    RUN_TEST(expect_other_files_not_to_map);
+    RUN_TEST(expect_replay_to_reproduce_the_registers);
+    RUN_TEST(expect_replay_to_skip_unknown_slaves_and_count_mismatches);
+}
@@ -1,22 +1,63 @@
 #include "tests.h"
 
 #include <math.h>
+#include <string.h>
 
 /* Test setup begin */
 
-static pca9685_s mock_driver;
+static pca9685_s mock_driver, mock_block_driver, readback_driver;
 static struct theft_run_config run_config, run_config2, run_config3, run_config4;
 
 static void setup_cb(void *data) {
     (void)data;
 
     set_up_mock_driver(&mock_driver);
+    set_up_mock_driver_with_block_writer(&mock_block_driver);
+    reset_mock_bus();
+    readback_driver = pca9685(.bus_reader=mock_bus_register_reader, .bus_writer=mock_bus_writer,
+        .bus_block_writer=mock_bus_block_writer, .bus_block_reader=mock_bus_block_reader);
+    reset_mock_bus();
     set_up_theft_run_config_u8(&run_config);
     set_up_theft_run_config_u8_int_int(&run_config2);
     set_up_theft_run_config_int(&run_config3);
     set_up_theft_run_config_int_int(&run_config4);
 }
 
+// Floating-point reference implementations the integer tables must match exactly
+static int reference_prescale(int frequency) {
+    frequency = (frequency < FREQ_MIN) ? FREQ_MIN : (frequency > FREQ_MAX) ? FREQ_MAX : frequency;
+
+    return (int)round(((double)OSCILLATOR / (LED_MAX_STEPS * frequency)) - 1);
+}
+
+static int reference_steps(int percent) {
+    percent = (percent < 0) ? 0 : (percent > 100) ? 100 : percent;
+
+    return (int)round(LED_MAX_STEPS * ((double)percent / 100));
+}
+
+static int reference_cie_steps(uint32_t q16) {
+    double const l = (double)q16 / BRIGHTNESS_MAX * 100.0;
+    double const y = (l <= 8.0) ? l / 903.3 : pow((l + 16.0) / 116.0, 3.0);
+
+    return (int)lround(y * LED_MAX_STEPS);
+}
+
+// What the chip holds after power-up: asleep, every channel fully off, prescale for 200Hz (p. 14)
+static void brown_out(void) {
+    memset(mock_bus.registers, 0, sizeof(mock_bus.registers));
+    mock_bus.registers[MODE1] = SLEEP | ALLCALL;
+    mock_bus.registers[MODE2] = OUTDRV;
+    for(u8 c = 0; c < CHANNELS; c++) mock_bus.registers[channel_to_register_base(c) + 3] = LED_FULL_BIT;
+    mock_bus.registers[PRE_SCALE] = 0x1E;
+}
+
+static int led_off_steps(u8 channel) {
+    u8 const base = channel_to_register_base(channel);
+
+    return mock_bus.registers[base + 2] | (mock_bus.registers[base + 3] & 0x0F) << 8;
+}
+
 /* Test setup ends here; tests begin */
 
 TEST expect_register_for_channel_to_be_correct(void) {
@@ -94,6 +135,356 @@ TEST expect_register_writes_to_succeed(void) {
     PASS();
 }
 
+TEST expect_led_bytes_to_fall_back_to_byte_writes(void) {
+    set_led_bytes(&mock_driver, 3, 0x123, 0x456);
+
+    ASSERT_EQ(mock_bus.writes, MULTIPLIER);
+    ASSERT_EQ(mock_bus.block_writes, 0);
+    ASSERT_EQ(mock_bus.registers[0x12], 0x23);
+    ASSERT_EQ(mock_bus.registers[0x13], 0x01);
+    ASSERT_EQ(mock_bus.registers[0x14], 0x56);
+    ASSERT_EQ(mock_bus.registers[0x15], 0x04);
+
+    PASS();
+}
+
+TEST expect_led_bytes_to_use_one_block_write(void) {
+    set_led_bytes(&mock_block_driver, 3, 0x123, 0x456);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    ASSERT_EQ(mock_bus.registers[0x12], 0x23);
+    ASSERT_EQ(mock_bus.registers[0x13], 0x01);
+    ASSERT_EQ(mock_bus.registers[0x14], 0x56);
+    ASSERT_EQ(mock_bus.registers[0x15], 0x04);
+    ASSERT_STR_EQ(mock_block_driver.command, "i2c_block_write");
+    ASSERT_STR_EQ(mock_block_driver.status, "ok");
+
+    PASS();
+}
+
+TEST expect_block_writes_to_enable_auto_increment_once(void) {
+    set_led_bytes(&mock_block_driver, 0, 1, 2);
+    set_led_bytes(&mock_block_driver, 1, 1, 2);
+
+    ASSERT(mock_bus.registers[MODE1] & AI);
+    ASSERT(mock_block_driver.shadow[MODE1] & AI);
+    ASSERT_EQ(mock_bus.reads, 1);
+    ASSERT_EQ(mock_bus.writes, 1);
+    ASSERT_EQ(mock_bus.block_writes, 2);
+
+    PASS();
+}
+
+TEST expect_mode1_writes_to_keep_auto_increment(void) {
+    set_pwm_frequency(&mock_block_driver, 200);
+
+    ASSERT(mock_bus.registers[MODE1] & AI);
+    ASSERT_EQ(mock_bus.registers[PRE_SCALE], 30);
+
+    PASS();
+}
+
+TEST expect_led_frame_to_use_one_block_write(void) {
+    int on[CHANNELS], off[CHANNELS];
+
+    for(int c = 0; c < CHANNELS; c++) {
+        on[c] = c;
+        off[c] = 0x100 * c;
+    }
+
+    set_led_frame(&mock_block_driver, on, off);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+
+    for(int c = 0; c < CHANNELS; c++) {
+        u8 base = channel_to_register_base((u8)c);
+        ASSERT_EQ(mock_bus.registers[base], c);
+        ASSERT_EQ(mock_bus.registers[base + 1], 0);
+        ASSERT_EQ(mock_bus.registers[base + 2], 0);
+        ASSERT_EQ(mock_bus.registers[base + 3], c);
+    }
+
+    PASS();
+}
+
+TEST expect_unchanged_led_bytes_to_be_elided(void) {
+    set_led_bytes(&mock_driver, 2, 0x010, 0x800);
+    ASSERT_EQ(mock_bus.writes, MULTIPLIER);
+
+    set_led_bytes(&mock_driver, 2, 0x010, 0x800);
+    ASSERT_EQ(mock_bus.writes, MULTIPLIER);
+    ASSERT_STR_EQ(mock_driver.status, "ok");
+
+    PASS();
+}
+
+TEST expect_block_writes_to_send_only_the_changed_span(void) {
+    set_led_bytes(&mock_block_driver, 2, 0x010, 0x800);
+    int const writes = mock_bus.writes;
+
+    set_led_bytes(&mock_block_driver, 2, 0x010, 0x900);
+
+    // A lone changed byte goes out as a plain byte write
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(2) + 3], 0x09);
+
+    set_led_bytes(&mock_block_driver, 2, 0x010, 0xA01);
+
+    ASSERT_EQ(mock_bus.block_writes, 2);
+    ASSERT_EQ(mock_block_driver.address, channel_to_register_base(2) + 2);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(2) + 3], 0x0A);
+
+    PASS();
+}
+
+TEST expect_all_led_writes_to_update_every_channel_shadow(void) {
+    set_led_bytes(&mock_driver, ALL, 0, 0x234);
+    set_led_bytes(&mock_driver, 7, 0, 0x234);
+
+    ASSERT_EQ(mock_bus.writes, MULTIPLIER);
+
+    PASS();
+}
+
+TEST expect_known_registers_to_be_read_from_shadow(void) {
+    pca9685_i2c_bus_write(&mock_driver, PRE_SCALE, 0x1E);
+    pca9685_i2c_bus_read(&mock_driver, PRE_SCALE);
+
+    ASSERT_EQ(mock_bus.reads, 0);
+    ASSERT_EQ(mock_driver.data, 0x1E);
+
+    mock_driver.ops->invalidate(&mock_driver);
+    pca9685_i2c_bus_read(&mock_driver, PRE_SCALE);
+
+    ASSERT_EQ(mock_bus.reads, 1);
+
+    PASS();
+}
+
+TEST expect_invalidate_to_force_rewrites(void) {
+    set_led_bytes(&mock_driver, 4, 1, 2);
+    mock_driver.ops->invalidate(&mock_driver);
+    set_led_bytes(&mock_driver, 4, 1, 2);
+
+    ASSERT_EQ(mock_bus.writes, 2 * MULTIPLIER);
+
+    PASS();
+}
+
+TEST expect_resync_to_read_every_register_once(void) {
+    mock_driver.ops->resync(&mock_driver);
+    ASSERT_EQ(mock_bus.reads, LED_REGISTERS + LED0_ON_L + 1);
+
+    for(int r = MODE1; r < LED0_ON_L + LED_REGISTERS; r++) ASSERT(pca9685_shadow_known(&mock_driver, (u8)r));
+    ASSERT(pca9685_shadow_known(&mock_driver, PRE_SCALE));
+
+    mock_driver.ops->resync(&mock_driver);
+    ASSERT_EQ(mock_bus.reads, 2 * (LED_REGISTERS + LED0_ON_L + 1));
+
+    PASS();
+}
+
+TEST expect_snapshots_to_read_the_device_in_one_block_read(void) {
+    pca9685_snapshot_s state;
+
+    brown_out();
+    mock_bus.registers[MODE1] = AI | ALLCALL;
+    mock_bus.registers[MODE2] = OUTDRV | INVRT;
+    mock_bus.registers[channel_to_register_base(3)] = 0x23;
+    mock_bus.registers[channel_to_register_base(3) + 1] = 0x01;
+
+    readback_driver.ops->snapshot(&readback_driver, &state);
+
+    // The MODE1 check for AI, MODE1 through LED15_OFF_H, then PRE_SCALE
+    ASSERT_EQ(mock_bus.block_reads, 1);
+    ASSERT_EQ(mock_bus.reads, 2);
+    ASSERT_FALSE(pca9685_shadow_known(&readback_driver, MODE1));
+
+    ASSERT_EQ(state.prescale, 0x1E);
+    ASSERT_EQ(state.frequency, 197);
+    ASSERT_EQ(state.on[3], 0x123);
+    ASSERT_EQ(state.off[3], LED_FULL_STEPS);
+    ASSERT_EQ(state.registers[channel_to_register_base(15) + 3], LED_FULL_BIT);
+    ASSERT(state.auto_increment && state.inverted && state.totem_pole);
+    ASSERT_FALSE(state.sleeping || state.restart);
+
+    PASS();
+}
+
+TEST expect_brownout_snapshots_to_set_auto_increment_and_block_read(void) {
+    pca9685_snapshot_s state;
+
+    brown_out();
+    readback_driver.ops->snapshot(&readback_driver, &state);
+
+    // The MODE1 check finds AI cleared by the reset and sets it, then MODE1 through LED15_OFF_H, then PRE_SCALE
+    ASSERT_EQ(mock_bus.block_reads, 1);
+    ASSERT_EQ(mock_bus.reads, 2);
+    ASSERT_EQ(mock_bus.writes, 1);
+    ASSERT_EQ(mock_bus.registers[MODE1], SLEEP | ALLCALL | AI);
+
+    // As found, before AI was set
+    ASSERT(state.sleeping);
+    ASSERT_FALSE(state.auto_increment);
+    ASSERT_EQ(state.off[5], LED_FULL_STEPS);
+    ASSERT_EQ(state.prescale, 0x1E);
+
+    PASS();
+}
+
+TEST expect_brownout_behind_a_known_shadow_to_read_again_with_auto_increment(void) {
+    pca9685_snapshot_s state;
+
+    readback_driver.ops->set_steps(&readback_driver, 2, 1, 2);
+    ASSERT(pca9685_shadow_known(&readback_driver, MODE1) && (readback_driver.shadow[MODE1] & AI));
+
+    brown_out();
+    int const reads = mock_bus.reads, block_reads = mock_bus.block_reads, writes = mock_bus.writes;
+    readback_driver.ops->snapshot(&readback_driver, &state);
+
+    // No MODE1 check; the first block read comes back as MODE1 over and over, and is read again
+    ASSERT_EQ(mock_bus.block_reads, block_reads + 2);
+    ASSERT_EQ(mock_bus.reads, reads + 1);
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+
+    ASSERT(state.sleeping);
+    ASSERT_FALSE(state.auto_increment);
+    ASSERT_EQ(state.registers[MODE2], OUTDRV);
+    ASSERT_EQ(state.off[2], LED_FULL_STEPS);
+
+    // The shadow keeps what the device should hold, for reconcile
+    ASSERT_FALSE(readback_driver.shadow[MODE1] & SLEEP);
+
+    PASS();
+}
+
+TEST expect_reconcile_to_rewrite_only_diverged_registers(void) {
+    pca9685_snapshot_s state;
+
+    set_pwm_frequency(&readback_driver, 100);
+    readback_driver.ops->set_steps(&readback_driver, 2, 1, 2);
+    readback_driver.ops->set_steps(&readback_driver, 3, 3, 4);
+    readback_driver.ops->set_steps(&readback_driver, 10, 5, 6);
+
+    brown_out();
+    readback_driver.ops->snapshot(&readback_driver, &state);
+    ASSERT(state.sleeping);
+
+    int const writes = mock_bus.writes, block_writes = mock_bus.block_writes;
+    int const rewritten = readback_driver.ops->reconcile(&readback_driver, &state);
+
+    // Channels 2 and 3 as one run and channel 10 as another; the channels never written stay as read
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 2);
+    ASSERT(rewritten > 0);
+    ASSERT_EQ(led_off_steps(3), 4);
+    ASSERT_EQ(led_off_steps(10), 6);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(9) + 3], LED_FULL_BIT);
+
+    // Then the frequency, with the oscillator off, and the wake-up
+    ASSERT_EQ(mock_bus.registers[PRE_SCALE], calculate_prescale_from_frequency(100));
+    ASSERT_FALSE(mock_bus.registers[MODE1] & SLEEP);
+    ASSERT(mock_bus.registers[MODE1] & AI);
+    ASSERT(mock_bus.writes > writes);
+
+    PASS();
+}
+
+TEST expect_reconcile_of_a_matching_device_to_write_nothing(void) {
+    pca9685_snapshot_s state;
+
+    set_pwm_frequency(&readback_driver, 100);
+    readback_driver.ops->set_steps(&readback_driver, 5, 7, 8);
+    readback_driver.ops->snapshot(&readback_driver, &state);
+
+    int const writes = mock_bus.writes, block_writes = mock_bus.block_writes;
+
+    ASSERT_EQ(readback_driver.ops->reconcile(&readback_driver, &state), 0);
+    ASSERT_EQ(mock_bus.writes, writes);
+    ASSERT_EQ(mock_bus.block_writes, block_writes);
+
+    PASS();
+}
+
+TEST expect_repeated_frequency_to_be_elided(void) {
+    set_pwm_frequency(&mock_driver, 200);
+    int const writes = mock_bus.writes;
+
+    set_pwm_frequency(&mock_driver, 200);
+    ASSERT_EQ(mock_bus.writes, writes);
+
+    set_pwm_frequency(&mock_driver, 300);
+    ASSERT(mock_bus.writes > writes);
+
+    PASS();
+}
+
+TEST expect_soft_reset_to_read_mode1_from_shadow(void) {
+    reset_driver_soft(&mock_driver);
+
+    ASSERT_EQ(mock_bus.reads, 0);
+    ASSERT(pca9685_shadow_known(&mock_driver, MODE1));
+
+    PASS();
+}
+
+TEST expect_blocking_frequency_changes_to_return_settled(void) {
+    uint64_t const start = monotonic_ns();
+    set_pwm_frequency(&mock_driver, 300);
+
+    ASSERT(monotonic_ns() - start >= BEAT);
+    ASSERT_EQ(mock_driver.settle_deadline, 0);
+    ASSERT(mock_driver.ops->is_ready(&mock_driver));
+
+    PASS();
+}
+
+TEST expect_nonblocking_frequency_changes_to_record_a_deadline(void) {
+    mock_driver.nonblocking = 1;
+
+    uint64_t const start = monotonic_ns();
+    set_pwm_frequency(&mock_driver, 300);
+
+    ASSERT(mock_driver.settle_deadline >= start + BEAT);
+    ASSERT_FALSE(mock_driver.ops->is_ready(&mock_driver));
+
+    // LED writes don't need the oscillator and go straight out
+    int const writes = mock_bus.writes;
+    mock_driver.ops->set_steps(&mock_driver, 3, 0, 100);
+    ASSERT(mock_bus.writes > writes);
+    ASSERT(mock_driver.settle_deadline != 0);
+
+    mock_driver.ops->wait_ready(&mock_driver);
+    ASSERT(monotonic_ns() - start >= BEAT);
+    ASSERT(mock_driver.ops->is_ready(&mock_driver));
+
+    PASS();
+}
+
+// Tracks when RESTART goes out, to check it waits for the oscillator
+static uint64_t restart_at;
+
+static u8 restart_timing_writer(pca9685_s *h, u8 address, u8 data) {
+    if(address == MODE1 && (data & RESTART)) restart_at = monotonic_ns();
+
+    return mock_bus_writer(h, address, data);
+}
+
+TEST expect_nonblocking_restart_to_wait_for_the_oscillator(void) {
+    mock_driver.nonblocking = 1;
+    mock_driver.bus_writer = restart_timing_writer;
+    restart_at = 0;
+
+    set_pwm_frequency(&mock_driver, 300);
+    uint64_t const deadline = mock_driver.settle_deadline;
+    reset_driver_soft(&mock_driver);
+
+    ASSERT(restart_at >= deadline);
+    ASSERT(mock_driver.ops->is_ready(&mock_driver));
+
+    PASS();
+}
+
 TEST expect_prescale_calculations_to_be_accurate(void) {
     // Quick spot checks... bounds checking below
     int prescale_v = calculate_prescale_from_frequency(FREQ_MAX);
@@ -138,6 +529,37 @@ TEST expect_prescale_values_to_be_in_bounds(void) {
     PASS();
 }
 
+TEST expect_prescale_table_to_match_reference_over_full_domain(void) {
+    for(int frequency = FREQ_MIN - 1; frequency <= FREQ_MAX + 1; frequency++) {
+        ASSERT_EQ(calculate_prescale_from_frequency(frequency), reference_prescale(frequency));
+    }
+
+    PASS();
+}
+
+static enum theft_trial_res
+property_prescale_matches_reference(struct theft *t, void *arg1) {
+    (void)t;
+    int mock_frequency = *(int *)arg1;
+
+    ASSERT_EQ(calculate_prescale_from_frequency(mock_frequency), reference_prescale(mock_frequency));
+
+    return THEFT_TRIAL_PASS;
+}
+
+TEST expect_prescale_values_to_match_reference(void) {
+    enum theft_run_res res;
+
+    run_config3.name = __func__;
+    run_config3.prop1 = property_prescale_matches_reference;
+
+    res = theft_run(&run_config3);
+
+    ASSERT_EQ(res, THEFT_RUN_PASS);
+
+    PASS();
+}
+
 TEST expect_delay_calculations_to_be_accurate(void) {
     int delay = calculate_delay_time_from_percentage(0);
     ASSERT_EQ(delay, 0);
@@ -172,6 +594,39 @@ TEST expect_delay_calculations_to_be_in_bounds(void) {
     PASS();
 }
 
+TEST expect_step_tables_to_match_reference_over_full_domain(void) {
+    for(int percent = -1; percent <= 101; percent++) {
+        ASSERT_EQ(calculate_delay_time_from_percentage(percent), reference_steps(percent));
+        ASSERT_EQ(calculate_on_time_from_percentage(percent), reference_steps(percent));
+    }
+
+    PASS();
+}
+
+static enum theft_trial_res
+property_steps_match_reference(struct theft *t, void *arg1) {
+    (void)t;
+    int percent = *(int *)arg1;
+
+    ASSERT_EQ(calculate_delay_time_from_percentage(percent), reference_steps(percent));
+    ASSERT_EQ(calculate_on_time_from_percentage(percent), reference_steps(percent));
+
+    return THEFT_TRIAL_PASS;
+}
+
+TEST expect_step_calculations_to_match_reference(void) {
+    enum theft_run_res res;
+
+    run_config3.name = __func__;
+    run_config3.prop1 = property_steps_match_reference;
+
+    res = theft_run(&run_config3);
+
+    ASSERT_EQ(res, THEFT_RUN_PASS);
+
+    PASS();
+}
+
 TEST expect_on_time_calculations_to_be_accurate(void) {
     int on_time = calculate_on_time_from_percentage(0);
     ASSERT_EQ(on_time, 0);
@@ -206,6 +661,218 @@ TEST expect_on_time_calculations_to_be_in_bounds(void) {
     PASS();
 }
 
+TEST expect_brightness_calculations_to_be_accurate(void) {
+    ASSERT_EQ(calculate_steps_from_brightness(0), 0);
+    ASSERT_EQ(calculate_steps_from_brightness(0x10), 1);
+    ASSERT_EQ(calculate_steps_from_brightness(0x8000), 2048);
+    ASSERT_EQ(calculate_steps_from_brightness(BRIGHTNESS_MAX), LED_MAX_STEPS);
+    ASSERT_EQ(calculate_steps_from_brightness(0xFFFFFFFF), LED_MAX_STEPS);
+
+    PASS();
+}
+
+static enum theft_trial_res
+property_brightness_is_monotonic_and_in_bounds(struct theft *t, void *arg1) {
+    (void)t;
+    uint32_t q16 = *(u8 *)arg1 * 0x101u;
+    int steps = calculate_steps_from_brightness(q16);
+
+    ASSERT(steps >= 0 && steps <= LED_MAX_STEPS);
+    ASSERT(steps <= calculate_steps_from_brightness(q16 + 1));
+
+    return THEFT_TRIAL_PASS;
+}
+
+TEST expect_brightness_calculations_to_be_in_bounds(void) {
+    enum theft_run_res res;
+
+    run_config.name = __func__;
+    run_config.prop1 = property_brightness_is_monotonic_and_in_bounds;
+
+    res = theft_run(&run_config);
+
+    ASSERT_EQ(res, THEFT_RUN_PASS);
+
+    PASS();
+}
+
+TEST expect_raw_steps_to_be_written_at_full_resolution(void) {
+    mock_driver.ops->set_steps(&mock_driver, 6, 410, 2047);
+
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6)], 0x9A);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6) + 1], 0x01);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6) + 2], 0xFF);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6) + 3], 0x07);
+
+    mock_driver.ops->set_steps(&mock_driver, 6, -1, LED_MAX_STEPS);
+
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6)], 0x00);
+    ASSERT_EQ(mock_bus.registers[channel_to_register_base(6) + 3], 0x0F);
+
+    PASS();
+}
+
+TEST expect_full_brightness_to_use_full_on_and_off_bits(void) {
+    u8 base = channel_to_register_base(2);
+
+    mock_driver.ops->set_brightness(&mock_driver, 2, BRIGHTNESS_MAX);
+    ASSERT_EQ(mock_bus.registers[base + 1], LED_FULL_BIT);
+    ASSERT_EQ(mock_bus.registers[base + 3], 0);
+
+    // Full OFF overrides full ON, so only OFF_H changes
+    int const writes = mock_bus.writes;
+    mock_driver.ops->set_brightness(&mock_driver, 2, 0);
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+    ASSERT_EQ(mock_bus.registers[base + 3], LED_FULL_BIT);
+
+    mock_driver.ops->set_brightness(&mock_driver, 2, 0x4000);
+    ASSERT_EQ(mock_bus.registers[base + 2], 0x00);
+    ASSERT_EQ(mock_bus.registers[base + 3], 0x04);
+
+    PASS();
+}
+
+TEST expect_channel_off_to_write_one_byte(void) {
+    u8 const base = channel_to_register_base(6);
+
+    mock_driver.ops->set_steps(&mock_driver, 6, 0x100, 0x900);
+    int const writes = mock_bus.writes;
+
+    mock_driver.ops->channel_off(&mock_driver, 6);
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+    ASSERT_EQ(mock_bus.registers[base + 3], LED_FULL_BIT | 0x09);
+
+    // Off already; nothing to send
+    mock_driver.ops->channel_off(&mock_driver, 6);
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+
+    PASS();
+}
+
+TEST expect_channel_on_to_write_only_the_full_bits(void) {
+    u8 const base = channel_to_register_base(6);
+
+    mock_driver.ops->set_steps(&mock_driver, 6, 0x100, 0x900);
+    mock_driver.ops->channel_off(&mock_driver, 6);
+    int const writes = mock_bus.writes;
+
+    mock_driver.ops->channel_on(&mock_driver, 6);
+    ASSERT_EQ(mock_bus.writes, writes + 2);
+    ASSERT(mock_bus.registers[base + 1] & LED_FULL_BIT);
+    ASSERT_FALSE(mock_bus.registers[base + 3] & LED_FULL_BIT);
+
+    // Back off: OFF_H alone again
+    mock_driver.ops->channel_off(&mock_driver, 6);
+    ASSERT_EQ(mock_bus.writes, writes + 3);
+
+    PASS();
+}
+
+TEST expect_all_channels_off_to_write_one_byte(void) {
+    for(int c = 0; c < CHANNELS; c++) mock_driver.ops->set_steps(&mock_driver, c, 0, 0x800);
+    int const writes = mock_bus.writes;
+
+    mock_driver.ops->channel_off(&mock_driver, ALL);
+
+    ASSERT_EQ(mock_bus.writes, writes + 1);
+    ASSERT_EQ(mock_bus.registers[ALL_LED_ON_L + 3], LED_FULL_BIT | 0x08);
+
+    PASS();
+}
+
+TEST expect_bulk_brightness_to_use_one_block_write(void) {
+    uint32_t levels[CHANNELS];
+
+    for(int c = 0; c < CHANNELS; c++) levels[c] = (uint32_t)c << 12;
+
+    mock_block_driver.ops->set_brightness_all(&mock_block_driver, levels);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    for(int c = 0; c < CHANNELS; c++) {
+        int off = mock_bus.registers[channel_to_register_base((u8)c) + 2]
+            | (mock_bus.registers[channel_to_register_base((u8)c) + 3] << 8);
+        ASSERT_EQ(off, c == 0 ? LED_FULL_STEPS : calculate_steps_from_brightness(levels[c]));
+    }
+
+    PASS();
+}
+
+TEST expect_cie_curve_to_match_reference_over_full_domain(void) {
+    for(uint32_t q16 = 0; q16 <= BRIGHTNESS_MAX; q16++) {
+        int const steps = calculate_steps_from_curve(q16, PCA9685_CURVE_CIE);
+        int const reference = reference_cie_steps(q16);
+
+        ASSERT(steps >= reference - 1 && steps <= reference + 1);
+    }
+
+    PASS();
+}
+
+TEST expect_gamma_curve_to_be_monotonic_and_bounded(void) {
+    int previous = 0;
+
+    for(uint32_t q16 = 0; q16 <= BRIGHTNESS_MAX + 16; q16 += 16) {
+        int const steps = calculate_steps_from_curve(q16, PCA9685_CURVE_GAMMA);
+        ASSERT(steps >= previous && steps <= LED_MAX_STEPS);
+        previous = steps;
+    }
+
+    ASSERT_EQ(calculate_steps_from_curve(0, PCA9685_CURVE_GAMMA), 0);
+    ASSERT_EQ(previous, LED_MAX_STEPS);
+    ASSERT(calculate_steps_from_curve(0x8000, PCA9685_CURVE_GAMMA) < calculate_steps_from_brightness(0x8000) / 2);
+    ASSERT_EQ(calculate_steps_from_curve(0x8000, PCA9685_CURVE_LINEAR), calculate_steps_from_brightness(0x8000));
+
+    PASS();
+}
+
+TEST expect_curves_to_apply_per_channel(void) {
+    mock_block_driver.ops->set_curve(&mock_block_driver, ALL, PCA9685_CURVE_CIE);
+    mock_block_driver.ops->set_curve(&mock_block_driver, 0, PCA9685_CURVE_LINEAR);
+    ensure_auto_increment(&mock_block_driver);
+    mock_bus.block_writes = 0;
+
+    // Mixed curves can't share the ALL_LED registers; all 16 channels go out as one block instead
+    mock_block_driver.ops->set_brightness(&mock_block_driver, ALL, 0x8000);
+
+    ASSERT_EQ(mock_bus.block_writes, 1);
+    ASSERT_EQ(led_off_steps(0), 2048);
+    for(u8 c = 1; c < CHANNELS; c++) ASSERT_EQ(led_off_steps(c), reference_cie_steps(0x8000));
+
+    // A uniform curve still uses ALL_LED
+    mock_block_driver.ops->set_curve(&mock_block_driver, 0, PCA9685_CURVE_CIE);
+    mock_block_driver.ops->set_brightness(&mock_block_driver, ALL, 0x4000);
+    ASSERT_EQ(mock_bus.registers[ALL_LED_ON_L + 2], (u8)reference_cie_steps(0x4000));
+
+    PASS();
+}
+
+TEST expect_duty_cycle_to_follow_the_channel_curve(void) {
+    mock_driver.ops->set_curve(&mock_driver, 3, PCA9685_CURVE_CIE);
+    mock_driver.ops->set_duty_cycle(&mock_driver, 3, 0, 50);
+    mock_driver.ops->set_duty_cycle(&mock_driver, 4, 0, 50);
+
+    ASSERT_EQ(led_off_steps(3), reference_cie_steps(0x8000) - 1);
+    ASSERT_EQ(led_off_steps(4), calculate_on_time_from_percentage(50) - 1);
+
+    PASS();
+}
+
+TEST expect_out_of_range_channel_to_use_the_clamped_channels_curve(void) {
+    // The flags after curves[] in the handle are what an unchecked lookup would read as curves
+    mock_driver.nonblocking = 1;
+    mock_driver.latched = 1;
+    mock_driver.ops->set_duty_cycle(&mock_driver, CHANNELS, 0, 50);
+
+    ASSERT_EQ(led_off_steps(MAX_CHANNEL), calculate_on_time_from_percentage(50) - 1);
+
+    mock_driver.ops->set_curve(&mock_driver, MAX_CHANNEL, PCA9685_CURVE_CIE);
+    mock_driver.ops->set_brightness(&mock_driver, CHANNELS + 1, 0x8000);
+
+    ASSERT_EQ(led_off_steps(MAX_CHANNEL), reference_cie_steps(0x8000));
+
+    PASS();
+}
+
 TEST expect_off_time_calculations_to_be_accurate(void) {
     int off_time = calculate_off_time_from_delay_and_on_time(1, 0);
     ASSERT_EQ(off_time, LED_MAX_BITS);
@@ -231,11 +898,49 @@ SUITE(test_register_ops) {
     RUN_TEST(expect_register_for_channel_to_be_correct);
     RUN_TEST(expect_converted_channels_to_be_in_bounds);
     RUN_TEST(expect_register_writes_to_succeed);
+    RUN_TEST(expect_led_bytes_to_fall_back_to_byte_writes);
+    RUN_TEST(expect_led_bytes_to_use_one_block_write);
+    RUN_TEST(expect_block_writes_to_enable_auto_increment_once);
+    RUN_TEST(expect_mode1_writes_to_keep_auto_increment);
+    RUN_TEST(expect_led_frame_to_use_one_block_write);
+    RUN_TEST(expect_unchanged_led_bytes_to_be_elided);
+    RUN_TEST(expect_block_writes_to_send_only_the_changed_span);
+    RUN_TEST(expect_all_led_writes_to_update_every_channel_shadow);
+    RUN_TEST(expect_known_registers_to_be_read_from_shadow);
+    RUN_TEST(expect_invalidate_to_force_rewrites);
+    RUN_TEST(expect_resync_to_read_every_register_once);
+    RUN_TEST(expect_snapshots_to_read_the_device_in_one_block_read);
+    RUN_TEST(expect_brownout_snapshots_to_set_auto_increment_and_block_read);
+    RUN_TEST(expect_brownout_behind_a_known_shadow_to_read_again_with_auto_increment);
+    RUN_TEST(expect_reconcile_to_rewrite_only_diverged_registers);
+    RUN_TEST(expect_reconcile_of_a_matching_device_to_write_nothing);
+    RUN_TEST(expect_repeated_frequency_to_be_elided);
+    RUN_TEST(expect_soft_reset_to_read_mode1_from_shadow);
+    RUN_TEST(expect_blocking_frequency_changes_to_return_settled);
+    RUN_TEST(expect_nonblocking_frequency_changes_to_record_a_deadline);
+    RUN_TEST(expect_nonblocking_restart_to_wait_for_the_oscillator);
     RUN_TEST(expect_prescale_calculations_to_be_accurate);
     RUN_TEST(expect_prescale_values_to_be_in_bounds);
+    RUN_TEST(expect_prescale_table_to_match_reference_over_full_domain);
+    RUN_TEST(expect_prescale_values_to_match_reference);
     RUN_TEST(expect_delay_calculations_to_be_accurate);
     RUN_TEST(expect_delay_calculations_to_be_in_bounds);
+    RUN_TEST(expect_step_tables_to_match_reference_over_full_domain);
+    RUN_TEST(expect_step_calculations_to_match_reference);
     RUN_TEST(expect_on_time_calculations_to_be_accurate);
     RUN_TEST(expect_on_time_calculations_to_be_in_bounds);
     RUN_TEST(expect_off_time_calculations_to_be_accurate);
+    RUN_TEST(expect_brightness_calculations_to_be_accurate);
+    RUN_TEST(expect_brightness_calculations_to_be_in_bounds);
+    RUN_TEST(expect_raw_steps_to_be_written_at_full_resolution);
+    RUN_TEST(expect_full_brightness_to_use_full_on_and_off_bits);
+    RUN_TEST(expect_channel_off_to_write_one_byte);
+    RUN_TEST(expect_channel_on_to_write_only_the_full_bits);
+    RUN_TEST(expect_all_channels_off_to_write_one_byte);
+    RUN_TEST(expect_bulk_brightness_to_use_one_block_write);
+    RUN_TEST(expect_cie_curve_to_match_reference_over_full_domain);
+    RUN_TEST(expect_gamma_curve_to_be_monotonic_and_bounded);
+    RUN_TEST(expect_curves_to_apply_per_channel);
+    RUN_TEST(expect_duty_cycle_to_follow_the_channel_curve);
+    RUN_TEST(expect_out_of_range_channel_to_use_the_clamped_channels_curve);
 }
@@ -0,0 +1,123 @@
+#include "tests.h"
+#include "stats.h"
+
+#include <string.h>
+
+/* Test setup begin */
+
+static pca9685_s mock_driver, mock_block_driver;
+static pca9685_stats_s stats;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    set_up_mock_driver(&mock_driver);
+    set_up_mock_driver_with_block_writer(&mock_block_driver);
+    reset_mock_bus();
+    memset(&stats, 0, sizeof(stats));
+}
+
+static uint64_t histogram_total(const pca9685_histogram_s *histogram) {
+    uint64_t total = 0;
+
+    for(int i = 0; i < PCA9685_STATS_BUCKETS; i++) total += histogram->buckets[i];
+
+    return total;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_nothing_counted_without_storage(void) {
+    pca9685_stats_s copy;
+
+    mock_driver.ops->set_steps(&mock_driver, 0, 1, 2);
+    mock_driver.ops->read_stats(&mock_driver, &copy);
+
+    ASSERT_EQ(copy.writes, 0);
+    ASSERT_EQ(copy.transactions, 0);
+
+    PASS();
+}
+
+TEST expect_byte_writes_and_elisions_to_be_counted(void) {
+    mock_driver.stats = &stats;
+
+    mock_driver.ops->set_steps(&mock_driver, 3, 1, 2);
+    mock_driver.ops->set_steps(&mock_driver, 3, 1, 2);
+
+#if PCA9685_STATS
+    ASSERT_EQ(stats.writes, MULTIPLIER);
+    ASSERT_EQ(stats.bytes, MULTIPLIER);
+    ASSERT_EQ(stats.transactions, MULTIPLIER);
+    ASSERT_EQ(stats.elided, MULTIPLIER);
+    ASSERT_EQ(stats.errors, 0);
+    ASSERT_EQ(stats.bus[PCA9685_STATS_WRITE].count, MULTIPLIER);
+    ASSERT_EQ(histogram_total(&stats.bus[PCA9685_STATS_WRITE]), MULTIPLIER);
+#else
+    ASSERT_EQ(stats.transactions, 0);
+#endif
+
+    PASS();
+}
+
+TEST expect_block_writes_to_count_once(void) {
+    mock_block_driver.stats = &stats;
+
+    mock_block_driver.ops->set_steps(&mock_block_driver, 3, 0x123, 0x456);
+    uint64_t const transactions = stats.transactions;
+
+    mock_block_driver.ops->set_steps(&mock_block_driver, 4, 0x123, 0x456);
+
+#if PCA9685_STATS
+    ASSERT_EQ(stats.transactions, transactions + 1);
+    ASSERT_EQ(stats.bus[PCA9685_STATS_BLOCK_WRITE].count, 2);
+    ASSERT(stats.bus[PCA9685_STATS_BLOCK_WRITE].total_ns >= stats.bus[PCA9685_STATS_BLOCK_WRITE].max_ns);
+#else
+    ASSERT_EQ(stats.transactions, transactions);
+#endif
+
+    PASS();
+}
+
+TEST expect_operations_and_sleeps_to_be_timed(void) {
+    mock_driver.stats = &stats;
+
+    mock_driver.ops->set_frequency(&mock_driver, 500);
+    mock_driver.ops->set_duty_cycle(&mock_driver, 1, 0, 50);
+
+#if PCA9685_STATS
+    ASSERT_EQ(stats.ops[PCA9685_STATS_SET_FREQUENCY].count, 1);
+    ASSERT_EQ(stats.ops[PCA9685_STATS_SET_DUTY_CYCLE].count, 1);
+    ASSERT_EQ(stats.sleeps, 1);
+
+    // The 500μs oscillator wait keeps the frequency change out of every bucket under 2^18ns
+    ASSERT(stats.ops[PCA9685_STATS_SET_FREQUENCY].max_ns >= BEAT);
+    for(int i = 0; i < 9; i++) ASSERT_EQ(stats.ops[PCA9685_STATS_SET_FREQUENCY].buckets[i], 0);
+#endif
+
+    PASS();
+}
+
+TEST expect_reset_to_zero_the_stats(void) {
+    pca9685_stats_s copy;
+
+    mock_driver.stats = &stats;
+    mock_driver.ops->set_steps(&mock_driver, 0, 1, 2);
+    mock_driver.ops->reset_stats(&mock_driver);
+    mock_driver.ops->read_stats(&mock_driver, &copy);
+
+    ASSERT_EQ(copy.writes, 0);
+    ASSERT_EQ(histogram_total(&copy.bus[PCA9685_STATS_WRITE]), 0);
+
+    PASS();
+}
+
+SUITE(test_stats) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_nothing_counted_without_storage);
+    RUN_TEST(expect_byte_writes_and_elisions_to_be_counted);
+    RUN_TEST(expect_block_writes_to_count_once);
+    RUN_TEST(expect_operations_and_sleeps_to_be_timed);
+    RUN_TEST(expect_reset_to_zero_the_stats);
+}
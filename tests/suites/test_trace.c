@@ -0,0 +1,112 @@
+#include "tests.h"
+#include "trace.h"
+
+/* Test setup begin */
+
+#define MAX_EVENTS 16
+
+static pca9685_s mock_driver;
+static pca9685_trace_event_s events[MAX_EVENTS];
+static int event_count;
+
+static void trace_cb(pca9685_s *driver, const pca9685_trace_event_s *event) {
+    (void)driver;
+
+    if(event_count < MAX_EVENTS) events[event_count] = *event;
+    event_count++;
+}
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    set_up_mock_driver(&mock_driver);
+    reset_mock_bus();
+    event_count = 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_no_events_without_a_callback(void) {
+    set_led_bytes(&mock_driver, 0, 1, 2);
+
+    ASSERT_EQ(event_count, 0);
+
+    PASS();
+}
+
+TEST expect_no_events_when_compiled_out(void) {
+#if PCA9685_TRACE_LEVEL == TRACE_OFF
+    mock_driver.trace = trace_cb;
+    set_led_bytes(&mock_driver, 0, 1, 2);
+
+    ASSERT_EQ(event_count, 0);
+
+    PASS();
+#else
+    SKIP();
+#endif
+}
+
+TEST expect_writes_to_be_traced(void) {
+#if PCA9685_TRACE_LEVEL >= TRACE_BUS
+    mock_driver.trace = trace_cb;
+    pca9685_i2c_bus_write(&mock_driver, PRE_SCALE, 0x1E);
+
+    ASSERT_EQ(event_count, 1);
+    ASSERT_EQ(events[0].op, PCA9685_TRACE_WRITE);
+    ASSERT_EQ(events[0].address, PRE_SCALE);
+    ASSERT_EQ(events[0].value, 0x1E);
+    ASSERT_EQ(events[0].result, OK);
+    ASSERT(events[0].timestamp > 0);
+
+    PASS();
+#else
+    SKIP();
+#endif
+}
+
+TEST expect_elided_writes_and_shadow_reads_to_be_traced(void) {
+#if PCA9685_TRACE_LEVEL >= TRACE_BUS
+    pca9685_i2c_bus_write(&mock_driver, PRE_SCALE, 0x1E);
+    mock_driver.trace = trace_cb;
+    pca9685_i2c_bus_write(&mock_driver, PRE_SCALE, 0x1E);
+    pca9685_i2c_bus_read(&mock_driver, PRE_SCALE);
+
+    ASSERT_EQ(event_count, 2);
+    ASSERT_EQ(events[0].op, PCA9685_TRACE_ELIDED_WRITE);
+    ASSERT_EQ(events[1].op, PCA9685_TRACE_SHADOW_READ);
+    ASSERT(events[1].timestamp >= events[0].timestamp);
+
+    PASS();
+#else
+    SKIP();
+#endif
+}
+
+TEST expect_register_operations_to_be_traced(void) {
+#if PCA9685_TRACE_LEVEL >= TRACE_OPS
+    mock_driver.trace = trace_cb;
+    set_pwm_duty_cycle(&mock_driver, 3, 10, 50);
+
+    ASSERT_EQ(events[0].op, PCA9685_TRACE_DUTY_CYCLE);
+    ASSERT_EQ(events[0].address, 3);
+    ASSERT_EQ(events[0].value, 50);
+    ASSERT_EQ(events[0].extra, 10);
+    ASSERT_EQ(events[1].op, PCA9685_TRACE_LED);
+    ASSERT_EQ(events[1].address, channel_to_register_base(3));
+
+    PASS();
+#else
+    SKIP();
+#endif
+}
+
+SUITE(test_trace) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_no_events_without_a_callback);
+    RUN_TEST(expect_no_events_when_compiled_out);
+    RUN_TEST(expect_writes_to_be_traced);
+    RUN_TEST(expect_elided_writes_and_shadow_reads_to_be_traced);
+    RUN_TEST(expect_register_operations_to_be_traced);
+}
@@ -0,0 +1,194 @@
+#include "tests.h"
+#include "pca9685_worker.h"
+
+#include <sched.h>
+
+/* Test setup begin */
+
+#define PRODUCERS 4
+
+static pca9685_s driver;
+static pca9685_worker_s worker;
+
+// Holds the worker inside a block write, so submissions pile up behind it
+static atomic_int gate, gated, fail, fail_address;
+
+static u8 gated_block_writer(pca9685_s *h, u8 address, u8 length, const u8 *data) {
+    atomic_store(&gated, 1);
+    while(atomic_load(&gate)) sched_yield();
+
+    if(atomic_load(&fail) || atomic_load(&fail_address) == address) return 1;
+
+    return mock_bus_block_writer(h, address, length, data);
+}
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    reset_mock_bus();
+    atomic_store(&gate, 0);
+    atomic_store(&gated, 0);
+    atomic_store(&fail, 0);
+    atomic_store(&fail_address, -1);
+    driver = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer, .bus_block_writer=gated_block_writer);
+}
+
+// Submits one update and waits until the worker is stuck sending it
+static void hold_worker(void) {
+    atomic_store(&gate, 1);
+    pca9685_worker_submit_steps(&worker, 15, 0, 1, NULL);
+    while(!atomic_load(&gated)) sched_yield();
+}
+
+static void release_worker(void) {
+    atomic_store(&gate, 0);
+}
+
+static int channel_off_steps(int channel) {
+    u8 const base = channel_to_register_base((u8)channel);
+
+    return mock_bus.registers[base + 2] | (mock_bus.registers[base + 3] & 0x0F) << 8;
+}
+
+static void *producer(void *arg) {
+    int const id = (int)(intptr_t)arg;
+
+    // Each producer owns four channels and walks them up to its final value
+    for(int step = 1; step <= 200; step++) {
+        for(int c = id * 4; c < id * 4 + 4; c++) {
+            while(pca9685_worker_submit_steps(&worker, c, 0, step * 10 + c, NULL) != 0) sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_concurrent_producers_to_land_their_last_values(void) {
+    pthread_t threads[PRODUCERS];
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    for(int i = 0; i < PRODUCERS; i++) pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i);
+    for(int i = 0; i < PRODUCERS; i++) pthread_join(threads[i], NULL);
+    pca9685_worker_stop(&worker);
+
+    for(int c = 0; c < PRODUCERS * 4; c++) ASSERT_EQ(channel_off_steps(c), 2000 + c);
+
+    PASS();
+}
+
+TEST expect_queued_updates_to_coalesce_per_channel(void) {
+    pca9685_request_s first = PCA9685_REQUEST_INIT, second = PCA9685_REQUEST_INIT, other = PCA9685_REQUEST_INIT;
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    hold_worker();
+
+    pca9685_worker_submit_steps(&worker, 5, 0, 100, &first);
+    pca9685_worker_submit_brightness(&worker, 6, 0x8000, &other);
+    pca9685_worker_submit_steps(&worker, 5, 0, 300, &second);
+    ASSERT_EQ(pca9685_request_poll(&second), PCA9685_REQUEST_PENDING);
+
+    int const block_writes = mock_bus.block_writes;
+    release_worker();
+    pca9685_worker_stop(&worker);
+
+    ASSERT_EQ(pca9685_request_poll(&first), PCA9685_REQUEST_SUPERSEDED);
+    ASSERT_EQ(pca9685_request_poll(&second), PCA9685_REQUEST_DONE);
+    ASSERT_EQ(pca9685_request_poll(&other), PCA9685_REQUEST_DONE);
+    ASSERT_EQ(channel_off_steps(5), 300);
+
+    // The held update, then channels 5 and 6 as one contiguous frame write
+    ASSERT_EQ(mock_bus.block_writes, block_writes + 2);
+
+    PASS();
+}
+
+TEST expect_all_channel_updates_to_supersede_earlier_channels(void) {
+    pca9685_request_s one = PCA9685_REQUEST_INIT, all = PCA9685_REQUEST_INIT;
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    hold_worker();
+
+    pca9685_worker_submit_steps(&worker, 1, 0, 100, &one);
+    pca9685_worker_submit_steps(&worker, ALL, 0, 50, &all);
+    pca9685_worker_submit_steps(&worker, 2, 0, 70, NULL);
+
+    release_worker();
+    pca9685_worker_stop(&worker);
+
+    ASSERT_EQ(pca9685_request_poll(&one), PCA9685_REQUEST_SUPERSEDED);
+    ASSERT_EQ(pca9685_request_poll(&all), PCA9685_REQUEST_DONE);
+    ASSERT_EQ(channel_off_steps(1), 50);
+    ASSERT_EQ(channel_off_steps(2), 70);
+
+    PASS();
+}
+
+TEST expect_full_queue_to_refuse_submissions(void) {
+    pca9685_request_s refused = PCA9685_REQUEST_INIT;
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    hold_worker();
+
+    for(int i = 0; i < PCA9685_WORKER_RING; i++) ASSERT_EQ(pca9685_worker_submit_steps(&worker, i % CHANNELS, 0, i, NULL), 0);
+    ASSERT_EQ(pca9685_worker_submit_steps(&worker, 0, 0, 1, &refused), -1);
+    ASSERT_EQ(pca9685_request_poll(&refused), PCA9685_REQUEST_IDLE);
+    ASSERT_EQ(pca9685_worker_submit_steps(&worker, CHANNELS, 0, 1, NULL), -1);
+
+    release_worker();
+    pca9685_worker_stop(&worker);
+
+    PASS();
+}
+
+TEST expect_bus_errors_to_fail_requests(void) {
+    pca9685_request_s request = PCA9685_REQUEST_INIT;
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    hold_worker();
+
+    atomic_store(&fail, 1);
+    pca9685_worker_submit_steps(&worker, 9, 0, 123, &request);
+
+    release_worker();
+    pca9685_worker_stop(&worker);
+
+    ASSERT_EQ(pca9685_request_poll(&request), PCA9685_REQUEST_FAILED);
+
+    PASS();
+}
+
+TEST expect_a_failed_write_mid_commit_to_fail_every_request(void) {
+    pca9685_request_s first = PCA9685_REQUEST_INIT;
+    pca9685_request_s last = PCA9685_REQUEST_INIT;
+
+    ASSERT_EQ(pca9685_worker_start(&worker, &driver), 0);
+    hold_worker();
+
+    // Channels far apart go out as separate block writes; only the first of them fails
+    atomic_store(&fail_address, channel_to_register_base(3));
+    pca9685_worker_submit_steps(&worker, 3, 0, 123, &first);
+    pca9685_worker_submit_steps(&worker, 12, 0, 456, &last);
+
+    release_worker();
+    pca9685_worker_stop(&worker);
+
+    ASSERT_EQ(channel_off_steps(12), 456);
+    ASSERT_STR_EQ(driver.status, "ok");
+    ASSERT_EQ(pca9685_request_poll(&first), PCA9685_REQUEST_FAILED);
+    ASSERT_EQ(pca9685_request_poll(&last), PCA9685_REQUEST_FAILED);
+
+    PASS();
+}
+
+SUITE(test_worker) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_concurrent_producers_to_land_their_last_values);
+    RUN_TEST(expect_queued_updates_to_coalesce_per_channel);
+    RUN_TEST(expect_all_channel_updates_to_supersede_earlier_channels);
+    RUN_TEST(expect_full_queue_to_refuse_submissions);
+    RUN_TEST(expect_bus_errors_to_fail_requests);
+    RUN_TEST(expect_a_failed_write_mid_commit_to_fail_every_request);
+}
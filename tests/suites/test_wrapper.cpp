@@ -0,0 +1,155 @@
+#include "greatest.h"
+#include "pca9685.hpp"
+
+#include <cstring>
+
+// Nothing of the driver's private headers comes along
+#if defined(OK) || defined(ALL) || defined(SLEEP) || defined(LED0_ON_L)
+#error "pca9685.hpp brings in unprefixed driver macros"
+#endif
+
+/* Test setup begin */
+
+// Compile-time resolution: these fold to constants or the suite doesn't build
+static_assert(pca9685::register_base<0>() == 0x06, "LED0_ON_L");
+static_assert(pca9685::register_base<10>() == 0x2E, "LED10_ON_L");
+static_assert(pca9685::clamp_steps(5000) == 4095, "steps clamp to 4095");
+static_assert(pca9685::percent_steps(25) == 1024, "25% is 1024 steps");
+static_assert(pca9685::duty_cycle(0, 50)[3] == 0x07 && pca9685::duty_cycle(0, 50)[2] == 0xFF, "50% ends at step 2047");
+
+// Bus policy over a register image, counting transactions
+struct mock_policy {
+    u8 registers[256];
+    int writes;
+    int block_writes;
+
+    u8 read(u8 slave, u8 reg) {
+        (void)slave;
+        return registers[reg];
+    }
+
+    u8 write(u8 slave, u8 reg, u8 value) {
+        (void)slave;
+        registers[reg] = value;
+        writes++;
+        return 0;
+    }
+
+    u8 write_block(u8 slave, u8 reg, const u8 *values, u8 length) {
+        (void)slave;
+        std::memcpy(&registers[reg], values, length);
+        block_writes++;
+        return 0;
+    }
+
+    void reset_counts() { writes = block_writes = 0; }
+};
+
+static mock_policy bus, reference_bus;
+
+static void setup_cb(void *data) {
+    (void)data;
+
+    std::memset(&bus, 0, sizeof(bus));
+    std::memset(&reference_bus, 0, sizeof(reference_bus));
+}
+
+static pca9685::led_bytes encode(int on, int off) {
+    pca9685::led_bytes led;
+    pca9685_encode_led(led.data(), on, off);
+
+    return led;
+}
+
+static bool led_equals(const mock_policy &b, u8 base, pca9685::led_bytes led) {
+    return std::memcmp(&b.registers[base], led.data(), led.size()) == 0;
+}
+
+/* Test setup ends here; tests begin */
+
+TEST expect_compile_time_setters_to_match_the_c_driver(void) {
+    pca9685::device<mock_policy> board(bus, 0x40), reference(reference_bus, 0x41);
+
+    board.set_steps<3>(100, 2000);
+    board.set_duty_cycle<4, 10, 30>();
+    board.channel_on<5>();
+    reference.set_steps(3, 100, 2000);
+    reference.set_duty_cycle(4, 10, 30);
+    reference.channel_on(5);
+
+    ASSERT_MEM_EQ(reference_bus.registers, bus.registers, sizeof(bus.registers));
+    ASSERT(led_equals(bus, 0x12, encode(100, 2000)));
+    ASSERT_EQ(board.handle().slave_address, 0x40);
+
+    PASS();
+}
+
+TEST expect_fast_path_to_write_only_changed_bytes(void) {
+    pca9685::device<mock_policy> board(bus, 0x40);
+
+    // The first multi-byte write goes through the C driver, which turns on auto-increment
+    board.set_steps<2>(0, 1000);
+    ASSERT(board.handle().shadow[PCA9685_MODE1] & PCA9685_MODE1_AI);
+
+    bus.reset_counts();
+    board.set_steps<2>(0, 3000);
+    ASSERT_EQ(bus.block_writes, 1);
+    ASSERT_EQ(bus.writes, 0);
+
+    // Full off depends on one bit of OFF_H
+    bus.reset_counts();
+    board.channel_off<2>();
+    ASSERT_EQ(bus.writes, 1);
+    ASSERT_EQ(bus.block_writes, 0);
+    ASSERT(bus.registers[pca9685::register_base<2>() + 3] & 0x10);
+    ASSERT_STR_EQ(board.handle().command, "i2c_write");
+
+    bus.reset_counts();
+    board.channel_off<2>();
+    ASSERT_EQ(bus.writes + bus.block_writes, 0);
+
+    PASS();
+}
+
+TEST expect_frame_scope_to_commit_on_exit(void) {
+    pca9685::device<mock_policy> board(bus, 0x40);
+    bus.reset_counts();
+
+    {
+        auto frame = board.frame();
+        board.channel_on<6>();
+        board.set_steps(7, 0, 2048);
+
+        ASSERT(board.handle().frame_open);
+        ASSERT_EQ(bus.writes + bus.block_writes, 0);
+    }
+
+    ASSERT_FALSE(board.handle().frame_open);
+    ASSERT(bus.registers[pca9685::register_base<6>() + 1] & 0x10);
+    ASSERT(led_equals(bus, pca9685::register_base<7>(), encode(0, 2048)));
+
+    PASS();
+}
+
+TEST expect_curved_channels_to_go_through_the_c_driver(void) {
+    pca9685::device<mock_policy> board(bus, 0x40), reference(reference_bus, 0x41);
+
+    board.handle().ops->set_curve(&board.handle(), 8, PCA9685_CURVE_GAMMA);
+    reference.handle().ops->set_curve(&reference.handle(), 8, PCA9685_CURVE_GAMMA);
+    board.set_duty_cycle<8, 0, 50>();
+    reference.set_duty_cycle(8, 0, 50);
+
+    ASSERT_MEM_EQ(reference_bus.registers, bus.registers, sizeof(bus.registers));
+    ASSERT_FALSE(led_equals(bus, pca9685::register_base<8>(), pca9685::duty_cycle(0, 50)));
+
+    PASS();
+}
+
+extern "C" SUITE(test_wrapper) {
+    SET_SETUP(setup_cb, NULL);
+
+    RUN_TEST(expect_compile_time_setters_to_match_the_c_driver);
+    RUN_TEST(expect_fast_path_to_write_only_changed_bytes);
+    RUN_TEST(expect_frame_scope_to_commit_on_exit);
+    RUN_TEST(expect_curved_channels_to_go_through_the_c_driver);
+}
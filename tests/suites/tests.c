@@ -1,13 +1,24 @@
 #include "tests.h"
 
 #include <stdint.h>
+#include <string.h>
 
 mock_register_s mock_driver;
+mock_bus_s mock_bus;
 
 void set_up_mock_driver(pca9685_s *driver) {
     *driver = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer);
 }
 
+void set_up_mock_driver_with_block_writer(pca9685_s *driver) {
+    *driver = pca9685(.bus_reader=mock_bus_reader, .bus_writer=mock_bus_writer,
+        .bus_block_writer=mock_bus_block_writer);
+}
+
+void reset_mock_bus(void) {
+    memset(&mock_bus, 0, sizeof(mock_bus));
+}
+
 void set_up_theft_run_config_u8(struct theft_run_config *config) {
     theft_seed seed = theft_seed_of_time();
 
@@ -63,6 +74,7 @@ u8 mock_bus_reader(pca9685_s *driver, u8 address) {
     (void)driver;
 
     mock_driver.address = address;
+    mock_bus.reads++;
     return mock_driver.value;
 }
 
@@ -71,7 +83,40 @@ u8 mock_bus_writer(pca9685_s *driver, u8 address, u8 data_in) {
 
     mock_driver.address = address;
     mock_driver.value = data_in;
+    mock_bus.registers[address] = data_in;
+    mock_bus.writes++;
+
+    return 0;
+}
+
+u8 mock_bus_block_writer(pca9685_s *driver, u8 address, u8 length, const u8 *data_in) {
+    (void)driver;
+
+    for(int i = 0; i < length; i++) mock_bus.registers[(u8)(address + i)] = data_in[i];
+
+    mock_driver.address = address;
+    mock_driver.value = data_in[length - 1];
+    mock_bus.block_writes++;
 
     return 0;
 }
 
+
+u8 mock_bus_register_reader(pca9685_s *driver, u8 address) {
+    (void)driver;
+
+    mock_bus.reads++;
+    return mock_bus.registers[address];
+}
+
+u8 mock_bus_block_reader(pca9685_s *driver, u8 address, u8 length, u8 *data_out) {
+    (void)driver;
+
+    // Like the chip, without MODE1 AI every byte comes from the first register
+    int const step = (mock_bus.registers[MODE1] & AI) ? 1 : 0;
+
+    for(int i = 0; i < length; i++) data_out[i] = mock_bus.registers[(u8)(address + i * step)];
+    mock_bus.block_reads++;
+
+    return 0;
+}
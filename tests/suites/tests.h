@@ -12,12 +12,30 @@ typedef struct mock_register {
     u8 value;
 } mock_register_s;
 
+/** Register image and transaction counts seen by the mock bus callbacks */
+typedef struct mock_bus {
+    u8 registers[256];
+    int reads;
+    int writes;
+    int block_writes;
+    int block_reads;
+} mock_bus_s;
+
+extern mock_bus_s mock_bus;
+
 void set_up_mock_driver(pca9685_s *);
+void set_up_mock_driver_with_block_writer(pca9685_s *);
+void reset_mock_bus(void);
 void set_up_theft_run_config_u8(struct theft_run_config *config);
 void set_up_theft_run_config_int(struct theft_run_config *config);
 void set_up_theft_run_config_int_int(struct theft_run_config *config);
 void set_up_theft_run_config_u8_int_int(struct theft_run_config *config);
 u8 mock_bus_reader(pca9685_s *, u8 address);
 u8 mock_bus_writer(pca9685_s *, u8 address, u8 data_in);
+u8 mock_bus_block_writer(pca9685_s *, u8 address, u8 length, const u8 *data_in);
+
+/** Read callbacks answering from the mock register image, for read-back tests */
+u8 mock_bus_register_reader(pca9685_s *, u8 address);
+u8 mock_bus_block_reader(pca9685_s *, u8 address, u8 length, u8 *data_out);
 
 #endif
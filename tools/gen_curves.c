@@ -0,0 +1,62 @@
+/**
+ * Build-time generator for curves.h, the brightness correction tables compiled into the driver.
+ *
+ * Usage: gen_curves <gamma> <output>
+ *
+ * Each table maps Q16 brightness, sampled every 64 (1025 points), to 12-bit steps (0–4096). The
+ * driver interpolates between points, so correction costs two lookups per channel and no libm.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POINTS 1025
+#define STEPS 4096
+
+static double gamma_curve(double x, double gamma) {
+    return pow(x, gamma);
+}
+
+// CIE 1931 lightness L* (0–100) to relative luminance
+static double cie_curve(double x, double gamma) {
+    double const l = x * 100.0;
+    (void)gamma;
+
+    return (l <= 8.0) ? l / 903.3 : pow((l + 16.0) / 116.0, 3.0);
+}
+
+static void write_table(FILE *out, const char *name, double (*curve)(double, double), double gamma) {
+    fprintf(out, "static const uint16_t %s[CURVE_POINTS] = {", name);
+
+    for(int i = 0; i < POINTS; i++) {
+        long const steps = lround(curve((double)i / (POINTS - 1), gamma) * STEPS);
+        fprintf(out, "%s%ld%s", (i % 16) ? " " : "\n    ", steps, (i < POINTS - 1) ? "," : "\n");
+    }
+
+    fprintf(out, "};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if(argc != 3) {
+        fprintf(stderr, "usage: %s <gamma> <output>\n", argv[0]);
+        return 1;
+    }
+
+    double const gamma = strtod(argv[1], NULL);
+    FILE *out = fopen(argv[2], "w");
+
+    if(gamma <= 0.0 || !out) {
+        fprintf(stderr, "%s: bad gamma or unwritable output\n", argv[0]);
+        return 1;
+    }
+
+    fprintf(out, "/* Generated by tools/gen_curves.c, gamma %g; do not edit */\n\n", gamma);
+    fprintf(out, "#ifndef PCA9685_CURVES_H\n#define PCA9685_CURVES_H\n\n#include <inttypes.h>\n\n");
+    fprintf(out, "#define CURVE_POINTS %d\n#define CURVE_SHIFT 6\n\n", POINTS);
+    write_table(out, "gamma_curve", gamma_curve, gamma);
+    write_table(out, "cie_curve", cie_curve, gamma);
+    fprintf(out, "#endif\n");
+
+    return fclose(out) != 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Replays a bus trace recorded with pca9685_record.h and reports its timing as one JSON object.
+ *
+ * Usage: pca9685_replay [-m] [-a adapter] <trace>
+ *
+ *   -m          As fast as the bus goes, rather than at the recorded pace
+ *   -a adapter  Send it to the boards on /dev/i2c-<adapter>; without it, to emulated boards
+ *
+ * Each slave address in the trace gets a board of its own. Times are in ns; \c lag_* is how far
+ * behind the recorded pace calls were made, and stays 0 with -m.
+ */
+
+#include "pca9685.h"
+#include "pca9685_emu.h"
+#include "pca9685_record.h"
+
+#ifdef PCA9685_HAVE_LINUX_I2C
+#include "pca9685_linux.h"
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_SLAVES 128
+
+static pca9685_s devices[MAX_SLAVES];
+static pca9685_emu_s boards[MAX_SLAVES];
+static pca9685_emu_bus_s emu_bus = { .devices = boards };
+
+#ifdef PCA9685_HAVE_LINUX_I2C
+static pca9685_linux_i2c_s adapters[MAX_SLAVES];
+#endif
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-m] [-a adapter] <trace>\n", name);
+
+    return 2;
+}
+
+// Slave addresses in the trace, in order of first appearance
+static int trace_slaves(const pca9685_record_s *records, size_t count, u8 *slaves) {
+    int n = 0;
+    u8 seen[MAX_SLAVES] = { 0 };
+
+    for(size_t i = 0; i < count; i++) {
+        u8 const slave = records[i].slave & (MAX_SLAVES - 1);
+        if(seen[slave]) continue;
+
+        seen[slave] = 1;
+        slaves[n++] = slave;
+    }
+
+    return n;
+}
+
+static uint64_t mean(const pca9685_histogram_s *histogram) {
+    return histogram->count ? histogram->total_ns / histogram->count : 0;
+}
+
+int main(int argc, char **argv) {
+    pca9685_replay_speed speed = PCA9685_REPLAY_ORIGINAL;
+    int adapter = -1;
+    int option;
+
+    while((option = getopt(argc, argv, "ma:")) != -1) {
+        if(option == 'm') speed = PCA9685_REPLAY_MAX;
+        else if(option == 'a') adapter = atoi(optarg);
+        else return usage(argv[0]);
+    }
+    if(optind != argc - 1) return usage(argv[0]);
+
+    size_t count;
+    const pca9685_record_s *records = pca9685_trace_map(argv[optind], &count);
+    if(!records) {
+        fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+        return 1;
+    }
+
+    u8 slaves[MAX_SLAVES];
+    int const n = trace_slaves(records, count, slaves);
+
+    // 0 is the general call address: replaying to it could reset every chip on the bus
+    for(int i = 0; i < n; i++) {
+        if(slaves[i] == 0) {
+            fprintf(stderr, "%s: has transactions for slave 0x00; refusing to replay\n", argv[optind]);
+            pca9685_trace_unmap(records, count);
+            return 1;
+        }
+    }
+
+    for(int i = 0; i < n; i++) {
+        if(adapter < 0) {
+            // Brought up by the driver, as the recorded boards were before recording began
+            pca9685_emu_power_on(&boards[i], slaves[i]);
+            emu_bus.count = i + 1;
+            devices[i] = pca9685(PCA9685_EMU(&emu_bus, slaves[i]));
+            continue;
+        }
+#ifdef PCA9685_HAVE_LINUX_I2C
+        if(pca9685_linux_i2c_open(&adapters[i], adapter, slaves[i], NULL) != 0) {
+            fprintf(stderr, "/dev/i2c-%d: %s\n", adapter, strerror(adapters[i].error));
+            return 1;
+        }
+        devices[i] = (pca9685_s){ PCA9685_LINUX_I2C(&adapters[i]) };
+#else
+        fprintf(stderr, "built without the Linux i2c-dev backend\n");
+        return 1;
+#endif
+    }
+
+    pca9685_replay_stats_s stats;
+    pca9685_replay(records, count, devices, n, speed, &stats);
+
+    printf("{\"replay\":\"%s\",\"backend\":\"%s\",\"devices\":%d,\"records\":%zu,\"transactions\":%" PRIu64 ","
+        "\"bytes\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"mismatched\":%" PRIu64 ",\"recorded_ns\":%" PRIu64 ","
+        "\"replayed_ns\":%" PRIu64 ",\"latency_mean_ns\":%" PRIu64 ",\"latency_max_ns\":%" PRIu64 ","
+        "\"lag_mean_ns\":%" PRIu64 ",\"lag_max_ns\":%" PRIu64 "}\n",
+        speed == PCA9685_REPLAY_MAX ? "max" : "original", adapter < 0 ? "emu" : "linux_i2c", n, count,
+        stats.transactions, stats.bytes, stats.errors, stats.mismatched, stats.recorded_ns, stats.replayed_ns,
+        mean(&stats.latency), stats.latency.max_ns, mean(&stats.lag), stats.lag.max_ns);
+
+#ifdef PCA9685_HAVE_LINUX_I2C
+    for(int i = 0; adapter >= 0 && i < n; i++) pca9685_linux_i2c_close(&adapters[i]);
+#endif
+    pca9685_trace_unmap(records, count);
+
+    return stats.errors ? 1 : 0;
+}